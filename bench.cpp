@@ -0,0 +1,788 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppbulk.h"
+#include "sqlite3cpptyped.h"
+#include "sqlite3cppblob.h"
+#include "sqlite3cpptransfer.h"
+#include "sqlite3cppcache.h"
+#include "sqlite3cppscript.h"
+
+#include "boost/format.hpp"
+#include "boost/algorithm/string/replace.hpp"
+#include <sys/time.h>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <numeric>
+
+//
+// Benchmarks of the wrapper, with the raw SQLite C API as a baseline where it makes sense.
+// Usage: benchmark [rows] [json results file]
+//
+
+//
+// Allocation counting
+//
+static size_t theAllocCount = 0;
+
+void* operator new(size_t aSize)
+{
+    ++theAllocCount;
+    if (void* p = malloc(aSize ? aSize : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) throw()
+{
+    free(p);
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct bench_result
+{
+    std::string name;
+    size_t ops;
+    double ops_per_sec;
+    double ns_per_op;
+    double allocs_per_op;
+};
+static std::vector<bench_result> theResults;
+
+// Measures time and heap allocations spent in the given benchmark
+class measurement
+{
+public:
+    explicit measurement(const std::string& aName)
+        : theName(aName), theStartAllocs(theAllocCount), theStart(now())
+    {}
+
+    void report(size_t anOps)
+    {
+        const double myElapsed = now() - theStart;
+        const size_t myAllocs = theAllocCount - theStartAllocs;
+        bench_result myResult;
+        myResult.name = theName;
+        myResult.ops = anOps;
+        myResult.ops_per_sec = anOps / myElapsed;
+        myResult.ns_per_op = myElapsed * 1e9 / anOps;
+        myResult.allocs_per_op = double(myAllocs) / anOps;
+        theResults.push_back(myResult);
+        std::cout << str(boost::format("%-52s %10.0f ops/sec %10.1f ns/op %8.2f allocs/op")
+                         % theName % myResult.ops_per_sec % myResult.ns_per_op % myResult.allocs_per_op) << std::endl;
+    }
+
+private:
+    std::string theName;
+    size_t theStartAllocs;
+    double theStart;
+};
+
+static void writeJson(const std::string& aPath)
+{
+    std::ofstream myFile(aPath.c_str());
+    myFile << "[\n";
+    for (size_t i = 0; i < theResults.size(); ++i)
+    {
+        const bench_result& r = theResults[i];
+        myFile << str(boost::format("  {\"name\": \"%s\", \"ops\": %u, \"ops_per_sec\": %.1f, \"ns_per_op\": %.1f, \"allocs_per_op\": %.3f}%s\n")
+                      % r.name % r.ops % r.ops_per_sec % r.ns_per_op % r.allocs_per_op
+                      % (i + 1 < theResults.size() ? "," : ""));
+    }
+    myFile << "]\n";
+    if (!myFile)
+        throw std::runtime_error("Failed to write benchmark results to " + aPath);
+}
+
+static void checkRc(int rc, int anExpectedRc)
+{
+    if (rc != anExpectedRc)
+        throw std::runtime_error(str(boost::format("Unexpected SQLite result code %d, expected %d") % rc % anExpectedRc));
+}
+
+static const std::string SqlCreate =
+    "CREATE TABLE Samples (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "value INTEGER NOT NULL,\n"
+    "score REAL NOT NULL,\n"
+    "name TEXT NOT NULL\n"
+    ");\n"
+    "CREATE TABLE SamplesCopy (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "value INTEGER NOT NULL,\n"
+    "score REAL NOT NULL,\n"
+    "name TEXT NOT NULL\n"
+    ");\n"
+    "CREATE TABLE Payloads (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "text TEXT NOT NULL,\n"
+    "data BLOB NOT NULL\n"
+    ");\n";
+
+// Deliberately longer than the SSO buffer of std::string
+static const std::string SqlScan = "SELECT id, value, score, name FROM Samples WHERE id > 0 ORDER BY id";
+static const std::string SqlInsert = "INSERT INTO Samples (id, value, score, name) VALUES (?, ?, ?, ?)";
+static const std::string SqlInsertNamed = "INSERT INTO Samples (id, value, score, name) VALUES (:id, :value, :score, :name)";
+static const std::string SqlLookup = "SELECT value, score, name FROM Samples WHERE id = ?";
+
+//
+// Inserts
+//
+
+static void benchAutocommitInsert(sqlite3cpp::database& db, int aRows)
+{
+    db.execute("DELETE FROM Samples");
+    measurement myMeasurement("insert: autocommit, command per row");
+    for (int i = 1; i <= aRows; ++i)
+    {
+        sqlite3cpp::command cmd(db, SqlInsert);
+        cmd << i << i * 7 << i * 0.5 << "name";
+        cmd.execute();
+    }
+    myMeasurement.report(aRows);
+}
+
+static void benchAutocommitInsertRaw(sqlite3* db, int aRows)
+{
+    checkRc(sqlite3_exec(db, "DELETE FROM Samples", NULL, NULL, NULL), SQLITE_OK);
+    measurement myMeasurement("insert: autocommit, raw C API");
+    for (int i = 1; i <= aRows; ++i)
+    {
+        sqlite3_stmt* myStmt = NULL;
+        checkRc(sqlite3_prepare_v2(db, SqlInsert.c_str(), -1, &myStmt, NULL), SQLITE_OK);
+        sqlite3_bind_int(myStmt, 1, i);
+        sqlite3_bind_int(myStmt, 2, i * 7);
+        sqlite3_bind_double(myStmt, 3, i * 0.5);
+        sqlite3_bind_text(myStmt, 4, "name", -1, SQLITE_STATIC);
+        checkRc(sqlite3_step(myStmt), SQLITE_DONE);
+        sqlite3_finalize(myStmt);
+    }
+    myMeasurement.report(aRows);
+}
+
+enum BindMode
+{
+    bindPositional, bindNamed, bindNamedHandle
+};
+
+static void benchTransactionInsert(sqlite3cpp::database& db, int aRows, BindMode aMode)
+{
+    static const char* const Names[] = { "insert: transaction, positional bind", "insert: transaction, named bind", "insert: transaction, param_handle bind" };
+    db.execute("DELETE FROM Samples");
+    measurement myMeasurement(Names[aMode]);
+    sqlite3cpp::transaction xct(db);
+    sqlite3cpp::command cmd(db, aMode == bindPositional ? SqlInsert : SqlInsertNamed);
+    sqlite3cpp::param_handle myId(1), myValue(2), myScore(3), myName(4);
+    if (aMode == bindNamedHandle)
+    {
+        myId = cmd.get_param(":id");
+        myValue = cmd.get_param(":value");
+        myScore = cmd.get_param(":score");
+        myName = cmd.get_param(":name");
+    }
+    for (int i = 1; i <= aRows; ++i)
+    {
+        switch (aMode)
+        {
+        case bindPositional:
+            cmd.bind(1, i);
+            cmd.bind(2, i * 7);
+            cmd.bind(3, i * 0.5);
+            cmd.bind(4, "name");
+            break;
+        case bindNamed:
+            cmd.bind(":id", i);
+            cmd.bind(":value", i * 7);
+            cmd.bind(":score", i * 0.5);
+            cmd.bind(":name", "name");
+            break;
+        case bindNamedHandle:
+            cmd.bind(myId, i);
+            cmd.bind(myValue, i * 7);
+            cmd.bind(myScore, i * 0.5);
+            cmd.bind(myName, "name");
+            break;
+        }
+        cmd.execute();
+        cmd.reset();
+    }
+    xct.commit();
+    myMeasurement.report(aRows);
+}
+
+static void benchTransactionInsertRaw(sqlite3* db, int aRows)
+{
+    checkRc(sqlite3_exec(db, "DELETE FROM Samples", NULL, NULL, NULL), SQLITE_OK);
+    measurement myMeasurement("insert: transaction, raw C API");
+    checkRc(sqlite3_exec(db, "BEGIN", NULL, NULL, NULL), SQLITE_OK);
+    sqlite3_stmt* myStmt = NULL;
+    checkRc(sqlite3_prepare_v2(db, SqlInsert.c_str(), -1, &myStmt, NULL), SQLITE_OK);
+    for (int i = 1; i <= aRows; ++i)
+    {
+        sqlite3_bind_int(myStmt, 1, i);
+        sqlite3_bind_int(myStmt, 2, i * 7);
+        sqlite3_bind_double(myStmt, 3, i * 0.5);
+        sqlite3_bind_text(myStmt, 4, "name", -1, SQLITE_TRANSIENT);
+        checkRc(sqlite3_step(myStmt), SQLITE_DONE);
+        sqlite3_reset(myStmt);
+    }
+    sqlite3_finalize(myStmt);
+    checkRc(sqlite3_exec(db, "COMMIT", NULL, NULL, NULL), SQLITE_OK);
+    myMeasurement.report(aRows);
+}
+
+static void benchBulkInsert(sqlite3cpp::database& db, int aRows, size_t aBatchSize)
+{
+    db.execute("DELETE FROM Samples");
+    measurement myMeasurement(str(boost::format("insert: bulk_inserter, batch of %u") % aBatchSize));
+    sqlite3cpp::bulk_inserter inserter(db, SqlInsert, aBatchSize);
+    for (int i = 1; i <= aRows; ++i)
+    {
+        inserter.insert(boost::make_tuple(i, i * 7, i * 0.5, "name"));
+    }
+    inserter.flush();
+    myMeasurement.report(aRows);
+}
+
+// every row in its own savepoint of one outer transaction, every 10th savepoint is rolled back
+static void benchSavepointInsert(sqlite3cpp::database& db, int aRows)
+{
+    db.execute("DELETE FROM Samples");
+    {
+        measurement myMeasurement("insert: savepoint per row, database::execute");
+        sqlite3cpp::transaction xct(db);
+        sqlite3cpp::command cmd(db, SqlInsert);
+        for (int i = 1; i <= aRows; ++i)
+        {
+            db.execute("SAVEPOINT row");
+            cmd.bind(1, i);
+            cmd.bind(2, i * 7);
+            cmd.bind(3, i * 0.5);
+            cmd.bind(4, "name");
+            cmd.execute();
+            cmd.reset();
+            if (i % 10 == 0)
+                db.execute("ROLLBACK TO row");
+            db.execute("RELEASE row");
+        }
+        xct.rollback();
+        myMeasurement.report(aRows);
+    }
+    {
+        measurement myMeasurement("insert: savepoint per row, nested transaction");
+        sqlite3cpp::transaction xct(db);
+        sqlite3cpp::command cmd(db, SqlInsert);
+        for (int i = 1; i <= aRows; ++i)
+        {
+            sqlite3cpp::transaction myRow(db);
+            cmd.bind(1, i);
+            cmd.bind(2, i * 7);
+            cmd.bind(3, i * 0.5);
+            cmd.bind(4, "name");
+            cmd.execute();
+            cmd.reset();
+            if (i % 10 != 0)
+                myRow.commit();
+        }
+        xct.commit();
+        myMeasurement.report(aRows);
+    }
+    sqlite3cpp::query qry(db, "SELECT count(*) FROM Samples");
+    if (qry.begin()->get<int>(1) != aRows - aRows / 10)
+        throw std::runtime_error("Unexpected number of rows");
+}
+
+static void populate(sqlite3cpp::database& db, int aRows)
+{
+    db.execute("DELETE FROM Samples");
+    sqlite3cpp::transaction xct(db);
+    sqlite3cpp::command cmd(db, SqlInsert);
+    for (int i = 1; i <= aRows; ++i)
+    {
+        cmd << i << i * 7 << i * 0.5 << str(boost::format("name_%d") % i);
+        cmd.execute();
+        cmd.reset(sqlite3cpp::clearBindingsOn);
+    }
+    xct.commit();
+}
+
+//
+// Point lookups
+//
+
+static void benchPointLookup(sqlite3cpp::database& db, int aRows, int aLookups)
+{
+    measurement myMeasurement("lookup: query per lookup");
+    long long myChecksum = 0;
+    for (int i = 0; i < aLookups; ++i)
+    {
+        sqlite3cpp::query qry(db, SqlLookup);
+        qry << (i % aRows) + 1;
+        myChecksum += qry.begin()->get<int>(1);
+    }
+    myMeasurement.report(aLookups);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected lookup result");
+}
+
+static void benchPointLookupReused(sqlite3cpp::database& db, int aRows, int aLookups)
+{
+    measurement myMeasurement(db.is_profiling_enabled() ? "lookup: reused query, profiling enabled" : "lookup: reused query");
+    sqlite3cpp::query qry(db, SqlLookup);
+    long long myChecksum = 0;
+    for (int i = 0; i < aLookups; ++i)
+    {
+        qry.reset();
+        qry.bind(1, (i % aRows) + 1);
+        myChecksum += qry.begin()->get<int>(1);
+    }
+    myMeasurement.report(aLookups);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected lookup result");
+}
+
+static void benchPointLookupCached(sqlite3cpp::database& db, int aRows, int aLookups)
+{
+    typedef std::tuple<int, double, std::string> Sample;
+    measurement myLoadMeasurement("lookup: cached_table load");
+    sqlite3cpp::cached_table<int, Sample> cache(db, "Samples", "id", "value, score, name");
+    myLoadMeasurement.report(aRows);
+
+    measurement myMeasurement("lookup: cached_table::find");
+    long long myChecksum = 0;
+    for (int i = 0; i < aLookups; ++i)
+        myChecksum += std::get<0>(*cache.find((i % aRows) + 1));
+    myMeasurement.report(aLookups);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected lookup result");
+}
+
+static void benchPointLookupRaw(sqlite3* db, int aRows, int aLookups)
+{
+    measurement myMeasurement("lookup: reused statement, raw C API");
+    sqlite3_stmt* myStmt = NULL;
+    checkRc(sqlite3_prepare_v2(db, SqlLookup.c_str(), -1, &myStmt, NULL), SQLITE_OK);
+    long long myChecksum = 0;
+    for (int i = 0; i < aLookups; ++i)
+    {
+        sqlite3_reset(myStmt);
+        sqlite3_bind_int(myStmt, 1, (i % aRows) + 1);
+        checkRc(sqlite3_step(myStmt), SQLITE_ROW);
+        myChecksum += sqlite3_column_int(myStmt, 0);
+    }
+    sqlite3_finalize(myStmt);
+    myMeasurement.report(aLookups);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected lookup result");
+}
+
+//
+// Scans
+//
+
+template <class T> static size_t checksum(const T& aValue) { return static_cast<size_t>(aValue); }
+static size_t checksum(char const* aValue) { return aValue[0]; }
+static size_t checksum(const std::string& aValue) { return aValue.size(); }
+static size_t checksum(const boost::string_view& aValue) { return aValue.size(); }
+static size_t checksum(void const* aValue) { return aValue != NULL; }
+static size_t checksum(const sqlite3cpp::blob_view& aValue) { return aValue.size; }
+
+// Scans the table reading the given column with row::get<T>
+template <class T>
+static void benchScanGet(sqlite3cpp::database& db, int aRows, int aColumn, const std::string& aTypeName)
+{
+    sqlite3cpp::query qry(db, SqlScan);
+    measurement myMeasurement("scan: row::get<" + aTypeName + ">");
+    size_t myChecksum = 0;
+    for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+    {
+        myChecksum += checksum(i->get<T>(aColumn));
+    }
+    myMeasurement.report(aRows);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+static void benchScanRows(sqlite3cpp::database& db, int aRows)
+{
+    sqlite3cpp::query qry(db, SqlScan);
+    measurement myMeasurement("scan: row::get<int/double/char const*>");
+    long long myChecksum = 0;
+    for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+    {
+        myChecksum += i->get<int>(1) + i->get<int>(2) + static_cast<long long>(i->get<double>(3)) + (i->get<char const*>(4)[0]);
+    }
+    myMeasurement.report(aRows);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+static void benchScanRowsRaw(sqlite3* db, int aRows)
+{
+    measurement myMeasurement("scan: int/double/text, raw C API");
+    sqlite3_stmt* myStmt = NULL;
+    checkRc(sqlite3_prepare_v2(db, SqlScan.c_str(), -1, &myStmt, NULL), SQLITE_OK);
+    long long myChecksum = 0;
+    int rc;
+    while ((rc = sqlite3_step(myStmt)) == SQLITE_ROW)
+    {
+        myChecksum += sqlite3_column_int(myStmt, 0) + sqlite3_column_int(myStmt, 1)
+                      + static_cast<long long>(sqlite3_column_double(myStmt, 2)) + sqlite3_column_text(myStmt, 3)[0];
+    }
+    checkRc(rc, SQLITE_DONE);
+    sqlite3_finalize(myStmt);
+    myMeasurement.report(aRows);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+static void benchScanStream(sqlite3cpp::database& db, int aRows)
+{
+    sqlite3cpp::query qry(db, SqlScan);
+    measurement myMeasurement("scan: row >> int >> int >> double");
+    long long myChecksum = 0;
+    for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+    {
+        int id, value;
+        double score;
+        (*i) >> id >> value >> score;
+        myChecksum += id + value + static_cast<long long>(score);
+    }
+    myMeasurement.report(aRows);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+static void benchScanTyped(sqlite3cpp::database& db, int aRows)
+{
+    sqlite3cpp::typed_query<std::tuple<int, int, double, boost::string_view> > qry(db, SqlScan);
+    measurement myMeasurement("scan: typed_query::fetch");
+    qry.execute();
+    std::tuple<int, int, double, boost::string_view> myRow;
+    long long myChecksum = 0;
+    while (qry.fetch(myRow))
+    {
+        myChecksum += std::get<0>(myRow) + std::get<1>(myRow) + static_cast<long long>(std::get<2>(myRow)) + std::get<3>(myRow).size();
+    }
+    myMeasurement.report(aRows);
+    if (myChecksum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+static void benchScanToVectors(sqlite3cpp::database& db, int aRows)
+{
+    sqlite3cpp::query qry(db, SqlScan);
+    measurement myMeasurement("scan: iterator into vectors + sum");
+    std::vector<sqlite3_int64> myIds, myValues;
+    std::vector<double> myScores;
+    std::vector<std::string> myNames;
+    for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+    {
+        myIds.push_back(i->get<sqlite3_int64>(1));
+        myValues.push_back(i->get<sqlite3_int64>(2));
+        myScores.push_back(i->get<double>(3));
+        myNames.push_back(i->get<std::string>(4));
+    }
+    const double mySum = std::accumulate(myValues.begin(), myValues.end(), 0.0) + std::accumulate(myScores.begin(), myScores.end(), 0.0);
+    myMeasurement.report(aRows);
+    if (mySum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+static void benchScanColumnBatch(sqlite3cpp::database& db, int aRows)
+{
+    sqlite3cpp::query qry(db, SqlScan);
+    measurement myMeasurement("scan: query::fetch_batch(4096) + sum");
+    sqlite3cpp::column_batch myBatch;
+    double mySum = 0;
+    qry.reset();
+    while (size_t myRows = qry.fetch_batch(myBatch, 4096))
+    {
+        const sqlite3_int64* myValues = &myBatch.get_column(2).integers[0];
+        const double* myScores = &myBatch.get_column(3).reals[0];
+        for (size_t i = 0; i < myRows; ++i)
+            mySum += myValues[i] + myScores[i];
+    }
+    myMeasurement.report(aRows);
+    if (mySum == 0)
+        throw std::runtime_error("Unexpected scan result");
+}
+
+//
+// Export and import of a table
+//
+
+static const std::string SqlCopyInsert = "INSERT INTO SamplesCopy (id, value, score, name) VALUES (?, ?, ?, ?)";
+
+static void checkCopied(sqlite3cpp::database& db, int aRows)
+{
+    sqlite3cpp::query qry(db, "SELECT count(*) FROM SamplesCopy");
+    if (qry.begin()->get<int>(1) != aRows)
+        throw std::runtime_error("Unexpected number of imported rows");
+    db.execute("DELETE FROM SamplesCopy");
+}
+
+// Hand-written dump and reload with iostreams and a command per row as the baseline
+static void benchExportImportStreams(sqlite3cpp::database& db, int aRows)
+{
+    {
+        measurement myMeasurement("export: query iterator + ofstream, CSV");
+        std::ofstream myFile("bench.csv");
+        sqlite3cpp::query qry(db, SqlScan);
+        for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+            myFile << i->get<int>(1) << ',' << i->get<int>(2) << ',' << i->get<double>(3) << ',' << i->get<std::string>(4) << '\n';
+        myFile.close();
+        myMeasurement.report(aRows);
+    }
+    {
+        measurement myMeasurement("import: getline + command per row, CSV");
+        std::ifstream myFile("bench.csv");
+        sqlite3cpp::transaction xct(db);
+        sqlite3cpp::command cmd(db, SqlCopyInsert);
+        std::string myLine;
+        while (std::getline(myFile, myLine))
+        {
+            std::istringstream myFields(myLine);
+            std::string myField;
+            for (int idx = 1; std::getline(myFields, myField, ','); ++idx)
+                cmd.bind(idx, myField);
+            cmd.execute();
+            cmd.reset();
+        }
+        xct.commit();
+        myMeasurement.report(aRows);
+    }
+    checkCopied(db, aRows);
+}
+
+static void benchExportImport(sqlite3cpp::database& db, int aRows, sqlite3cpp::TransferFormat aFormat)
+{
+    const char* myFormatName = (aFormat == sqlite3cpp::formatCsv) ? "CSV" : "columnar";
+    sqlite3_uint64 myBytes = 0;
+    {
+        measurement myMeasurement(str(boost::format("export: table_exporter, %s") % myFormatName));
+        sqlite3cpp::table_exporter exporter(db, SqlScan);
+        myBytes = exporter.export_to("bench.export", aFormat).bytes;
+        myMeasurement.report(aRows);
+    }
+    {
+        measurement myMeasurement(str(boost::format("import: table_importer, %s") % myFormatName));
+        sqlite3cpp::table_importer importer(db, SqlCopyInsert);
+        importer.import_from("bench.export", aFormat);
+        myMeasurement.report(aRows);
+    }
+    std::cout << str(boost::format("%s file size: %u bytes") % myFormatName % myBytes) << std::endl;
+    checkCopied(db, aRows);
+}
+
+//
+// String and blob payloads
+//
+
+static void benchPayload(sqlite3cpp::database& db, int aRows, size_t aSize, sqlite3cpp::BindLifetime aLifetime)
+{
+    const std::string myPayload(aSize, 'x');
+    const char* myLifetimeName = (aLifetime == sqlite3cpp::bindStatic) ? "bindStatic" : "bindCopy";
+    db.execute("DELETE FROM Payloads");
+    {
+        measurement myMeasurement(str(boost::format("payload: bind text+blob %uB, %s") % aSize % myLifetimeName));
+        sqlite3cpp::transaction xct(db);
+        sqlite3cpp::command cmd(db, "INSERT INTO Payloads (id, text, data) VALUES (?, ?, ?)");
+        for (int i = 1; i <= aRows; ++i)
+        {
+            cmd.bind(1, i);
+            cmd.bind(2, boost::string_view(myPayload), aLifetime);
+            cmd.bind(3, sqlite3cpp::blob_view(myPayload.data(), myPayload.size()), aLifetime);
+            cmd.execute();
+            cmd.reset();
+        }
+        xct.commit();
+        myMeasurement.report(aRows);
+    }
+    if (aLifetime != sqlite3cpp::bindStatic)
+        return; // reading back does not depend on how the payload was bound
+
+    size_t myTotal = 0;
+    {
+        sqlite3cpp::query qry(db, "SELECT text FROM Payloads");
+        measurement myMeasurement(str(boost::format("payload: row::get<std::string> %uB") % aSize));
+        for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+            myTotal += i->get<std::string>(1).size();
+        myMeasurement.report(aRows);
+    }
+    {
+        sqlite3cpp::query qry(db, "SELECT data FROM Payloads");
+        measurement myMeasurement(str(boost::format("payload: row::get<blob_view> %uB") % aSize));
+        for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+            myTotal += i->get<sqlite3cpp::blob_view>(1).size;
+        myMeasurement.report(aRows);
+    }
+    if (myTotal != 2 * aRows * aSize)
+        throw std::runtime_error("Unexpected payload size");
+}
+
+// Incremental I/O over the rows left by the last benchPayload() run, compare with row::get<blob_view> above
+static void benchBlobStream(sqlite3cpp::database& db, int aRows, size_t aSize)
+{
+    std::vector<char> myBuffer(aSize, 'y');
+    {
+        measurement myMeasurement(str(boost::format("payload: blob_stream::write %uB") % aSize));
+        sqlite3cpp::transaction xct(db);
+        sqlite3cpp::blob_stream blob(db, "Payloads", "data", 1, sqlite3cpp::blobReadWrite);
+        for (int i = 1; i <= aRows; ++i)
+        {
+            blob.reopen(i);
+            blob.write(&myBuffer[0], aSize, 0);
+        }
+        blob.close();
+        xct.commit();
+        myMeasurement.report(aRows);
+    }
+    size_t myTotal = 0;
+    {
+        measurement myMeasurement(str(boost::format("payload: blob_stream::read %uB") % aSize));
+        sqlite3cpp::blob_stream blob(db, "Payloads", "data", 1);
+        for (int i = 1; i <= aRows; ++i)
+        {
+            blob.reopen(i);
+            blob.read(&myBuffer[0], aSize, 0);
+            myTotal += (myBuffer[aSize - 1] == 'y') ? aSize : 0;
+        }
+        myMeasurement.report(aRows);
+    }
+    if (myTotal != aRows * aSize)
+        throw std::runtime_error("Unexpected payload size");
+}
+
+// Test fixture reset as a script of many small statements, reparsed by database::execute() on every run
+static void benchScript(sqlite3cpp::database& db, int aRuns, int aStatements)
+{
+    db.execute("CREATE TABLE IF NOT EXISTS Fixture (id INTEGER PRIMARY KEY, name TEXT)");
+    std::string mySql = "BEGIN; DELETE FROM Fixture;";
+    for (int i = 1; i <= aStatements; ++i)
+        mySql += str(boost::format(" INSERT INTO Fixture (id, name) VALUES (%d, :name);") % i);
+    mySql += " COMMIT;";
+    const size_t myOps = static_cast<size_t>(aRuns) * (aStatements + 3);
+
+    // database::execute() takes no parameters, so the literal SQL stands for the bound value
+    const std::string myLiteralSql = boost::replace_all_copy(mySql, ":name", "'fixture'");
+    {
+        measurement myMeasurement("script: database::execute");
+        for (int i = 0; i < aRuns; ++i)
+            db.execute(myLiteralSql);
+        myMeasurement.report(myOps);
+    }
+    {
+        sqlite3cpp::script_params myParams;
+        myParams.push_back(std::make_pair(":name", sqlite3cpp::script_param(std::string("fixture"))));
+        measurement myMeasurement("script: script::execute");
+        sqlite3cpp::script myScript(db, mySql);
+        for (int i = 0; i < aRuns; ++i)
+            myScript.execute(myParams);
+        myMeasurement.report(myOps);
+    }
+    {
+        sqlite3cpp::query qry(db, "SELECT count(*) FROM Fixture");
+        if (qry.begin()->get<int>(1) != aStatements)
+            throw std::runtime_error("Unexpected fixture size");
+    }
+    db.execute("DROP TABLE Fixture");
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const int myRows = (argc > 1) ? atoi(argv[1]) : 1000000;
+        const std::string myJsonPath = (argc > 2) ? argv[2] : "bench.json";
+        // every autocommit insert is a separate transaction synced to disk
+        const int myAutocommitRows = std::min(myRows, 1000);
+        const int myLookups = std::min(myRows, 200000);
+
+        ::remove("bench.db");
+        sqlite3cpp::database db("bench.db", SqlCreate);
+        sqlite3* myRawDb = NULL;
+        checkRc(sqlite3_open("bench.db", &myRawDb), SQLITE_OK);
+
+        benchAutocommitInsert(db, myAutocommitRows);
+        benchAutocommitInsertRaw(myRawDb, myAutocommitRows);
+        benchTransactionInsert(db, myRows, bindPositional);
+        benchTransactionInsert(db, myRows, bindNamed);
+        benchTransactionInsert(db, myRows, bindNamedHandle);
+        benchTransactionInsertRaw(myRawDb, myRows);
+        benchBulkInsert(db, myRows, 1000);
+        benchBulkInsert(db, myRows, 100000);
+        benchSavepointInsert(db, myRows);
+        populate(db, myRows);
+
+        benchPointLookup(db, myRows, myLookups);
+        benchPointLookupReused(db, myRows, myLookups);
+        benchPointLookupRaw(myRawDb, myRows, myLookups);
+        benchPointLookupCached(db, myRows, myLookups);
+        db.enable_profiling();
+        benchPointLookupReused(db, myRows, myLookups);
+        db.enable_profiling(false);
+        benchScript(db, std::max(myLookups / 200, 1), 100);
+
+        benchScanRows(db, myRows);
+        benchScanRowsRaw(myRawDb, myRows);
+        benchScanGet<int>(db, myRows, 2, "int");
+        benchScanGet<long>(db, myRows, 2, "long");
+        benchScanGet<unsigned int>(db, myRows, 2, "unsigned int");
+        benchScanGet<unsigned long>(db, myRows, 2, "unsigned long");
+        benchScanGet<sqlite3_int64>(db, myRows, 2, "sqlite3_int64");
+        benchScanGet<double>(db, myRows, 3, "double");
+        benchScanGet<char const*>(db, myRows, 4, "char const*");
+        benchScanGet<std::string>(db, myRows, 4, "std::string");
+        benchScanGet<boost::string_view>(db, myRows, 4, "boost::string_view");
+        benchScanGet<void const*>(db, myRows, 4, "void const*");
+        benchScanGet<sqlite3cpp::blob_view>(db, myRows, 4, "blob_view");
+        benchScanStream(db, myRows);
+        benchScanTyped(db, myRows);
+        benchScanToVectors(db, myRows);
+        benchScanColumnBatch(db, myRows);
+
+        benchExportImportStreams(db, myRows);
+        benchExportImport(db, myRows, sqlite3cpp::formatCsv);
+        benchExportImport(db, myRows, sqlite3cpp::formatColumnar);
+        ::remove("bench.csv");
+        ::remove("bench.export");
+
+        const size_t myPayloadSizes[] = { 16, 1024, 64 * 1024 };
+        for (size_t i = 0; i < sizeof(myPayloadSizes) / sizeof(myPayloadSizes[0]); ++i)
+        {
+            // keep about 64MB of payload per run
+            const int myPayloadRows = static_cast<int>(std::min<size_t>(myRows, 64 * 1024 * 1024 / myPayloadSizes[i]));
+            benchPayload(db, myPayloadRows, myPayloadSizes[i], sqlite3cpp::bindCopy);
+            benchPayload(db, myPayloadRows, myPayloadSizes[i], sqlite3cpp::bindStatic);
+            benchBlobStream(db, myPayloadRows, myPayloadSizes[i]);
+        }
+
+        sqlite3_close(myRawDb);
+        writeJson(myJsonPath);
+        std::cout << "Results written to " << myJsonPath << std::endl;
+        ::remove("bench.db");
+        return 0;
+    }
+    catch (std::exception& ex) {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+}
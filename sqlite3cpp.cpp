@@ -24,11 +24,25 @@
 
 #include "sqlite3cpp.h"
 #include "boost/format.hpp"
+#include "boost/algorithm/string/case_conv.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <limits.h>
+#include <time.h>
+#include <math.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <algorithm>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 using std::string;
 
@@ -42,7 +56,9 @@ namespace sqlite3cpp
     //
     namespace
     {
-        void createIfNotExist(const string& aDbPath, const string& aDbCreateSql)
+        const char* const JournalModes[] = { "delete", "truncate", "persist", "memory", "wal", "off" };
+
+        void createIfNotExist(const string& aDbPath, const string& aDbCreateSql, const boost::optional<int>& aPageSize)
         {
             struct stat sb = {0};
             if (stat(aDbPath.c_str(), &sb) != 0 || (sb.st_mode & (S_IFREG | S_IRUSR | S_IWUSR)) != (S_IFREG | S_IRUSR | S_IWUSR) )
@@ -51,7 +67,9 @@ namespace sqlite3cpp
                 int rc = sqlite3_open(aDbPath.c_str(), &myDb);
                 if (rc != SQLITE_OK)
                     throw database_error(str(boost::format("Failed to create Db %s. Sqlite3 error code: %d") % aDbPath % rc));
-                if (sqlite3_exec(myDb, aDbCreateSql .c_str(), NULL,NULL, NULL)!=SQLITE_OK)
+                // page size can only be changed before the first table is created
+                const string mySql = aPageSize ? str(boost::format("PRAGMA page_size = %d;\n%s") % *aPageSize % aDbCreateSql) : aDbCreateSql;
+                if (sqlite3_exec(myDb, mySql.c_str(), NULL,NULL, NULL)!=SQLITE_OK)
                 {
                     string myErr = sqlite3_errmsg(myDb);
                     sqlite3_close(myDb);
@@ -62,22 +80,413 @@ namespace sqlite3cpp
             }
         }
 
+        const size_t MaxReservedBatchRows = 4096;
+
+        int getFirstColumn(void* aValue, int aColumns, char** aColumnValues, char**)
+        {
+            if (aColumns > 0 && aColumnValues[0])
+                *static_cast<string*>(aValue) = aColumnValues[0];
+            return 0;
+        }
+
+        sqlite3_destructor_type toDestructor(BindLifetime aLifetime)
+        {
+            return (aLifetime == bindStatic) ? SQLITE_STATIC : SQLITE_TRANSIENT;
+        }
+
+        // COMMIT failed with SQLITE_BUSY leaves the transaction open and can be retried
+        bool isCommit(sqlite3_stmt* aStmt)
+        {
+            char const* mySql = sqlite3_sql(aStmt);
+            while (mySql && isspace(static_cast<unsigned char>(*mySql)))
+                ++mySql;
+            return mySql && (strncasecmp(mySql, "COMMIT", 6) == 0 || strncasecmp(mySql, "END", 3) == 0);
+        }
+
+        struct unlock_notification
+        {
+            unlock_notification() : fired(false) {}
+
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool fired;
+        };
+
+        void unlockNotify(void** aNotifications, int aCount)
+        {
+            for (int i = 0; i < aCount; ++i)
+            {
+                unlock_notification* myNotification = static_cast<unlock_notification*>(aNotifications[i]);
+                std::lock_guard<std::mutex> myLock(myNotification->mutex);
+                myNotification->fired = true;
+                myNotification->cond.notify_one();
+            }
+        }
+
+        // Execution times are kept in a log-linear histogram with 8 buckets per power of 2 of nanoseconds
+        const int HistogramBucketsPerOctave = 8;
+        const int HistogramBuckets = 48 * HistogramBucketsPerOctave;
+
+        int toHistogramBucket(double aSec)
+        {
+            const double myNs = aSec * 1e9;
+            if (myNs <= 1)
+                return 0;
+            return std::min(static_cast<int>(ceil(log2(myNs) * HistogramBucketsPerOctave)), HistogramBuckets - 1);
+        }
+
+        double fromHistogramBucket(int aBucket)
+        {
+            return exp2(static_cast<double>(aBucket) / HistogramBucketsPerOctave) / 1e9;
+        }
+
+        string toJsonString(const string& aStr)
+        {
+            string myJson = "\"";
+            for (string::const_iterator it = aStr.begin(); it != aStr.end(); ++it)
+            {
+                switch (*it)
+                {
+                case '"': myJson += "\\\""; break;
+                case '\\': myJson += "\\\\"; break;
+                case '\n': myJson += "\\n"; break;
+                case '\r': myJson += "\\r"; break;
+                case '\t': myJson += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(*it) < 0x20)
+                        myJson += str(boost::format("\\u%04x") % static_cast<int>(*it));
+                    else
+                        myJson += *it;
+                }
+            }
+            return myJson + "\"";
+        }
+
+        bool paramNameLess(const std::pair<string, int>& anEntry, boost::string_view aName)
+        {
+            return boost::string_view(anEntry.first) < aName;
+        }
+
+        // Error paths are kept out of line so that formatting the message does not bloat the callers
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwInvalidPlaceholder(boost::string_view aName, const string& anSql)
+        {
+            throw database_error(str(boost::format("Invalid bind placeholder %s for query '%s'") % aName % anSql));
+        }
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwColumnOutOfBounds(int idx, sqlite3_stmt* aStmt)
+        {
+            throw database_error(str(boost::format("Column %d is out-of-bounds for query '%s'") % idx % sqlite3_sql(aStmt)));
+        }
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwBatchColumnOutOfBounds(int idx, size_t aColumns)
+        {
+            throw database_error(str(boost::format("Column %d is out-of-bounds for the batch of %d columns") % idx % aColumns));
+        }
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwBatchRowOutOfBounds(size_t aRow, size_t aRows)
+        {
+            throw database_error(str(boost::format("Row %d is out-of-bounds for the batch of %d rows") % aRow % aRows));
+        }
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwBatchColumnNotText(int idx)
+        {
+            throw database_error(str(boost::format("Column %d of the batch is not a text column") % idx));
+        }
+
+        // the range of integers a double holds exactly
+        const sqlite3_int64 MaxExactRealInteger = sqlite3_int64(1) << 53;
+
+        bool isExactReal(sqlite3_int64 aValue)
+        {
+            return aValue >= -MaxExactRealInteger && aValue <= MaxExactRealInteger;
+        }
+
+        bool isBatchNull(const column_batch::column& aColumn, size_t aRow)
+        {
+            return (aColumn.nulls[aRow / 64] >> (aRow % 64)) & 1;
+        }
+
+        // Changes the type of the first aRows values of a batch column, numbers converted to text the way SQLite does
+        void retypeBatchColumn(column_batch::column& aColumn, ColumnType aType, size_t aRows)
+        {
+            if (aType == columnReal)
+            {
+                aColumn.reals.assign(aColumn.integers.begin(), aColumn.integers.end());
+            }
+            else if (aType == columnText || aType == columnBlob)
+            {
+                aColumn.offsets.assign(1, 0);
+                aColumn.heap.clear();
+                char myBuf[32];
+                for (size_t r = 0; r < aRows; ++r)
+                {
+                    if (!isBatchNull(aColumn, r))
+                    {
+                        if (aColumn.type == columnInteger)
+                            sqlite3_snprintf(sizeof(myBuf), myBuf, "%lld", aColumn.integers[r]);
+                        else
+                            sqlite3_snprintf(sizeof(myBuf), myBuf, "%!.15g", aColumn.reals[r]);
+                        aColumn.heap.insert(aColumn.heap.end(), myBuf, myBuf + strlen(myBuf));
+                    }
+                    aColumn.offsets.push_back(aColumn.heap.size());
+                }
+            }
+            aColumn.integers.clear();
+            if (aType != columnReal)
+                aColumn.reals.clear();
+            aColumn.type = aType;
+        }
+
+        // Makes a batch column of the first aRows values take a value of another storage class
+        void promoteBatchColumn(column_batch::column& aColumn, int aValueType, sqlite3_stmt* aStmt, int aCol, size_t aRows)
+        {
+            bool myAllNull = true;
+            for (size_t r = 0; r < aRows && myAllNull; ++r)
+                myAllNull = isBatchNull(aColumn, r);
+
+            ColumnType myType = (aValueType == SQLITE_BLOB ? columnBlob : columnText);
+            if (aValueType == SQLITE_INTEGER)
+                myType = columnInteger;
+            else if (aValueType == SQLITE_FLOAT)
+                myType = columnReal;
+
+            if (myAllNull)
+            {
+                // NULLs are of no storage class, so the column is retyped as if the value were the first one
+                aColumn.offsets.assign(1, 0);
+                aColumn.heap.clear();
+                aColumn.integers.clear();
+                aColumn.reals.clear();
+                aColumn.type = myType;
+                for (size_t r = 0; r < aRows; ++r)
+                {
+                    if (myType == columnInteger)
+                        aColumn.integers.push_back(0);
+                    else if (myType == columnReal)
+                        aColumn.reals.push_back(0);
+                    else
+                        aColumn.offsets.push_back(0);
+                }
+                return;
+            }
+
+            aColumn.mixed = true;
+            switch (aColumn.type)
+            {
+            case columnInteger:
+                if (aValueType == SQLITE_FLOAT && std::all_of(aColumn.integers.begin(), aColumn.integers.end(), isExactReal))
+                    retypeBatchColumn(aColumn, columnReal, aRows);
+                else
+                    retypeBatchColumn(aColumn, aValueType == SQLITE_BLOB ? columnBlob : columnText, aRows);
+                break;
+            case columnReal:
+                if (aValueType != SQLITE_INTEGER || !isExactReal(sqlite3_column_int64(aStmt, aCol)))
+                    retypeBatchColumn(aColumn, aValueType == SQLITE_BLOB ? columnBlob : columnText, aRows);
+                break;
+            default:
+                // text and BLOB columns take bytes of any value
+                break;
+            }
+        }
+
+        bool compareTotalTime(const statement_profile& aLhs, const statement_profile& aRhs)
+        {
+            return aLhs.total_sec > aRhs.total_sec;
+        }
+
     } // unnamed ns
 
 
+    double detail::now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    //
+    // Parameter values
+    //
+
+    namespace
+    {
+        class param_binder : public boost::static_visitor<int>
+        {
+        public:
+            param_binder(sqlite3_stmt* aStmt, int idx) : theStmt(aStmt), theIdx(idx) {}
+
+            int operator()(const null_type&) const { return sqlite3_bind_null(theStmt, theIdx); }
+            int operator()(int value) const { return sqlite3_bind_int64(theStmt, theIdx, value); }
+            int operator()(sqlite3_int64 value) const { return sqlite3_bind_int64(theStmt, theIdx, value); }
+            int operator()(double value) const { return sqlite3_bind_double(theStmt, theIdx, value); }
+            int operator()(const string& value) const
+            {
+                return sqlite3_bind_text(theStmt, theIdx, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+            }
+            int operator()(const std::vector<char>& value) const
+            {
+                return sqlite3_bind_blob(theStmt, theIdx, value.empty() ? "" : &value[0], static_cast<int>(value.size()), SQLITE_STATIC);
+            }
+
+        private:
+            sqlite3_stmt* theStmt;
+            int theIdx;
+        };
+    }
+
+    int detail::bind_param(sqlite3_stmt* aStmt, int idx, const param_value& aValue)
+    {
+        return boost::apply_visitor(param_binder(aStmt, idx), aValue);
+    }
+
+    //
+    // Integer conversions
+    //
+
+    void detail::throw_integer_overflow(boost::uint64_t aValue)
+    {
+        throw database_error(str(boost::format("Failed to bind unsigned integer value %1% because it exceeds the range of 64-bit signed integer") % aValue));
+    }
+
+    void detail::throw_integer_out_of_range(sqlite3_int64 aValue, int aBits, bool aSigned)
+    {
+        throw database_error(str(boost::format("Integer value %1% does not fit into %2%-bit %3% integer") % aValue % aBits % (aSigned ? "signed" : "unsigned")));
+    }
+
+
     //
     // Database
     //
 
-    database::database()
-        : theDb(NULL)
+    open_options::open_options()
+        : flags(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)
+    {}
+
+    connection_memory_status::connection_memory_status()
+        : lookaside_used(0), lookaside_highwater(0), lookaside_hits(0), lookaside_misses_size(0), lookaside_misses_full(0)
+        , cache_used(0), schema_used(0), statements_used(0)
     {}
 
-    database::database(const string& aDbPath, const string& aDbCreateSql, const string& anExtensionPath)
-        : theDb(NULL)
+    statement_cache_stats::statement_cache_stats()
+        : capacity(0), size(0), hits(0), misses(0), evictions(0)
+    {}
+
+    checkpoint_result::checkpoint_result()
+        : busy(false), log_frames(-1), checkpointed_frames(-1)
+    {}
+
+    retry_policy::retry_policy()
+        : max_retries(0), initial_delay_ms(1), max_delay_ms(100), deadline_ms(0), unlock_notify(true)
+    {}
+
+    retry_stats::retry_stats()
+        : busy(0), locked(0), failures(0), wait_sec(0), max_wait_sec(0)
+    {}
+
+    statement_execution::statement_execution()
+        : elapsed_sec(0), lock_wait_sec(0), steps(0), rows(0), fullscan_steps(0), sorts(0), autoindexes(0), vm_steps(0)
+    {}
+
+    statement_profile::statement_profile()
+        : prepares(0), prepare_sec(0), executions(0), steps(0), rows(0), total_sec(0), p50_sec(0), p99_sec(0), max_sec(0),
+          lock_wait_sec(0), fullscan_steps(0), sorts(0), autoindexes(0), vm_steps(0)
+    {}
+
+    struct database::profiler
     {
+        struct entry
+        {
+            entry() : histogram(HistogramBuckets) {}
+
+            statement_profile profile;
+            std::vector<size_t> histogram;
+        };
+
+        profiler() : slow_query_threshold_sec(0), lock_wait_sec(0) {}
+
+        entry& get_entry(const string& anSql)
+        {
+            entry& myEntry = entries[anSql];
+            if (myEntry.profile.sql.empty())
+                myEntry.profile.sql = anSql;
+            return myEntry;
+        }
+
+        double percentile(const entry& anEntry, double aFraction) const
+        {
+            const size_t myRank = static_cast<size_t>(ceil(anEntry.profile.executions * aFraction));
+            size_t myCount = 0;
+            for (int i = 0; i < HistogramBuckets; ++i)
+            {
+                myCount += anEntry.histogram[i];
+                if (myCount >= myRank && myCount > 0)
+                    return std::min(fromHistogramBucket(i), anEntry.profile.max_sec);
+            }
+            return anEntry.profile.max_sec;
+        }
+
+        double slow_query_threshold_sec;
+        slow_query_callback slow_query;
+        double lock_wait_sec;   // running total of lock waits measured by the busy handler
+        boost::unordered_map<string, entry> entries;
+    };
+
+    database::database()
+        : theDb(NULL), theBusyTimeoutMs(0), theReportedChanges(0), theTotalChanges(0), theTransactionDepth(0)
+    {
+        theStatementCacheStats.capacity = DefaultStatementCacheCapacity;
+        theRetryRandom.seed(static_cast<unsigned int>(reinterpret_cast<uintptr_t>(this) ^ time(NULL)));
+    }
+
+    database::database(const string& aDbPath, const string& aDbCreateSql, const string& anExtensionPath, const open_options& anOptions)
+        : theDb(NULL), theBusyTimeoutMs(0), theReportedChanges(0), theTotalChanges(0), theTransactionDepth(0)
+    {
+        theStatementCacheStats.capacity = DefaultStatementCacheCapacity;
+        theRetryRandom.seed(static_cast<unsigned int>(reinterpret_cast<uintptr_t>(this) ^ time(NULL)));
         if (!aDbPath.empty())
-            open(aDbPath, aDbCreateSql, anExtensionPath);
+            open(aDbPath, aDbCreateSql, anExtensionPath, anOptions);
+    }
+
+    database::database(database&& other)
+        : theDb(NULL), theBusyTimeoutMs(0), theReportedChanges(0), theTotalChanges(0), theTransactionDepth(0)
+    {
+        theStatementCacheStats.capacity = DefaultStatementCacheCapacity;
+        theRetryRandom.seed(static_cast<unsigned int>(reinterpret_cast<uintptr_t>(this) ^ time(NULL)));
+        *this = std::move(other);
+    }
+
+    database& database::operator=(database&& other)
+    {
+        if (this == &other)
+            return *this;
+        close();
+        theDbPath.swap(other.theDbPath);
+        std::swap(theDb, other.theDb);
+        std::swap(theOptions, other.theOptions);
+        // the cache of this object is empty once closed
+        theStatementLru.swap(other.theStatementLru);
+        theStatementIndex.swap(other.theStatementIndex);
+        theSpareLruNodes.swap(other.theSpareLruNodes);
+        theSpareIndexNodes.swap(other.theSpareIndexNodes);
+        std::swap(theStatementCacheStats, other.theStatementCacheStats);
+        theBusyTimeoutMs = other.theBusyTimeoutMs;
+        other.theBusyTimeoutMs = 0;
+        theProfiler = std::move(other.theProfiler);
+        theChangeListeners = std::move(other.theChangeListeners);
+        other.theChangeListeners.clear();
+        theReportedChanges = other.theReportedChanges;
+        theTotalChanges = other.theTotalChanges;
+        other.theReportedChanges = other.theTotalChanges = 0;
+        theWalCallback = std::move(other.theWalCallback);
+        other.theWalCallback = wal_callback();
+        std::swap(theRetryPolicy, other.theRetryPolicy);
+        std::swap(theRetryStats, other.theRetryStats);
+        std::swap(theRetryRandom, other.theRetryRandom);
+        std::swap(theTransactionDepth, other.theTransactionDepth);
+        theSavepointSql.swap(other.theSavepointSql);
+        rebind_hooks();
+        return *this;
     }
 
     database::~database()
@@ -86,51 +495,756 @@ namespace sqlite3cpp
         catch (...) {}
     }
 
-    void database::open(const string& aDbPath, const string& aDbCreateSql, const string& anExtensionPath)
+    void database::open(const string& aDbPath, const string& aDbCreateSql, const string& anExtensionPath, const open_options& anOptions)
+    {
+        close();
+        createIfNotExist(aDbPath, aDbCreateSql, anOptions.page_size);
+
+        int rc = sqlite3_open_v2(aDbPath.c_str(), &theDb, anOptions.flags, NULL);
+        if (rc != SQLITE_OK)
+        {
+            sqlite3_close(theDb);
+            theDb = NULL;
+            throw database_error(str(boost::format("Failed to open Db %s. Sqlite3 error code: %d") % aDbPath % rc));
+        }
+        theDbPath = aDbPath;
+        theBusyTimeoutMs = 0;
+        // the listeners have seen another Db if any
+        install_update_hook();
+        if (theWalCallback)
+            sqlite3_wal_hook(theDb, wal_hook, this);
+        for (size_t i = 0; i < theChangeListeners.size(); ++i)
+            theChangeListeners[i]->on_unreported_changes();
+
+        try
+        {
+            if (!anExtensionPath.empty())
+                load_extension(anExtensionPath);
+            apply_options(anOptions);
+            read_options(anOptions.flags);
+        }
+        catch (...)
+        {
+            try { close(); }
+            catch (...) {}
+            throw;
+        }
+    }
+
+    void database::close()
+    {
+        if (theDb)
+        {
+            clear_statement_cache();
+            if (sqlite3_close(theDb) != SQLITE_OK)
+                throw database_error(*this, "Failed to close Db.");
+            theDb = NULL;
+            theDbPath = "";
+            theOptions = open_options();
+        }
+    }
+
+    const open_options& database::get_open_options() const
+    {
+        return theOptions;
+    }
+
+    sqlite3_int64 database::last_insert_rowid() const
+    {
+        return sqlite3_last_insert_rowid(theDb);
+    }
+
+    int database::changes() const
+    {
+        return sqlite3_changes(theDb);
+    }
+
+    int database::error_code() const
+    {
+        return sqlite3_extended_errcode(theDb);
+    }
+
+    void database::execute(const string& anSql)
+    {
+        if (try_execute(anSql) != SQLITE_OK)
+            throw database_error(*this, "Failed to execute", anSql);
+    }
+
+    int database::try_execute(const string& anSql)
+    {
+        if (!theProfiler)
+        {
+            const int rc = (theRetryPolicy.max_retries > 0) ? execute_retrying(anSql) : sqlite3_exec(theDb, anSql.c_str(), NULL,NULL, NULL);
+            if (rc != SQLITE_OK)
+                return sqlite3_extended_errcode(theDb);
+            return SQLITE_OK;
+        }
+
+        statement_execution myExecution;
+        myExecution.sql = anSql;
+        const double myLockWait = theProfiler->lock_wait_sec;
+        const double myStart = detail::now();
+        const int rc = (theRetryPolicy.max_retries > 0) ? execute_retrying(anSql) : sqlite3_exec(theDb, anSql.c_str(), NULL,NULL, NULL);
+        myExecution.elapsed_sec = detail::now() - myStart;
+        myExecution.lock_wait_sec = theProfiler->lock_wait_sec - myLockWait;
+        // sqlite3_exec() reports no statistics of the statements it runs, so count the whole script as one step
+        myExecution.steps = 1;
+        record_execution(myExecution);
+        return (rc == SQLITE_OK) ? SQLITE_OK : sqlite3_extended_errcode(theDb);
+    }
+
+    // Statement by statement like sqlite3_exec(), so that a statement failed with SQLITE_BUSY is retried alone
+    int database::execute_retrying(const string& anSql)
+    {
+        char const* mySql = anSql.c_str();
+        while (*mySql)
+        {
+            sqlite3_stmt* myStmt = NULL;
+            if (sqlite3_prepare_v2(theDb, mySql, -1, &myStmt, &mySql) != SQLITE_OK)
+                return sqlite3_errcode(theDb);
+            // comments and whitespace compile to no statement
+            if (!myStmt)
+                continue;
+            int rc = sqlite3_step(myStmt);
+            if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+                rc = retry_step(myStmt, rc);
+            while (rc == SQLITE_ROW)
+                rc = sqlite3_step(myStmt);
+            // the error of the last step is kept by the connection
+            sqlite3_finalize(myStmt);
+            if (rc != SQLITE_DONE)
+                return rc;
+        }
+        return SQLITE_OK;
+    }
+
+    int database::set_busy_timeout(int ms)
+    {
+        theBusyTimeoutMs = std::max(ms, 0);
+        if (!theProfiler)
+            return sqlite3_busy_timeout(theDb, ms);
+        install_busy_handler();
+        return SQLITE_OK;
+    }
+
+    connection_memory_status database::get_memory_status(bool aResetHighwater)
+    {
+        connection_memory_status myStatus;
+        int myCurrent = 0;
+        int myHighwater = 0;
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_LOOKASIDE_USED, &myStatus.lookaside_used, &myStatus.lookaside_highwater, aResetHighwater);
+        // the hit and miss counters are reported as high-water values
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_LOOKASIDE_HIT, &myCurrent, &myStatus.lookaside_hits, aResetHighwater);
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, &myCurrent, &myStatus.lookaside_misses_size, aResetHighwater);
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, &myCurrent, &myStatus.lookaside_misses_full, aResetHighwater);
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_CACHE_USED, &myStatus.cache_used, &myHighwater, 0);
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_SCHEMA_USED, &myStatus.schema_used, &myHighwater, 0);
+        sqlite3_db_status(theDb, SQLITE_DBSTATUS_STMT_USED, &myStatus.statements_used, &myHighwater, 0);
+        return myStatus;
+    }
+
+    void database::enable_foreign_keys(bool aEnable)
+    {
+        execute(str(boost::format("PRAGMA foreign_keys = %s;") % (aEnable?"ON":"OFF")));
+    }
+
+    bool database::in_transaction() const
+    {
+        return theDb && !sqlite3_get_autocommit(theDb);
+    }
+
+    void database::apply_options(const open_options& anOptions)
+    {
+        // lookaside can be configured only while none of it is in use, so before anything else
+        if (anOptions.lookaside_slot_size || anOptions.lookaside_slots)
+        {
+            int mySlotSize = open_options::DefaultLookasideSlotSize;
+            int mySlots = open_options::DefaultLookasideSlots;
+            if (anOptions.lookaside_slot_size)
+                mySlotSize = *anOptions.lookaside_slot_size;
+            if (anOptions.lookaside_slots)
+                mySlots = *anOptions.lookaside_slots;
+            if (sqlite3_db_config(theDb, SQLITE_DBCONFIG_LOOKASIDE, NULL, mySlotSize, mySlots) != SQLITE_OK)
+                throw database_error(*this, "Failed to configure lookaside");
+        }
+        if (anOptions.busy_timeout_ms && set_busy_timeout(*anOptions.busy_timeout_ms) != SQLITE_OK)
+            throw database_error(*this, "Failed to set busy timeout");
+        if (anOptions.page_size)
+            execute(str(boost::format("PRAGMA page_size = %d") % *anOptions.page_size));
+        if (anOptions.journal_mode)
+            execute(str(boost::format("PRAGMA journal_mode = %s") % JournalModes[*anOptions.journal_mode]));
+        if (anOptions.synchronous)
+            execute(str(boost::format("PRAGMA synchronous = %d") % *anOptions.synchronous));
+        if (anOptions.mmap_size)
+            execute(str(boost::format("PRAGMA mmap_size = %d") % *anOptions.mmap_size));
+        if (anOptions.cache_size)
+            execute(str(boost::format("PRAGMA cache_size = %d") % *anOptions.cache_size));
+        if (anOptions.temp_store)
+            execute(str(boost::format("PRAGMA temp_store = %d") % *anOptions.temp_store));
+    }
+
+    void database::read_options(int anOpenFlags)
+    {
+        theOptions = open_options();
+        theOptions.flags = anOpenFlags;
+        // the busy handler installed for profiling is not reported by the pragma
+        theOptions.busy_timeout_ms = theProfiler ? theBusyTimeoutMs : atoi(get_pragma("busy_timeout").c_str());
+        theOptions.page_size = atoi(get_pragma("page_size").c_str());
+        const string myJournalMode = get_pragma("journal_mode");
+        for (size_t i = 0; i < sizeof(JournalModes)/sizeof(JournalModes[0]); ++i)
+        {
+            if (myJournalMode == JournalModes[i])
+                theOptions.journal_mode = static_cast<JournalMode>(i);
+        }
+        theOptions.synchronous = static_cast<Synchronous>(atoi(get_pragma("synchronous").c_str()));
+        // mmap_size returns nothing when memory-mapped I/O is disabled at compile time
+        const string myMmapSize = get_pragma("mmap_size");
+        if (!myMmapSize.empty())
+            theOptions.mmap_size = strtoll(myMmapSize.c_str(), NULL, 10);
+        theOptions.cache_size = atoi(get_pragma("cache_size").c_str());
+        theOptions.temp_store = static_cast<TempStore>(atoi(get_pragma("temp_store").c_str()));
+    }
+
+    string database::get_pragma(const string& aPragma)
+    {
+        // not using query to keep the statement cache for the application statements
+        string myValue;
+        const string mySql = "PRAGMA " + aPragma;
+        if (sqlite3_exec(theDb, mySql.c_str(), getFirstColumn, &myValue, NULL) != SQLITE_OK)
+            throw database_error(*this, "Failed to execute", mySql);
+        return myValue;
+    }
+
+    void database::set_statement_cache_capacity(size_t aCapacity)
+    {
+        theStatementCacheStats.capacity = aCapacity;
+        evict_statements(aCapacity);
+    }
+
+    statement_cache_stats database::get_statement_cache_stats() const
+    {
+        return theStatementCacheStats;
+    }
+
+    void database::clear_statement_cache()
+    {
+        while (!theStatementLru.empty())
+        {
+            sqlite3_finalize(theStatementLru.back().second);
+            theStatementLru.pop_back();
+        }
+        theStatementIndex.clear();
+        theSpareLruNodes.clear();
+        theSpareIndexNodes.clear();
+        theStatementCacheStats.size = 0;
+    }
+
+    sqlite3_stmt* database::checkout_statement(const string& anSql, string& aSql)
+    {
+        StatementIndex::iterator myIt = theStatementIndex.find(anSql);
+        if (myIt != theStatementIndex.end())
+        {
+            StatementLru::iterator myLru = myIt->second;
+            sqlite3_stmt* myStmt = myLru->second;
+            // the key points to the SQL text, so take the index node out before the text
+            theSpareIndexNodes.push_back(theStatementIndex.extract(myIt));
+            aSql.swap(myLru->first);
+            theSpareLruNodes.splice(theSpareLruNodes.begin(), theStatementLru, myLru);
+            --theStatementCacheStats.size;
+            ++theStatementCacheStats.hits;
+            return myStmt;
+        }
+
+        sqlite3_stmt* myStmt = NULL;
+        const double myStart = theProfiler ? detail::now() : 0;
+        // statements kept in the cache are long-lived, which SQLite optimizes their memory for
+        const unsigned int myFlags = (theStatementCacheStats.capacity > 0) ? SQLITE_PREPARE_PERSISTENT : 0;
+        if (sqlite3_prepare_v3(theDb, anSql.c_str(), -1, myFlags, &myStmt, 0) != SQLITE_OK)
+            throw database_error(*this, "Failed to prepare", anSql);
+        if (theStatementCacheStats.capacity > 0)
+            ++theStatementCacheStats.misses;
+        if (theProfiler)
+        {
+            statement_profile& myProfile = theProfiler->get_entry(anSql).profile;
+            ++myProfile.prepares;
+            myProfile.prepare_sec += detail::now() - myStart;
+        }
+        aSql = anSql;
+        return myStmt;
+    }
+
+    void database::checkin_statement(string& aSql, sqlite3_stmt* aStmt)
+    {
+        if (theStatementCacheStats.capacity == 0 || !theDb || sqlite3_db_handle(aStmt) != theDb)
+        {
+            if (sqlite3_finalize(aStmt) != SQLITE_OK)
+                throw database_error(*this, "Failed to finalise", aSql);
+            return;
+        }
+
+        // sqlite3_reset() reports the outcome of the last step which is of no interest here
+        sqlite3_reset(aStmt);
+        sqlite3_clear_bindings(aStmt);
+        if (theSpareLruNodes.empty())
+            theStatementLru.push_front(std::make_pair(string(), aStmt));
+        else
+            theStatementLru.splice(theStatementLru.begin(), theSpareLruNodes, theSpareLruNodes.begin());
+        theStatementLru.front().first.swap(aSql);
+        theStatementLru.front().second = aStmt;
+
+        const boost::string_view myKey(theStatementLru.front().first);
+        if (theSpareIndexNodes.empty())
+        {
+            theStatementIndex.insert(std::make_pair(myKey, theStatementLru.begin()));
+        }
+        else
+        {
+            StatementIndex::node_type& myNode = theSpareIndexNodes.back();
+            myNode.key() = myKey;
+            myNode.mapped() = theStatementLru.begin();
+            theStatementIndex.insert(std::move(myNode));
+            theSpareIndexNodes.pop_back();
+        }
+        ++theStatementCacheStats.size;
+        evict_statements(theStatementCacheStats.capacity);
+    }
+
+    void database::evict_statements(size_t aMaxSize)
+    {
+        while (theStatementCacheStats.size > aMaxSize)
+        {
+            StatementLru::iterator myLru = --theStatementLru.end();
+            std::pair<StatementIndex::iterator, StatementIndex::iterator> myRange = theStatementIndex.equal_range(boost::string_view(myLru->first));
+            for (StatementIndex::iterator myIt = myRange.first; myIt != myRange.second; ++myIt)
+            {
+                if (myIt->second == myLru)
+                {
+                    theSpareIndexNodes.push_back(theStatementIndex.extract(myIt));
+                    break;
+                }
+            }
+            sqlite3_finalize(myLru->second);
+            theSpareLruNodes.splice(theSpareLruNodes.begin(), theStatementLru, myLru);
+            --theStatementCacheStats.size;
+            ++theStatementCacheStats.evictions;
+        }
+    }
+
+    void database::enable_profiling(bool anEnable)
+    {
+        if (anEnable == is_profiling_enabled())
+            return;
+        if (anEnable)
+            theProfiler.reset(new profiler());
+        else
+            theProfiler.reset();
+        if (theDb)
+            set_busy_timeout(theBusyTimeoutMs);
+    }
+
+    bool database::is_profiling_enabled() const
+    {
+        return theProfiler.get() != NULL;
+    }
+
+    void database::set_slow_query_callback(double aThresholdSec, const slow_query_callback& aCallback)
+    {
+        if (!theProfiler)
+            throw database_error("Cannot set slow query callback because profiling is disabled");
+        theProfiler->slow_query_threshold_sec = aThresholdSec;
+        theProfiler->slow_query = aCallback;
+    }
+
+    std::vector<statement_profile> database::get_profile() const
+    {
+        std::vector<statement_profile> myProfile;
+        if (!theProfiler)
+            return myProfile;
+        myProfile.reserve(theProfiler->entries.size());
+        for (boost::unordered_map<string, profiler::entry>::const_iterator it = theProfiler->entries.begin(); it != theProfiler->entries.end(); ++it)
+        {
+            myProfile.push_back(it->second.profile);
+            myProfile.back().p50_sec = theProfiler->percentile(it->second, 0.5);
+            myProfile.back().p99_sec = theProfiler->percentile(it->second, 0.99);
+        }
+        std::sort(myProfile.begin(), myProfile.end(), compareTotalTime);
+        return myProfile;
+    }
+
+    void database::export_profile(std::ostream& anOs) const
+    {
+        const std::vector<statement_profile> myProfile = get_profile();
+        anOs << "[";
+        for (size_t i = 0; i < myProfile.size(); ++i)
+        {
+            const statement_profile& p = myProfile[i];
+            anOs << (i ? ",\n " : "\n ")
+                 << str(boost::format("{\"sql\": %s, \"prepares\": %u, \"prepare_sec\": %.9f, \"executions\": %u, \"steps\": %u, \"rows\": %u, "
+                                      "\"total_sec\": %.9f, \"p50_sec\": %.9f, \"p99_sec\": %.9f, \"max_sec\": %.9f, \"lock_wait_sec\": %.9f, "
+                                      "\"fullscan_steps\": %d, \"sorts\": %d, \"autoindexes\": %d, \"vm_steps\": %d}")
+                        % toJsonString(p.sql) % p.prepares % p.prepare_sec % p.executions % p.steps % p.rows
+                        % p.total_sec % p.p50_sec % p.p99_sec % p.max_sec % p.lock_wait_sec
+                        % p.fullscan_steps % p.sorts % p.autoindexes % p.vm_steps);
+        }
+        anOs << "\n]\n";
+    }
+
+    void database::reset_profile()
+    {
+        if (theProfiler)
+            theProfiler->entries.clear();
+    }
+
+    int database::profiling_busy_handler(void* aDb, int aCount)
+    {
+        // the same backoff as used by sqlite3_busy_timeout()
+        static const int Delays[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+        static const int Totals[] = { 0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178, 228 };
+        static const int LastDelay = sizeof(Delays)/sizeof(Delays[0]) - 1;
+
+        database* myDb = static_cast<database*>(aDb);
+        int myDelay = Delays[std::min(aCount, LastDelay)];
+        const int myPrior = (aCount <= LastDelay) ? Totals[aCount] : Totals[LastDelay] + myDelay * (aCount - LastDelay);
+        if (myPrior + myDelay > myDb->theBusyTimeoutMs)
+        {
+            myDelay = myDb->theBusyTimeoutMs - myPrior;
+            if (myDelay <= 0)
+                return 0;
+        }
+        const double myStart = detail::now();
+        sqlite3_sleep(myDelay);
+        if (myDb->theProfiler)
+            myDb->theProfiler->lock_wait_sec += detail::now() - myStart;
+        return 1;
+    }
+
+    void database::install_busy_handler()
+    {
+        if (theBusyTimeoutMs > 0)
+            sqlite3_busy_handler(theDb, profiling_busy_handler, this);
+        else
+            sqlite3_busy_handler(theDb, NULL, NULL);
+    }
+
+    void database::record_execution(const statement_execution& anExecution)
+    {
+        profiler::entry& myEntry = theProfiler->get_entry(anExecution.sql);
+        statement_profile& myProfile = myEntry.profile;
+        ++myProfile.executions;
+        myProfile.steps += anExecution.steps;
+        myProfile.rows += anExecution.rows;
+        myProfile.total_sec += anExecution.elapsed_sec;
+        myProfile.max_sec = std::max(myProfile.max_sec, anExecution.elapsed_sec);
+        myProfile.lock_wait_sec += anExecution.lock_wait_sec;
+        myProfile.fullscan_steps += anExecution.fullscan_steps;
+        myProfile.sorts += anExecution.sorts;
+        myProfile.autoindexes += anExecution.autoindexes;
+        myProfile.vm_steps += anExecution.vm_steps;
+        ++myEntry.histogram[toHistogramBucket(anExecution.elapsed_sec)];
+
+        if (theProfiler->slow_query && anExecution.elapsed_sec >= theProfiler->slow_query_threshold_sec)
+        {
+            try { theProfiler->slow_query(anExecution); }
+            catch (...) {}
+        }
+    }
+
+    void database::begin_execution(sqlite3_stmt* aStmt, statement_execution& anExecution)
+    {
+        // the counters are cumulative for the prepared statement, start from 0 for this execution
+        sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+        sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_SORT, 1);
+        sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+        sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+        anExecution = statement_execution();
+    }
+
+    int database::profiled_step(sqlite3_stmt* aStmt, statement_execution& anExecution)
+    {
+        const double myLockWait = theProfiler->lock_wait_sec;
+        const double myStart = detail::now();
+        const bool myFirstStep = !sqlite3_stmt_busy(aStmt);
+        int rc = sqlite3_step(aStmt);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE && myFirstStep)
+            rc = retry_step(aStmt, rc);
+        anExecution.elapsed_sec += detail::now() - myStart;
+        anExecution.lock_wait_sec += theProfiler->lock_wait_sec - myLockWait;
+        ++anExecution.steps;
+        if (rc == SQLITE_ROW)
+            ++anExecution.rows;
+        return rc;
+    }
+
+    void database::end_execution(sqlite3_stmt* aStmt, statement_execution& anExecution)
+    {
+        anExecution.fullscan_steps = sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+        anExecution.sorts = sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_SORT, 0);
+        anExecution.autoindexes = sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+        anExecution.vm_steps = sqlite3_stmt_status(aStmt, SQLITE_STMTSTATUS_VM_STEP, 0);
+        record_execution(anExecution);
+    }
+
+    void database::add_change_listener(change_listener* aListener)
+    {
+        if (std::find(theChangeListeners.begin(), theChangeListeners.end(), aListener) != theChangeListeners.end())
+            return;
+        theChangeListeners.push_back(aListener);
+        if (theChangeListeners.size() == 1)
+            install_update_hook();
+    }
+
+    void database::remove_change_listener(change_listener* aListener)
+    {
+        theChangeListeners.erase(std::remove(theChangeListeners.begin(), theChangeListeners.end(), aListener), theChangeListeners.end());
+        if (theChangeListeners.empty())
+            install_update_hook();
+    }
+
+    void database::check_unreported_changes()
+    {
+        if (!theDb || theChangeListeners.empty())
+            return;
+        // unsigned arithmetic keeps the difference right when the counter wraps
+        const unsigned int myTotal = sqlite3_total_changes(theDb);
+        const bool myUnreported = (myTotal - theTotalChanges) > theReportedChanges;
+        theTotalChanges = myTotal;
+        theReportedChanges = 0;
+        if (myUnreported)
+        {
+            for (size_t i = 0; i < theChangeListeners.size(); ++i)
+                theChangeListeners[i]->on_unreported_changes();
+        }
+    }
+
+    void database::notify_savepoint_rollback()
+    {
+        for (size_t i = 0; i < theChangeListeners.size(); ++i)
+            theChangeListeners[i]->on_savepoint_rollback();
+    }
+
+    void database::update_hook(void* aDb, int anOp, char const* aDbName, char const* aTable, sqlite3_int64 aRowId)
+    {
+        database* myDb = static_cast<database*>(aDb);
+        ++myDb->theReportedChanges;
+        for (size_t i = 0; i < myDb->theChangeListeners.size(); ++i)
+            myDb->theChangeListeners[i]->on_row_changed(anOp, aDbName, aTable, aRowId);
+    }
+
+    void database::install_update_hook()
+    {
+        if (!theDb)
+            return;
+        theReportedChanges = 0;
+        theTotalChanges = sqlite3_total_changes(theDb);
+        if (theChangeListeners.empty())
+            sqlite3_update_hook(theDb, NULL, NULL);
+        else
+            sqlite3_update_hook(theDb, update_hook, this);
+    }
+
+    void database::set_retry_policy(const retry_policy& aPolicy)
+    {
+        theRetryPolicy = aPolicy;
+    }
+
+    const retry_policy& database::get_retry_policy() const
+    {
+        return theRetryPolicy;
+    }
+
+    retry_stats database::get_retry_stats() const
+    {
+        return theRetryStats;
+    }
+
+    int database::retry_step(sqlite3_stmt* aStmt, int aRc)
+    {
+        if (((aRc & 0xff) != SQLITE_BUSY && (aRc & 0xff) != SQLITE_LOCKED) || theRetryPolicy.max_retries <= 0)
+            return aRc;
+        if (!sqlite3_get_autocommit(theDb) && !isCommit(aStmt))
+            return aRc;
+
+        const double myStart = detail::now();
+        const double myDeadline = (theRetryPolicy.deadline_ms > 0) ? myStart + theRetryPolicy.deadline_ms / 1000.0 : 0;
+        int rc = aRc;
+        for (int myRetry = 0; myRetry < theRetryPolicy.max_retries && ((rc & 0xff) == SQLITE_BUSY || (rc & 0xff) == SQLITE_LOCKED); ++myRetry)
+        {
+            bool myWaited;
+            if (sqlite3_extended_errcode(theDb) == SQLITE_LOCKED_SHAREDCACHE && theRetryPolicy.unlock_notify)
+            {
+                myWaited = wait_for_unlock(myDeadline);
+            }
+            else
+            {
+                const double myMaxDelay = std::min<double>(theRetryPolicy.max_delay_ms, ldexp(theRetryPolicy.initial_delay_ms, std::min(myRetry, 30)));
+                double myDelay = myMaxDelay / 2 + std::uniform_real_distribution<double>(0, myMaxDelay / 2)(theRetryRandom);
+                if (myDeadline > 0)
+                    myDelay = std::min(myDelay, (myDeadline - detail::now()) * 1000);
+                myWaited = (myDelay > 0);
+                if (myWaited)
+                    std::this_thread::sleep_for(std::chrono::microseconds(static_cast<sqlite3_int64>(myDelay * 1000)));
+            }
+            if (!myWaited)
+                break;
+            if ((rc & 0xff) == SQLITE_BUSY)
+                ++theRetryStats.busy;
+            else
+                ++theRetryStats.locked;
+            // the statement keeps its bindings
+            sqlite3_reset(aStmt);
+            rc = sqlite3_step(aStmt);
+        }
+
+        const double myWait = detail::now() - myStart;
+        theRetryStats.wait_sec += myWait;
+        theRetryStats.max_wait_sec = std::max(theRetryStats.max_wait_sec, myWait);
+        if (theProfiler)
+            theProfiler->lock_wait_sec += myWait;
+        if ((rc & 0xff) == SQLITE_BUSY || (rc & 0xff) == SQLITE_LOCKED)
+            ++theRetryStats.failures;
+        return rc;
+    }
+
+    bool database::wait_for_unlock(double aDeadline)
+    {
+        unlock_notification myNotification;
+        // SQLITE_LOCKED means that waiting would deadlock
+        if (sqlite3_unlock_notify(theDb, unlockNotify, &myNotification) != SQLITE_OK)
+            return false;
+        std::unique_lock<std::mutex> myLock(myNotification.mutex);
+        if (aDeadline <= 0)
+        {
+            while (!myNotification.fired)
+                myNotification.cond.wait(myLock);
+            return true;
+        }
+        const double myTimeout = aDeadline - detail::now();
+        if (myTimeout > 0)
+            myNotification.cond.wait_for(myLock, std::chrono::microseconds(static_cast<sqlite3_int64>(myTimeout * 1e6)),
+                                         [&myNotification] { return myNotification.fired; });
+        if (myNotification.fired)
+            return true;
+        myLock.unlock();
+        // cancel the notification, which SQLite serializes with delivering it
+        sqlite3_unlock_notify(theDb, NULL, NULL);
+        return false;
+    }
+
+    void database::rebind_hooks()
     {
-        close();
-        createIfNotExist(aDbPath, aDbCreateSql);
+        if (!theDb)
+            return;
+        if (theProfiler)
+            install_busy_handler();
+        if (!theChangeListeners.empty())
+            sqlite3_update_hook(theDb, update_hook, this);
+        if (theWalCallback)
+            sqlite3_wal_hook(theDb, wal_hook, this);
+    }
 
-        int rc = sqlite3_open(aDbPath.c_str(), &theDb);
-        if (rc != SQLITE_OK)
-            throw database_error(str(boost::format("Failed to open Db %s. Sqlite3 error code: %d") % aDbPath % rc));
+    checkpoint_result database::checkpoint(CheckpointMode aMode, const string& aDbName)
+    {
+        static const int Modes[] = { SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_FULL, SQLITE_CHECKPOINT_RESTART, SQLITE_CHECKPOINT_TRUNCATE };
+        checkpoint_result myResult;
+        const int rc = sqlite3_wal_checkpoint_v2(theDb, aDbName.empty() ? NULL : aDbName.c_str(), Modes[aMode],
+                                                 &myResult.log_frames, &myResult.checkpointed_frames);
+        if (rc == SQLITE_BUSY)
+            myResult.busy = true;
+        else if (rc != SQLITE_OK)
+            throw database_error(*this, "Failed to checkpoint WAL");
+        return myResult;
+    }
 
-        if (!anExtensionPath.empty())
-            load_extension(anExtensionPath);
+    void database::set_wal_callback(const wal_callback& aCallback)
+    {
+        theWalCallback = aCallback;
+        if (theDb)
+            sqlite3_wal_hook(theDb, theWalCallback ? wal_hook : NULL, this);
+    }
 
-        theDbPath = aDbPath;
+    void database::set_wal_autocheckpoint(int aFrames)
+    {
+        theWalCallback = wal_callback();
+        if (sqlite3_wal_autocheckpoint(theDb, aFrames) != SQLITE_OK)
+            throw database_error(*this, "Failed to set WAL autocheckpoint");
     }
 
-    void database::close()
+    int database::get_wal_autocheckpoint()
     {
-        if (theDb)
-        {
-            if (sqlite3_close(theDb) != SQLITE_OK)
-                throw database_error(*this, "Failed to close Db.");
-            theDb = NULL;
-            theDbPath = "";
-        }
+        return atoi(get_pragma("wal_autocheckpoint").c_str());
     }
 
-    sqlite3_int64 database::last_insert_rowid() const
+    int database::wal_hook(void* aDb, sqlite3*, char const* aDbName, int aFrames)
     {
-        return sqlite3_last_insert_rowid(theDb);
+        // the commit has already succeeded, so failures of the callback are not reported to SQLite
+        try { static_cast<database*>(aDb)->theWalCallback(aDbName, aFrames); }
+        catch (...) {}
+        return SQLITE_OK;
     }
 
-    void database::execute(const string& anSql)
+    void database::backup_to(database& aTarget, int aPagesPerStep, unsigned int aSleepMs, const backup_progress_callback& aProgress)
     {
-        if (sqlite3_exec(theDb, anSql.c_str(), NULL,NULL, NULL) != SQLITE_OK)
-            throw database_error(*this, str(boost::format("Failed to execute '%s'.") % anSql));
+        if (!theDb || !aTarget.theDb)
+            throw database_error("Cannot back up Db because the source or the target Db is not open");
+
+        sqlite3_backup* myBackup = sqlite3_backup_init(aTarget.theDb, "main", theDb, "main");
+        if (!myBackup)
+            throw database_error(aTarget, str(boost::format("Failed to start backup of Db %s") % theDbPath));
+
+        int rc = SQLITE_OK;
+        try
+        {
+            do
+            {
+                rc = sqlite3_backup_step(myBackup, aPagesPerStep);
+                if (aProgress)
+                    aProgress(sqlite3_backup_remaining(myBackup), sqlite3_backup_pagecount(myBackup));
+                // busy and locked are transient, the step is retried after the pause
+                if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+                    sqlite3_sleep((rc == SQLITE_OK) ? aSleepMs : std::max(aSleepMs, 1U));
+            }
+            while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+        }
+        catch (...)
+        {
+            sqlite3_backup_finish(myBackup);
+            throw;
+        }
+
+        // the error of the failed step, if any, is reported on the target connection
+        if (sqlite3_backup_finish(myBackup) != SQLITE_OK)
+            throw database_error(aTarget, str(boost::format("Failed to back up Db %s") % theDbPath));
     }
 
-    int database::set_busy_timeout(int ms)
+    void database::backup_to(const string& aPath, int aPagesPerStep, unsigned int aSleepMs, const backup_progress_callback& aProgress)
     {
-        return sqlite3_busy_timeout(theDb, ms);
+        const string myTmpPath = aPath + ".tmp";
+        remove(myTmpPath.c_str());
+        try
+        {
+            database myTarget;
+            myTarget.open(myTmpPath, "");
+            backup_to(myTarget, aPagesPerStep, aSleepMs, aProgress);
+            myTarget.close();
+        }
+        catch (...)
+        {
+            remove(myTmpPath.c_str());
+            throw;
+        }
+        if (rename(myTmpPath.c_str(), aPath.c_str()) != 0)
+        {
+            remove(myTmpPath.c_str());
+            throw database_error(str(boost::format("Failed to rename backup of Db %s to %s") % theDbPath % aPath));
+        }
     }
 
-    void database::enable_foreign_keys(bool aEnable)
+    void database::snapshot_to(database& aSnapshot)
     {
-        execute(str(boost::format("PRAGMA foreign_keys = %s;") % (aEnable?"ON":"OFF")));
+        aSnapshot.open(":memory:", "");
+        // a single step keeps the read lock for the whole copy, so the snapshot is consistent
+        backup_to(aSnapshot, -1);
+        aSnapshot.execute("PRAGMA query_only = 1");
     }
 
     void database::load_extension(const string& anExtensionPath)
@@ -162,12 +1276,35 @@ namespace sqlite3cpp
     //
 
     statement::statement(database& db, const string& anSql)
-        : theDb(db), theStmt(NULL), theCurBindIndx(1)
+        : theDb(&db), theStmt(NULL), theDone(false), theParamIndexBuilt(false), theCurBindIndx(1), theExecuting(false)
     {
         if (!anSql.empty())
             prepare(anSql);
     }
 
+    statement::statement(statement&& other)
+        : theDb(other.theDb), theStmt(NULL), theDone(false), theParamIndexBuilt(false), theCurBindIndx(1), theExecuting(false)
+    {
+        *this = std::move(other);
+    }
+
+    statement& statement::operator=(statement&& other)
+    {
+        if (this == &other)
+            return *this;
+        finish();
+        theDb = other.theDb;
+        theSql.swap(other.theSql);
+        std::swap(theStmt, other.theStmt);
+        std::swap(theDone, other.theDone);
+        theParamIndex.swap(other.theParamIndex);
+        std::swap(theParamIndexBuilt, other.theParamIndexBuilt);
+        std::swap(theCurBindIndx, other.theCurBindIndx);
+        std::swap(theExecution, other.theExecution);
+        std::swap(theExecuting, other.theExecuting);
+        return *this;
+    }
+
     statement::~statement()
     {
         try { finish(); }
@@ -177,92 +1314,179 @@ namespace sqlite3cpp
     void statement::prepare(const string& anSql)
     {
         finish();
-        if (sqlite3_prepare(theDb.theDb, anSql.c_str(), -1, &theStmt, 0) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to prepare query '%s'") % anSql));
-        theSql = anSql;
+        theStmt = theDb->checkout_statement(anSql, theSql);
+        theDone = false;
     }
 
     void statement::finish()
     {
         if (theStmt)
         {
-            if (sqlite3_finalize(theStmt) != SQLITE_OK)
-                throw database_error(theDb, str(boost::format("Failed to finalise query '%s'") % theSql));
+            end_execution();
+            sqlite3_stmt* myStmt = theStmt;
+            string mySql;
+            mySql.swap(theSql);
             theStmt = NULL;
-            theSql = "";
+            theDone = false;
+            theParamIndex.clear();
+            theParamIndexBuilt = false;
             theCurBindIndx = 1;
+            theDb->checkin_statement(mySql, myStmt);
         }
     }
 
+    int statement::parameter_count() const
+    {
+        return sqlite3_bind_parameter_count(theStmt);
+    }
+
     void statement::reset(ClearBindings aClearBindings)
     {
+        end_execution();
+        theDone = false;
         if (sqlite3_reset(theStmt) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to reset query '%s'") % theSql));
+            throw_error("Failed to reset");
         if (aClearBindings == clearBindingsOn)
         {
             if (sqlite3_clear_bindings(theStmt) != SQLITE_OK)
-                throw database_error(theDb, str(boost::format("Failed to clear bindings for query '%s'") % theSql));
+                throw_error("Failed to clear bindings of");
             theCurBindIndx = 1;
         }
     }
 
     int statement::step()
     {
-        return sqlite3_step(theStmt);
+        if (theDb->theProfiler)
+            return profiled_step();
+        // a statement failed after returning rows cannot be rerun without returning them again
+        const bool myFirstStep = !sqlite3_stmt_busy(theStmt);
+        int rc = sqlite3_step(theStmt);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE && myFirstStep)
+            rc = theDb->retry_step(theStmt, rc);
+        theDone = (rc == SQLITE_DONE);
+        return rc;
+    }
+
+    int statement::profiled_step()
+    {
+        if (!theExecuting)
+        {
+            theDb->begin_execution(theStmt, theExecution);
+            theExecuting = true;
+        }
+        const int rc = theDb->profiled_step(theStmt, theExecution);
+        theDone = (rc == SQLITE_DONE);
+        if (rc != SQLITE_ROW)
+            end_execution();
+        return rc;
+    }
+
+    void statement::end_execution()
+    {
+        if (!theExecuting)
+            return;
+        theExecuting = false;
+        if (!theDb->theProfiler)
+            return;
+        theExecution.sql = theSql;
+        theDb->end_execution(theStmt, theExecution);
+    }
+
+    void statement::rewind()
+    {
+        end_execution();
+        sqlite3_reset(theStmt);
+        theDone = false;
     }
 
-    void statement::bind(int idx, int value)
+    bool statement::step_row()
     {
-        bind(idx, static_cast<long int>(value));
+        const int rc = step();
+        if (rc == SQLITE_ROW)
+            return true;
+        if (rc == SQLITE_DONE)
+            return false;
+        throw_error("Failed to step through");
     }
 
-    void statement::bind(int idx, long int value)
+    int statement::try_step()
     {
-        if (sqlite3_bind_int(theStmt, idx, value) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind integer value at position %d for query '%s'") % idx % theSql));
+        const int rc = step();
+        if (rc == SQLITE_ROW || rc == SQLITE_DONE)
+            return rc;
+        const int myExtendedRc = sqlite3_extended_errcode(theDb->theDb);
+        rewind();
+        return myExtendedRc;
     }
 
-    void statement::bind(int idx, unsigned int value)
+    void statement::throw_error(const char* aWhat, int aParamIndex) const
     {
-        bind(idx, static_cast<unsigned long>(value));
+        throw database_error(*theDb, aWhat, theSql, aParamIndex);
     }
 
-    void statement::bind(int idx, unsigned long value)
+    void statement::bind_int64(int idx, sqlite3_int64 value)
     {
-        if (value > INT_MAX)
-            throw database_error(str(boost::format("Failed to bind unsigned integer value %1% because it cannot be promoted to an integer") % value));
-        if (sqlite3_bind_int(theStmt, idx, value) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind unsigned integer value at position %d for query '%s'") % idx % theSql));
+        if (sqlite3_bind_int64(theStmt, idx, value) != SQLITE_OK)
+            throw_error("Failed to bind integer value", idx);
     }
 
     void statement::bind(int idx, double value)
     {
         if (sqlite3_bind_double(theStmt, idx, value) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind double value at position %d for query '%s'") % idx % theSql));
+            throw_error("Failed to bind double value", idx);
     }
 
-    void statement::bind(int idx, sqlite3_int64 value)
+    void statement::bind(int idx, boost::string_view value, BindLifetime aLifetime)
     {
-        if (sqlite3_bind_int64(theStmt, idx, value) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind int64 value at position %d for query '%s'") % idx % theSql));
+        bind_text(idx, value, toDestructor(aLifetime));
     }
 
-    void statement::bind(int idx, const string& value)
+    void statement::bind(int idx, void const* value, int n, BindLifetime aLifetime)
     {
-        if (sqlite3_bind_text(theStmt, idx, value.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind string value at position %d for query '%s'") % idx % theSql));
+        bind_blob(idx, blob_view(value, n), toDestructor(aLifetime));
     }
 
-    void statement::bind(int idx, void const* value, int n)
+    void statement::bind(int idx, blob_view value, BindLifetime aLifetime)
     {
-        if (sqlite3_bind_blob(theStmt, idx, value, n, SQLITE_TRANSIENT) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind BLOB value at position %d for query '%s'") % idx % theSql));
+        bind_blob(idx, value, toDestructor(aLifetime));
+    }
+
+    void statement::bind(int idx, boost::string_view value, sqlite3_destructor_type aDestructor)
+    {
+        bind_text(idx, value, aDestructor);
+    }
+
+    void statement::bind(int idx, blob_view value, sqlite3_destructor_type aDestructor)
+    {
+        bind_blob(idx, value, aDestructor);
+    }
+
+    void statement::bind_text(int idx, boost::string_view value, sqlite3_destructor_type aDestructor)
+    {
+        // SQLite treats NULL pointer as SQL NULL, bind empty string instead.
+        // The literal shall not be disposed, and there is nothing to dispose of a NULL pointer, which SQLite does not do either.
+        const bool myNull = !value.data();
+        char const* myValue = myNull ? "" : value.data();
+        if (sqlite3_bind_text64(theStmt, idx, myValue, value.size(), myNull ? SQLITE_STATIC : aDestructor, SQLITE_UTF8) != SQLITE_OK)
+            throw_error("Failed to bind string value", idx);
+    }
+
+    void statement::bind_blob(int idx, blob_view value, sqlite3_destructor_type aDestructor)
+    {
+        if (sqlite3_bind_blob64(theStmt, idx, value.data, value.size, aDestructor) != SQLITE_OK)
+            throw_error("Failed to bind BLOB value", idx);
+    }
+
+    void statement::bind(int idx, zeroblob value)
+    {
+        if (sqlite3_bind_zeroblob64(theStmt, idx, value.size) != SQLITE_OK)
+            throw_error("Failed to bind zeroblob value", idx);
     }
 
     void statement::bind(int idx)
     {
         if (sqlite3_bind_null(theStmt, idx) != SQLITE_OK)
-            throw database_error(theDb, str(boost::format("Failed to bind NULL value at position %d for query '%s'") % idx % theSql));
+            throw_error("Failed to bind NULL value", idx);
     }
 
     void statement::bind(int idx, null_type)
@@ -270,77 +1494,76 @@ namespace sqlite3cpp
         bind(idx);
     }
 
-    void statement::bind(const string& name, int value)
+    void statement::bind(boost::string_view name, double value)
+    {
+        return bind(bind_parameter_index(name), value);
+    }
+
+    void statement::bind(boost::string_view name, boost::string_view value, BindLifetime aLifetime)
     {
-        bind(name, static_cast<long int>(value));
+        return bind(bind_parameter_index(name), value, aLifetime);
     }
 
-    void statement::bind(const string& name, long int value)
+    void statement::bind(boost::string_view name, void const* value, int n, BindLifetime aLifetime)
     {
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx, value);
+        return bind(bind_parameter_index(name), value, n, aLifetime);
     }
 
-    void statement::bind(const string& name, unsigned int value)
+    void statement::bind(boost::string_view name, blob_view value, BindLifetime aLifetime)
     {
-        bind(name, static_cast<unsigned long>(value));
+        return bind(bind_parameter_index(name), value, aLifetime);
     }
 
-    void statement::bind(const string& name, unsigned long value)
+    void statement::bind(boost::string_view name, boost::string_view value, sqlite3_destructor_type aDestructor)
     {
-        if (value > INT_MAX)
-            throw database_error(str(boost::format("Failed to bind unsigned integer value %1% because it cannot be promoted to an integer") % value));
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx, value);
+        return bind(bind_parameter_index(name), value, aDestructor);
     }
 
-    void statement::bind(const string& name, double value)
+    void statement::bind(boost::string_view name, blob_view value, sqlite3_destructor_type aDestructor)
     {
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx, value);
+        return bind(bind_parameter_index(name), value, aDestructor);
     }
 
-    void statement::bind(const string& name, sqlite3_int64 value)
+    void statement::bind(boost::string_view name, zeroblob value)
     {
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx, value);
+        return bind(bind_parameter_index(name), value);
     }
 
-    void statement::bind(const string& name, const string& value)
+    void statement::bind(boost::string_view name)
     {
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx, value);
+        return bind(bind_parameter_index(name));
     }
 
-    void statement::bind(const string& name, void const* value, int n)
+    void statement::bind(boost::string_view name, null_type)
     {
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx, value, n);
+        return bind(name);
     }
 
-    void statement::bind(const string& name)
+    param_handle statement::get_param(boost::string_view name) const
     {
-        int idx = sqlite3_bind_parameter_index(theStmt, name.c_str());
-        if (idx <= 0)
-            throw database_error(theDb, str(boost::format("Invalid bind placeholder %s for query '%s'") % name % theSql));
-        return bind(idx);
+        return param_handle(bind_parameter_index(name));
     }
 
-    void statement::bind(const string& name, null_type)
+    int statement::bind_parameter_index(boost::string_view name) const
     {
-        return bind(name);
+        if (!theParamIndexBuilt)
+        {
+            // sqlite3_bind_parameter_index() scans all parameters comparing names, so index them once
+            const int myCount = sqlite3_bind_parameter_count(theStmt);
+            theParamIndex.reserve(myCount);
+            for (int i = 1; i <= myCount; ++i)
+            {
+                // a name used several times in the SQL has a single index, nameless parameters have no name
+                if (char const* myName = sqlite3_bind_parameter_name(theStmt, i))
+                    theParamIndex.push_back(std::make_pair(string(myName), i));
+            }
+            std::sort(theParamIndex.begin(), theParamIndex.end());
+            theParamIndexBuilt = true;
+        }
+        ParamIndex::const_iterator myIt = std::lower_bound(theParamIndex.begin(), theParamIndex.end(), name, paramNameLess);
+        if (myIt == theParamIndex.end() || boost::string_view(myIt->first) != name)
+            throwInvalidPlaceholder(name, theSql);
+        return myIt->second;
     }
 
 
@@ -356,7 +1579,13 @@ namespace sqlite3cpp
     void command::execute()
     {
         if (step() != SQLITE_DONE)
-            throw database_error(theDb, str(boost::format("Failed to execute command '%s'") % theSql));
+            throw_error("Failed to execute");
+    }
+
+    int command::try_execute()
+    {
+        const int rc = try_step();
+        return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
     }
 
 
@@ -364,74 +1593,70 @@ namespace sqlite3cpp
     // Query
     //
 
-    query::row::row(sqlite3_stmt* stmt, const string& anSql)
-        : theStmt(stmt), theSql(anSql), theCurGetIndex(1)
+    query::row::row(sqlite3_stmt* stmt)
+        : theStmt(stmt), theCurGetIndex(1)
     {
         if (!theStmt)
             throw database_error("Statement is NULL");
     }
 
-
-    int query::row::get(int idx, int) const
+    void query::row::check_column(int idx) const
     {
         if (idx > sqlite3_data_count(theStmt))
-            throw database_error(str(boost::format("Column %d is out-of-bounds for query '%s'") % idx % theSql));
-
-        return sqlite3_column_int(theStmt, idx-1);
+            throwColumnOutOfBounds(idx, theStmt);
     }
 
-    long int query::row::get(int idx, long int) const
-    {
-        return static_cast<long int>(get<int>(idx));
-    }
 
-    unsigned int query::row::get(int idx, unsigned int) const
+    sqlite3_int64 query::row::get_int64(int idx) const
     {
-        return static_cast<unsigned int>(get<int>(idx));
-    }
+        check_column(idx);
 
-    unsigned long query::row::get(int idx, unsigned long int) const
-    {
-        return static_cast<unsigned long>(get<int>(idx));
+        return sqlite3_column_int64(theStmt, idx-1);
     }
 
     double query::row::get(int idx, double) const
     {
-        if (idx > sqlite3_data_count(theStmt))
-            throw database_error(str(boost::format("Column %d is out-of-bounds for query '%s'") % idx % theSql));
+        check_column(idx);
 
         return sqlite3_column_double(theStmt, idx-1);
     }
 
-    sqlite3_int64 query::row::get(int idx, sqlite3_int64) const
-    {
-        if (idx > sqlite3_data_count(theStmt))
-            throw database_error(str(boost::format("Column %d is out-of-bounds for query '%s'") % idx % theSql));
-
-        return sqlite3_column_int64(theStmt, idx-1);
-    }
-
     char const* query::row::get(int idx, char const*) const
     {
-        if (idx > sqlite3_data_count(theStmt))
-            throw database_error(str(boost::format("Column %d is out-of-bounds for query '%s'") % idx % theSql));
+        check_column(idx);
 
         return reinterpret_cast<char const*>(sqlite3_column_text(theStmt, idx-1));
     }
 
     string query::row::get(int idx, string) const
     {
-        return get(idx, (char const*)NULL);
+        const boost::string_view myValue = get(idx, boost::string_view());
+        return string(myValue.data() ? myValue.data() : "", myValue.size());
+    }
+
+    boost::string_view query::row::get(int idx, boost::string_view) const
+    {
+        check_column(idx);
+
+        char const* myValue = reinterpret_cast<char const*>(sqlite3_column_text(theStmt, idx-1));
+        return boost::string_view(myValue, myValue ? sqlite3_column_bytes(theStmt, idx-1) : 0);
     }
 
     void const* query::row::get(int idx, void const*) const
     {
-        if (idx > sqlite3_data_count(theStmt))
-            throw database_error(str(boost::format("Column %d is out-of-bounds for query '%s'") % idx % theSql));
+        check_column(idx);
 
         return sqlite3_column_blob(theStmt, idx-1);
     }
 
+    blob_view query::row::get(int idx, blob_view) const
+    {
+        check_column(idx);
+
+        void const* myValue = sqlite3_column_blob(theStmt, idx-1);
+        return blob_view(myValue, myValue ? sqlite3_column_bytes(theStmt, idx-1) : 0);
+    }
+
     null_type query::row::get(int idx, null_type) const
     {
         return ignore;
@@ -450,7 +1675,7 @@ namespace sqlite3cpp
             throw database_error("NULL query passed");
         theRc = theQuery->step();
         if (theRc != SQLITE_ROW && theRc != SQLITE_DONE)
-            throw database_error(theQuery->theDb, str(boost::format("Failed to step through the query '%s'") % theQuery->theSql));
+            theQuery->throw_error("Failed to step through");
     }
 
     void query::query_iterator::increment()
@@ -459,7 +1684,7 @@ namespace sqlite3cpp
             throw database_error("Cannot increment NULL query");
         theRc = theQuery->step();
         if (theRc != SQLITE_ROW && theRc != SQLITE_DONE)
-            throw database_error(theQuery->theDb, str(boost::format("Failed to step through the query '%s'") % theQuery->theSql));
+            theQuery->throw_error("Failed to step through");
     }
 
     bool query::query_iterator::equal(query_iterator const& other) const
@@ -471,7 +1696,7 @@ namespace sqlite3cpp
     {
         if (!theQuery)
             throw database_error("Cannot dereference NULL query");
-        return row(theQuery->theStmt, theQuery->theSql);
+        return row(theQuery->theStmt);
     }
 
     query::query(database& db, const string& anSql)
@@ -483,6 +1708,29 @@ namespace sqlite3cpp
         return sqlite3_column_count(theStmt);
     }
 
+    string query::column_name(int idx) const
+    {
+        if (idx < 1 || idx > column_count())
+            throwColumnOutOfBounds(idx, theStmt);
+        return sqlite3_column_name(theStmt, idx-1);
+    }
+
+    size_t query::fetch_batch(column_batch& aBatch, size_t aMaxRows)
+    {
+        aBatch.clear();
+        if (theDone)
+            return 0;
+
+        // derive the column types anew for another query or another execution, whose values may be of other types
+        if (aBatch.theSource != theStmt || !sqlite3_stmt_busy(theStmt))
+            aBatch.init(theStmt);
+        aBatch.reserve(std::min(aMaxRows, MaxReservedBatchRows));
+
+        while (aBatch.rows() < aMaxRows && step_row())
+            aBatch.append(theStmt);
+        return aBatch.rows();
+    }
+
     query::iterator query::begin()
     {
         reset();
@@ -495,46 +1743,394 @@ namespace sqlite3cpp
     }
 
 
+    //
+    // Column batch
+    //
+
+    ColumnAffinity get_affinity(const string& aDeclType)
+    {
+        const string myType = boost::to_upper_copy(aDeclType);
+        if (myType.find("INT") != string::npos)
+            return affinityInteger;
+        if (myType.find("CHAR") != string::npos || myType.find("CLOB") != string::npos || myType.find("TEXT") != string::npos)
+            return affinityText;
+        if (myType.empty() || myType.find("BLOB") != string::npos)
+            return affinityBlob;
+        if (myType.find("REAL") != string::npos || myType.find("FLOA") != string::npos || myType.find("DOUB") != string::npos)
+            return affinityReal;
+        return affinityNumeric;
+    }
+
+    column_batch::column_batch()
+        : theRows(0), theSource(NULL)
+    {}
+
+    column_batch::column_batch(const std::vector<ColumnType>& aTypes)
+        : theTypes(aTypes), theColumns(aTypes.size()), theRows(0), theSource(NULL)
+    {
+        for (size_t i = 0; i < aTypes.size(); ++i)
+            theColumns[i].type = aTypes[i];
+    }
+
+    size_t column_batch::rows() const
+    {
+        return theRows;
+    }
+
+    size_t column_batch::columns() const
+    {
+        return theColumns.size();
+    }
+
+    const column_batch::column& column_batch::get_column(int idx) const
+    {
+        if (idx < 1 || static_cast<size_t>(idx) > theColumns.size())
+            throwBatchColumnOutOfBounds(idx, theColumns.size());
+        return theColumns[idx-1];
+    }
+
+    bool column_batch::is_null(int idx, size_t aRow) const
+    {
+        const column& myColumn = get_column(idx);
+        if (aRow >= theRows)
+            throwBatchRowOutOfBounds(aRow, theRows);
+        return (myColumn.nulls[aRow / 64] >> (aRow % 64)) & 1;
+    }
+
+    boost::string_view column_batch::text(int idx, size_t aRow) const
+    {
+        const column& myColumn = get_column(idx);
+        if (myColumn.type != columnText && myColumn.type != columnBlob)
+            throwBatchColumnNotText(idx);
+        if (aRow >= theRows)
+            throwBatchRowOutOfBounds(aRow, theRows);
+        const size_t myBegin = myColumn.offsets[aRow];
+        return boost::string_view(myColumn.heap.empty() ? "" : &myColumn.heap[myBegin], myColumn.offsets[aRow+1] - myBegin);
+    }
+
+    blob_view column_batch::blob(int idx, size_t aRow) const
+    {
+        const boost::string_view myValue = text(idx, aRow);
+        return blob_view(myValue.data(), myValue.size());
+    }
+
+    void column_batch::clear()
+    {
+        for (std::vector<column>::iterator it = theColumns.begin(); it != theColumns.end(); ++it)
+        {
+            it->integers.clear();
+            it->reals.clear();
+            it->offsets.assign(1, 0);
+            it->heap.clear();
+            it->nulls.clear();
+            it->mixed = false;
+        }
+        theRows = 0;
+    }
+
+    void column_batch::init(sqlite3_stmt* aStmt)
+    {
+        const int myColumnCount = sqlite3_column_count(aStmt);
+        if (!theTypes.empty())
+        {
+            if (static_cast<size_t>(myColumnCount) != theTypes.size())
+                throw database_error(str(boost::format("Query '%s' has %d columns whereas the batch has %d") % sqlite3_sql(aStmt) % myColumnCount % theTypes.size()));
+            // columnAuto columns are deduced again
+            for (size_t i = 0; i < theTypes.size(); ++i)
+                theColumns[i].type = theTypes[i];
+            theSource = aStmt;
+            clear();
+            return;
+        }
+
+        // the buffers of the columns are kept
+        theColumns.resize(myColumnCount);
+        for (int i = 0; i < myColumnCount; ++i)
+        {
+            char const* myDeclType = sqlite3_column_decltype(aStmt, i);
+            switch (myDeclType ? get_affinity(myDeclType) : affinityNumeric)
+            {
+            case affinityInteger: theColumns[i].type = columnInteger; break;
+            case affinityReal: theColumns[i].type = columnReal; break;
+            case affinityText: theColumns[i].type = columnText; break;
+            case affinityBlob: theColumns[i].type = *myDeclType ? columnBlob : columnAuto; break;
+            default: theColumns[i].type = columnAuto; break;
+            }
+        }
+        theSource = aStmt;
+        clear();
+    }
+
+    void column_batch::reserve(size_t aRows)
+    {
+        for (std::vector<column>::iterator it = theColumns.begin(); it != theColumns.end(); ++it)
+        {
+            if (it->type == columnInteger)
+                it->integers.reserve(aRows);
+            else if (it->type == columnReal)
+                it->reals.reserve(aRows);
+            else
+                it->offsets.reserve(aRows + 1);
+        }
+    }
+
+    void column_batch::append(sqlite3_stmt* aStmt)
+    {
+        const size_t myWord = theRows / 64;
+        const boost::uint64_t myBit = boost::uint64_t(1) << (theRows % 64);
+        for (size_t i = 0; i < theColumns.size(); ++i)
+        {
+            column& myColumn = theColumns[i];
+            if (myColumn.nulls.size() <= myWord)
+                myColumn.nulls.push_back(0);
+
+            const int myValueType = sqlite3_column_type(aStmt, i);
+            if (myColumn.type == columnAuto)
+            {
+                switch (myValueType)
+                {
+                case SQLITE_INTEGER: myColumn.type = columnInteger; break;
+                case SQLITE_FLOAT: myColumn.type = columnReal; break;
+                case SQLITE_BLOB: myColumn.type = columnBlob; break;
+                default: myColumn.type = columnText; break;
+                }
+            }
+
+            if (myValueType == SQLITE_NULL)
+            {
+                myColumn.nulls[myWord] |= myBit;
+                if (myColumn.type == columnInteger)
+                    myColumn.integers.push_back(0);
+                else if (myColumn.type == columnReal)
+                    myColumn.reals.push_back(0);
+                else
+                    myColumn.offsets.push_back(myColumn.heap.size());
+                continue;
+            }
+
+            // a value of another storage class than the column's is never converted silently
+            const bool myMatches = (myColumn.type == columnInteger && myValueType == SQLITE_INTEGER)
+                                   || (myColumn.type == columnReal && myValueType == SQLITE_FLOAT)
+                                   || (myColumn.type == columnText && myValueType == SQLITE_TEXT)
+                                   || (myColumn.type == columnBlob && myValueType == SQLITE_BLOB);
+            if (!myMatches)
+                promoteBatchColumn(myColumn, myValueType, aStmt, i, theRows);
+
+            switch (myColumn.type)
+            {
+            case columnInteger:
+                myColumn.integers.push_back(sqlite3_column_int64(aStmt, i));
+                break;
+            case columnReal:
+                myColumn.reals.push_back(sqlite3_column_double(aStmt, i));
+                break;
+            default:
+            {
+                char const* myValue = static_cast<char const*>(myColumn.type == columnText
+                                      ? static_cast<void const*>(sqlite3_column_text(aStmt, i))
+                                      : sqlite3_column_blob(aStmt, i));
+                if (myValue)
+                    myColumn.heap.insert(myColumn.heap.end(), myValue, myValue + sqlite3_column_bytes(aStmt, i));
+                myColumn.offsets.push_back(myColumn.heap.size());
+                break;
+            }
+            }
+        }
+        ++theRows;
+    }
+
+
     //
     // Transaction
     //
 
-    transaction::transaction(database& db, bool fcommit, bool freserve) : theDb(&db), theCcommit(fcommit)
+    transaction::transaction(database& db, bool fcommit, bool freserve)
+        : theDb(&db), theCcommit(fcommit), theLevel(db.theTransactionDepth), theNested(false)
+    {
+        begin(freserve ? transactionImmediate : transactionDeferred);
+    }
+
+    transaction::transaction(database& db, TransactionMode aMode, bool fcommit)
+        : theDb(&db), theCcommit(fcommit), theLevel(db.theTransactionDepth), theNested(false)
+    {
+        begin(aMode);
+    }
+
+    transaction::transaction(transaction&& other)
+        : theDb(other.theDb), theCcommit(other.theCcommit), theLevel(other.theLevel), theNested(other.theNested)
+    {
+        other.theDb = NULL;
+    }
+
+    transaction& transaction::operator=(transaction&& other)
     {
-        theDb->execute(freserve ? "BEGIN IMMEDIATE" : "BEGIN");
+        if (this == &other)
+            return *this;
+        if (theDb)
+        {
+            if (theCcommit)
+                commit();
+            else
+                rollback();
+        }
+        theDb = other.theDb;
+        theCcommit = other.theCcommit;
+        theLevel = other.theLevel;
+        theNested = other.theNested;
+        other.theDb = NULL;
+        return *this;
     }
 
     transaction::~transaction()
     {
+        if (theDb && theCcommit)
+        {
+            try { commit(); }
+            catch (...) {}
+        }
+        // not to be committed or failed to commit
         if (theDb)
         {
-            try { theDb->execute(theCcommit ? "COMMIT" : "ROLLBACK"); }
+            try { rollback(); }
             catch (...) {}
         }
     }
 
     void transaction::commit()
     {
-        database* db = theDb;
+        // a failed COMMIT or RELEASE leaves the transaction pending and owned by this object
+        if (theNested)
+            execute(*theDb, theDb->theSavepointSql[theLevel].release);
+        else
+            execute(*theDb, "COMMIT");
+        theDb->theTransactionDepth = theLevel;
         theDb = NULL;
-        db->execute("COMMIT");
     }
 
     void transaction::rollback()
     {
         database* db = theDb;
         theDb = NULL;
-        db->execute("ROLLBACK");
+        db->theTransactionDepth = theLevel;
+        if (theNested)
+        {
+            // rolling back to a savepoint keeps it on the stack
+            execute(*db, db->theSavepointSql[theLevel].rollback);
+            db->notify_savepoint_rollback();
+            execute(*db, db->theSavepointSql[theLevel].release);
+        }
+        else
+        {
+            execute(*db, "ROLLBACK");
+        }
+    }
+
+    bool transaction::nested() const
+    {
+        return theNested;
+    }
+
+    void transaction::begin(TransactionMode aMode)
+    {
+        // a transaction begun by other means is nested into as well
+        theNested = (theLevel > 0 || !sqlite3_get_autocommit(theDb->theDb));
+        if (theNested)
+        {
+            // formatted once per nesting level, so that the statements are reused without allocations
+            for (int i = static_cast<int>(theDb->theSavepointSql.size()); i <= theLevel; ++i)
+            {
+                database::savepoint_sql mySql;
+                mySql.begin = str(boost::format("SAVEPOINT sqlite3cpp_xct%d") % i);
+                mySql.release = str(boost::format("RELEASE sqlite3cpp_xct%d") % i);
+                mySql.rollback = str(boost::format("ROLLBACK TO sqlite3cpp_xct%d") % i);
+                theDb->theSavepointSql.push_back(mySql);
+            }
+            execute(*theDb, theDb->theSavepointSql[theLevel].begin);
+        }
+        else
+        {
+            static char const* const Begin[] = { "BEGIN DEFERRED", "BEGIN IMMEDIATE", "BEGIN EXCLUSIVE" };
+            execute(*theDb, Begin[aMode]);
+        }
+        theDb->theTransactionDepth = theLevel + 1;
+    }
+
+    // The control statements are few and executed often, so they come from the statement cache instead of being parsed every time
+    void transaction::execute(database& db, const string& anSql)
+    {
+        command myCmd(db, anSql);
+        myCmd.execute();
     }
 
 
     database_error::database_error(const string& aMsg)
-        : std::runtime_error(aMsg)
+        : std::runtime_error(""), theWhat(NULL), theMsg(aMsg), theExtendedCode(SQLITE_OK), theParamIndex(0)
     {}
 
     database_error::database_error(database& db, const string& aMsg)
-        : std::runtime_error(str(boost::format("%s. %s. Db at %s") % aMsg % sqlite3_errmsg(db.theDb) % db.theDbPath))
+        : std::runtime_error(""), theWhat(NULL), theMsg(aMsg), theExtendedCode(SQLITE_OK), theParamIndex(0), theDbPath(db.theDbPath)
+    {
+        if (db.theDb)
+        {
+            theExtendedCode = sqlite3_extended_errcode(db.theDb);
+            theSqliteMsg = sqlite3_errmsg(db.theDb);
+        }
+    }
+
+    database_error::database_error(database& db, const char* aWhat, const string& anSql, int aParamIndex)
+        : std::runtime_error(""), theWhat(aWhat), theExtendedCode(SQLITE_OK), theSql(anSql), theParamIndex(aParamIndex), theDbPath(db.theDbPath)
+    {
+        if (db.theDb)
+        {
+            theExtendedCode = sqlite3_extended_errcode(db.theDb);
+            theSqliteMsg = sqlite3_errmsg(db.theDb);
+        }
+    }
+
+    database_error::~database_error() throw()
     {}
 
+    const char* database_error::what() const throw()
+    {
+        if (!theFormattedMsg.empty())
+            return theFormattedMsg.c_str();
+        try
+        {
+            string myMsg = theWhat ? theWhat : theMsg;
+            if (theParamIndex > 0)
+                myMsg += " at position " + std::to_string(theParamIndex) + " of";
+            if (theWhat)
+                myMsg += " '" + theSql + "'";
+            if (!theDbPath.empty())
+                myMsg += ". " + theSqliteMsg + ". Db at " + theDbPath;
+            theFormattedMsg.swap(myMsg);
+            return theFormattedMsg.c_str();
+        }
+        catch (...)
+        {
+            return theWhat ? theWhat : "database_error";
+        }
+    }
+
+    int database_error::code() const
+    {
+        return theExtendedCode & 0xff;
+    }
+
+    int database_error::extended_code() const
+    {
+        return theExtendedCode;
+    }
+
+    const string& database_error::sql() const
+    {
+        return theSql;
+    }
+
+    int database_error::parameter_index() const
+    {
+        return theParamIndex;
+    }
+
 
 }
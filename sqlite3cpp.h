@@ -26,12 +26,24 @@
 #define SQLITE3CPP_H
 
 #include <string>
+#include <list>
+#include <vector>
 #include <stdexcept>
+#include <memory>
+#include <functional>
+#include <iosfwd>
+#include <limits>
+#include <climits>
+#include <type_traits>
+#include <random>
 #include <sqlite3.h>
 #include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
-#include <boost/tuple/tuple.hpp>
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_view.hpp>
+#include <boost/optional.hpp>
+#include <boost/variant.hpp>
 
 namespace sqlite3cpp
 {
@@ -43,70 +55,595 @@ namespace sqlite3cpp
         clearBindingsOff, clearBindingsOn
     };
 
-    class database : boost::noncopyable
+    // Lifetime policy for text and BLOB values bound to a statement
+    enum BindLifetime
+    {
+        bindCopy,   // SQLite makes its own copy of the value (SQLITE_TRANSIENT)
+        bindStatic  // the value is not copied and shall stay valid until it is rebound or the statement is finished (SQLITE_STATIC)
+    };
+
+    // Non-owning view over BLOB data
+    struct blob_view
+    {
+        blob_view() : data(NULL), size(0) {}
+        blob_view(void const* aData, size_t aSize) : data(aData), size(aSize) {}
+
+        void const* data;
+        size_t size;
+    };
+
+    // Zero-filled BLOB bound as a placeholder of the given size to be written incrementally with blob_stream
+    struct zeroblob
+    {
+        explicit zeroblob(sqlite3_uint64 aSize) : size(aSize) {}
+
+        sqlite3_uint64 size;
+    };
+
+    enum JournalMode
+    {
+        journalDelete, journalTruncate, journalPersist, journalMemory, journalWal, journalOff
+    };
+
+    enum Synchronous
+    {
+        synchronousOff, synchronousNormal, synchronousFull, synchronousExtra
+    };
+
+    enum TempStore
+    {
+        tempStoreDefault, tempStoreFile, tempStoreMemory
+    };
+
+    enum CheckpointMode
+    {
+        checkpointPassive, checkpointFull, checkpointRestart, checkpointTruncate
+    };
+
+    // When the locks of a transaction are acquired, see BEGIN in SQLite docs
+    enum TransactionMode
+    {
+        transactionDeferred, transactionImmediate, transactionExclusive
+    };
+
+    //
+    // Options applied when the Db is opened. Unset options keep SQLite defaults.
+    //
+    struct open_options
+    {
+        open_options();
+
+        int flags;                              // sqlite3_open_v2 flags, e.g. SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX
+        boost::optional<int> busy_timeout_ms;
+        boost::optional<int> page_size;         // applied before the Db schema is created, no effect on existing Db
+        boost::optional<JournalMode> journal_mode;
+        boost::optional<Synchronous> synchronous;
+        boost::optional<sqlite3_int64> mmap_size;
+        boost::optional<int> cache_size;        // pages if positive, KiB if negative
+        boost::optional<TempStore> temp_store;
+        // Lookaside memory of the connection serving its small allocations without going to the allocator.
+        // The slot size and the number of slots are applied together, the one unset takes the SQLite default.
+        // 0 slots disables lookaside. Not reported by database::get_open_options().
+        static const int DefaultLookasideSlotSize = 1200;
+        static const int DefaultLookasideSlots = 40;
+        boost::optional<int> lookaside_slot_size;
+        boost::optional<int> lookaside_slots;
+    };
+
+    // Column affinity as determined by SQLite from the declared column type
+    enum ColumnAffinity
+    {
+        affinityInteger, affinityText, affinityBlob, affinityReal, affinityNumeric
+    };
+    ColumnAffinity get_affinity(const std::string& aDeclType);
+
+    enum ColumnType
+    {
+        columnAuto,     // deduced from the value of the first fetched row
+        columnInteger, columnReal, columnText, columnBlob
+    };
+
+    //
+    // Struct-of-arrays storage for a batch of rows fetched with query::fetch_batch().
+    // Integer and real values are stored in contiguous arrays, text and BLOB values in a per-column heap
+    // addressed by offsets and NULLs in per-column bitmaps (NULL numeric values are stored as 0).
+    // Column types are either given explicitly or deduced from the declared column types or, if these
+    // are not conclusive, from the values of the first fetched row.
+    // A value of another storage class than its column's promotes the column and sets its mixed flag:
+    // an integer column to real if all its values are exact as doubles, otherwise any numeric column to text
+    // (BLOB if the value is a BLOB) with the numbers formatted as SQLite does. Text and BLOB columns keep
+    // the bytes of any value and real columns take integers exact as doubles. A column of NULLs only is
+    // just retyped.
+    // The batch keeps its buffers when refilled, so reuse it across fetches.
+    //
+    class column_batch
+    {
+    public:
+        struct column
+        {
+            ColumnType type;
+            std::vector<sqlite3_int64> integers;
+            std::vector<double> reals;
+            std::vector<size_t> offsets;            // text and BLOB value of row i is heap[offsets[i], offsets[i+1])
+            std::vector<char> heap;
+            std::vector<boost::uint64_t> nulls;     // bit i is set if the value of row i is NULL
+            bool mixed;                             // values of other storage classes were converted to the type
+        };
+
+        column_batch();
+        explicit column_batch(const std::vector<ColumnType>& aTypes);
+
+        size_t rows() const;
+        size_t columns() const;
+
+        // column index is 1-based, row index is 0-based
+        const column& get_column(int idx) const;
+        bool is_null(int idx, size_t aRow) const;
+        boost::string_view text(int idx, size_t aRow) const;
+        blob_view blob(int idx, size_t aRow) const;
+
+        void clear();
+
+    private:
+        friend class query;
+        void init(sqlite3_stmt* aStmt);
+        void reserve(size_t aRows);
+        void append(sqlite3_stmt* aStmt);
+
+    private:
+        std::vector<ColumnType> theTypes;
+        std::vector<column> theColumns;
+        size_t theRows;
+        sqlite3_stmt* theSource;    // statement the column types are derived for
+    };
+
+    struct statement_cache_stats
+    {
+        statement_cache_stats();
+
+        size_t capacity;
+        size_t size;        // number of idle prepared statements kept in the cache
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+    };
+
+    struct checkpoint_result
+    {
+        checkpoint_result();
+
+        bool busy;                  // the checkpoint could not complete because of other readers or writers
+        int log_frames;             // frames in the WAL, -1 if the Db is not in WAL mode
+        int checkpointed_frames;    // frames of the WAL transferred to the Db
+    };
+
+    // Memory used by a connection as reported by sqlite3_db_status()
+    struct connection_memory_status
+    {
+        connection_memory_status();
+
+        int lookaside_used;         // lookaside slots in use
+        int lookaside_highwater;
+        int lookaside_hits;         // allocations served from lookaside
+        int lookaside_misses_size;  // allocations too large for a lookaside slot
+        int lookaside_misses_full;  // allocations made while all lookaside slots were in use
+        int cache_used;             // bytes of page cache
+        int schema_used;            // bytes of schema
+        int statements_used;        // bytes of prepared statements
+    };
+
+    //
+    // Retry of statements failed with SQLITE_BUSY or SQLITE_LOCKED, see database::set_retry_policy().
+    // The delay doubles with every retry up to the maximum, half of each delay is random so that contending
+    // connections spread out instead of retrying in lockstep.
+    //
+    struct retry_policy
+    {
+        retry_policy();
+
+        int max_retries;                // 0 disables retrying
+        unsigned int initial_delay_ms;
+        unsigned int max_delay_ms;
+        unsigned int deadline_ms;       // time budget of all retries of a statement, 0 for none
+        bool unlock_notify;             // in shared-cache mode wait for the blocking connection with sqlite3_unlock_notify() instead of sleeping
+    };
+
+    struct retry_stats
+    {
+        retry_stats();
+
+        sqlite3_int64 busy;         // retries after SQLITE_BUSY
+        sqlite3_int64 locked;       // retries after SQLITE_LOCKED
+        sqlite3_int64 failures;     // statements still failing when the retries or the deadline ran out
+        double wait_sec;            // time spent waiting between the retries
+        double max_wait_sec;        // longest wait of a single statement
+    };
+
+    // A single run of a statement from its first step until it is done, reset or finished
+    struct statement_execution
+    {
+        statement_execution();
+
+        std::string sql;
+        double elapsed_sec;     // time spent stepping the statement including lock waits
+        double lock_wait_sec;   // time spent waiting for locks held by other connections
+        size_t steps;
+        size_t rows;
+        // sqlite3_stmt_status() counters
+        int fullscan_steps;
+        int sorts;
+        int autoindexes;
+        int vm_steps;
+    };
+
+    // Metrics aggregated over all executions of the same SQL text
+    struct statement_profile
+    {
+        statement_profile();
+
+        std::string sql;
+        size_t prepares;
+        double prepare_sec;
+        size_t executions;
+        size_t steps;
+        size_t rows;
+        double total_sec;
+        double p50_sec;         // percentiles of the execution time, accurate to about 10%
+        double p99_sec;
+        double max_sec;
+        double lock_wait_sec;
+        sqlite3_int64 fullscan_steps;
+        sqlite3_int64 sorts;
+        sqlite3_int64 autoindexes;
+        sqlite3_int64 vm_steps;
+    };
+
+    //
+    // Receives the changes made through a database connection, see database::add_change_listener().
+    // Callbacks run inside SQLite hooks and shall not use the connection.
+    //
+    class change_listener
+    {
+    public:
+        virtual ~change_listener() {}
+        // a row of a rowid table was inserted, updated or deleted, anOp is SQLITE_INSERT, SQLITE_UPDATE or SQLITE_DELETE
+        virtual void on_row_changed(int anOp, char const* aDbName, char const* aTable, sqlite3_int64 aRowId) = 0;
+        // rows were changed without being reported one by one, e.g. by DELETE without WHERE clause truncating the table
+        virtual void on_unreported_changes() = 0;
+        // a nested transaction was rolled back to its savepoint, the rows it restored are not reported one by one
+        virtual void on_savepoint_rollback() {}
+    };
+
+    class database
     {
         friend class statement;
         friend class database_error;
+        friend class blob_stream;
+        friend class script;
+        friend class transaction;
 
     public:
         database();
-        database(const std::string& aDbPath, const std::string& aDbCreateSql, const std::string& anExtensionPath = "");
+        database(const std::string& aDbPath, const std::string& aDbCreateSql, const std::string& anExtensionPath = "", const open_options& anOptions = open_options());
+        // The connection, its statement cache, profile, listeners and WAL callback are transferred, the source is left closed.
+        // Statements, transactions and other objects created with the source keep referring to it,
+        // so move the Db before using it.
+        database(database&& other);
+        database& operator=(database&& other);
+        database(const database&) = delete;
+        database& operator=(const database&) = delete;
         ~database();
 
-        void open(const std::string& aDbPath, const std::string& aDbCreateSql, const std::string& anExtensionPath = "");
+        // The Db is closed again if any of the options cannot be applied
+        void open(const std::string& aDbPath, const std::string& aDbCreateSql, const std::string& anExtensionPath = "", const open_options& anOptions = open_options());
         void close();
 
+        // Effective values of all options as reported by SQLite after the Db was opened
+        const open_options& get_open_options() const;
+
         sqlite3_int64 last_insert_rowid() const;
+        // number of rows modified by the most recently completed INSERT, UPDATE or DELETE
+        int changes() const;
+        // extended result code of the most recent failed API call
+        int error_code() const;
 
         void execute(const std::string& anSql);
+        // execute without throwing, return SQLITE_OK or the extended result code of the failure
+        int try_execute(const std::string& anSql);
         int set_busy_timeout(int ms);
+        // aResetHighwater resets the lookaside high-water mark and the hit and miss counters after reading them
+        connection_memory_status get_memory_status(bool aResetHighwater = false);
         // Foreign kets are effectively supported only from sqlite 3.6.19
         void enable_foreign_keys(bool aEnable = true);
+        // whether a transaction begun by any means is pending on the connection
+        bool in_transaction() const;
+
+        // Retry steps failed with SQLITE_BUSY or SQLITE_LOCKED in statements and database::execute(), disabled by default.
+        // Only statements run outside of an explicit transaction and COMMIT are retried: a statement failed within
+        // a transaction may be waiting for a lock the transaction itself prevents others from releasing,
+        // so the transaction shall be rolled back instead. The retries come on top of the busy timeout.
+        void set_retry_policy(const retry_policy& aPolicy);
+        const retry_policy& get_retry_policy() const;
+        retry_stats get_retry_stats() const;
+
+        // LRU cache of prepared statements keyed by SQL text.
+        // Statements created with SQL seen before are checked out from the cache instead of being prepared again;
+        // when finished they are reset and returned to the cache. Capacity 0 disables caching.
+        static const size_t DefaultStatementCacheCapacity = 32;
+        void set_statement_cache_capacity(size_t aCapacity);
+        statement_cache_stats get_statement_cache_stats() const;
+        void clear_statement_cache();
+
+        // Per-SQL profiling of the statements, of the statements of scripts and of database::execute(), disabled by default.
+        // Disabled profiling costs a single check per step, so it can be left compiled in.
+        // While enabled, lock waits are measured by a busy handler emulating the busy timeout.
+        typedef std::function<void(const statement_execution& anExecution)> slow_query_callback;
+        void enable_profiling(bool anEnable = true);
+        bool is_profiling_enabled() const;
+        // aCallback is called for executions lasting at least aThresholdSec, exceptions thrown by it are ignored
+        void set_slow_query_callback(double aThresholdSec, const slow_query_callback& aCallback);
+        // snapshot of the collected metrics, the most time consuming statements first
+        std::vector<statement_profile> get_profile() const;
+        // write the snapshot as a JSON array
+        void export_profile(std::ostream& anOs) const;
+        void reset_profile();
+
+        // Online backup of the main Db with sqlite3_backup, copying aPagesPerStep pages per step (-1 copies all at once)
+        // and sleeping aSleepMs between the steps so that other connections can acquire the locks meanwhile.
+        // The backup restarts when the Db is modified by another connection between the steps.
+        // aProgress is called after every step, throw from it to abort the backup.
+        // A backup to a file is written to a temporary file first and renamed when complete.
+        typedef std::function<void(int aRemainingPages, int aTotalPages)> backup_progress_callback;
+        static const int DefaultBackupPagesPerStep = 100;
+        void backup_to(database& aTarget, int aPagesPerStep = DefaultBackupPagesPerStep, unsigned int aSleepMs = 0,
+                       const backup_progress_callback& aProgress = backup_progress_callback());
+        void backup_to(const std::string& aPath, int aPagesPerStep = DefaultBackupPagesPerStep, unsigned int aSleepMs = 0,
+                       const backup_progress_callback& aProgress = backup_progress_callback());
+        // Consistent read-only copy of the Db in memory, opened on aSnapshot
+        void snapshot_to(database& aSnapshot);
+
+        // Row changes made through this connection are dispatched to the listeners from sqlite3_update_hook,
+        // which is installed only while there are listeners. Changes made by other connections are not observed.
+        // Listeners shall be removed before they are destroyed.
+        void add_change_listener(change_listener* aListener);
+        void remove_change_listener(change_listener* aListener);
+        // Notify the listeners of changes that SQLite counted in sqlite3_total_changes() without reporting them
+        // to the update hook since the previous check. Changes made by triggers are reported but not counted,
+        // so they may hide unreported changes made within the same period; check before every read to avoid that.
+        void check_unreported_changes();
+
+        // Checkpoint of the WAL with sqlite3_wal_checkpoint_v2(), an empty aDbName checkpoints all attached Dbs.
+        // Modes other than checkpointPassive wait for readers and writers using the busy handler.
+        checkpoint_result checkpoint(CheckpointMode aMode = checkpointPassive, const std::string& aDbName = "");
+        // aFrames is the size of the WAL after each commit, the callback shall not use the connection.
+        // The WAL callback and the automatic checkpoint are the same SQLite hook, so setting either one replaces the other.
+        typedef std::function<void(const std::string& aDbName, int aFrames)> wal_callback;
+        void set_wal_callback(const wal_callback& aCallback);
+        // aFrames of 0 disables the automatic checkpoint after commits, SQLite default is 1000
+        void set_wal_autocheckpoint(int aFrames);
+        // 0 if the automatic checkpoint is disabled or replaced by a WAL callback
+        int get_wal_autocheckpoint();
 
     private:
+        struct profiler;
+        static int profiling_busy_handler(void* aDb, int aCount);
+        void install_busy_handler();
+        void record_execution(const statement_execution& anExecution);
+        // Profiled run of aStmt: start anExecution, account every step to it, then record it with the status counters.
+        // A failed first step is retried according to the retry policy.
+        void begin_execution(sqlite3_stmt* aStmt, statement_execution& anExecution);
+        int profiled_step(sqlite3_stmt* aStmt, statement_execution& anExecution);
+        void end_execution(sqlite3_stmt* aStmt, statement_execution& anExecution);
+        static void update_hook(void* aDb, int anOp, char const* aDbName, char const* aTable, sqlite3_int64 aRowId);
+        void install_update_hook();
+        void notify_savepoint_rollback();
+        // point the hooks installed on the connection to this object
+        void rebind_hooks();
+        static int wal_hook(void* aDb, sqlite3*, char const* aDbName, int aFrames);
+        // retry the step of aStmt failed with aRc according to the retry policy, return the result of the last step
+        int retry_step(sqlite3_stmt* aStmt, int aRc);
+        bool wait_for_unlock(double aDeadline);
+        int execute_retrying(const std::string& anSql);
+
         void load_extension(const std::string& anExtensionPath);
+        void apply_options(const open_options& anOptions);
+        void read_options(int anOpenFlags);
+        std::string get_pragma(const std::string& aPragma);
+
+        // The SQL text of the statement is moved between the cache and aSql, so that a cache hit allocates nothing
+        sqlite3_stmt* checkout_statement(const std::string& anSql, std::string& aSql);
+        void checkin_statement(std::string& aSql, sqlite3_stmt* aStmt);
+        void evict_statements(size_t aMaxSize);
 
     private:
+        struct sql_hash
+        {
+            size_t operator()(boost::string_view anSql) const { return boost::hash_range(anSql.begin(), anSql.end()); }
+        };
+        typedef std::list<std::pair<std::string, sqlite3_stmt*> > StatementLru; // most recently used first
+        // keyed by the SQL text stored in the LRU
+        typedef boost::unordered_multimap<boost::string_view, StatementLru::iterator, sql_hash> StatementIndex;
+
         std::string theDbPath;
         sqlite3* theDb;
+        open_options theOptions;
+        StatementLru theStatementLru;
+        StatementIndex theStatementIndex;
+        // nodes of the statements checked out or evicted, reused when statements are checked in
+        StatementLru theSpareLruNodes;
+        std::vector<StatementIndex::node_type> theSpareIndexNodes;
+        statement_cache_stats theStatementCacheStats;
+        int theBusyTimeoutMs;
+        std::unique_ptr<profiler> theProfiler;  // NULL when profiling is disabled
+        std::vector<change_listener*> theChangeListeners;
+        unsigned int theReportedChanges;        // row changes reported to the listeners since the last check
+        unsigned int theTotalChanges;           // sqlite3_total_changes() at the last check
+        wal_callback theWalCallback;
+        int theTransactionDepth;                // transaction objects pending on the connection
+        struct savepoint_sql
+        {
+            std::string begin;
+            std::string release;
+            std::string rollback;
+        };
+        std::vector<savepoint_sql> theSavepointSql;   // control statements of nested transactions by nesting level
+        retry_policy theRetryPolicy;
+        retry_stats theRetryStats;
+        std::minstd_rand theRetryRandom;
     };
 
-    struct database_error : std::runtime_error
+    //
+    // Error raised by the library or by a failed SQLite call.
+    // The structured fields are cheap to inspect, the message is built only when what() is called.
+    //
+    class database_error : public std::runtime_error
     {
+    public:
         explicit database_error(const std::string& aMsg);
         database_error(database& db, const std::string& aMsg);
+        // error of the last SQLite call on db, aWhat shall be a string literal
+        database_error(database& db, const char* aWhat, const std::string& anSql, int aParamIndex = 0);
+        ~database_error() throw();
+
+        const char* what() const throw();
+
+        // SQLite result codes, SQLITE_OK if the error does not come from SQLite
+        int code() const;
+        int extended_code() const;
+        // SQL text of the failed statement, empty if not applicable
+        const std::string& sql() const;
+        // 1-based index of the parameter failed to bind, 0 if not applicable
+        int parameter_index() const;
+
+    private:
+        const char* theWhat;
+        std::string theMsg;
+        int theExtendedCode;
+        std::string theSql;
+        int theParamIndex;
+        std::string theSqliteMsg;
+        std::string theDbPath;
+        mutable std::string theFormattedMsg;
+    };
+
+    namespace detail
+    {
+        [[noreturn]] void throw_integer_overflow(boost::uint64_t aValue);
+        [[noreturn]] void throw_integer_out_of_range(sqlite3_int64 aValue, int aBits, bool aSigned);
+
+        // seconds on the monotonic clock, the time base of the durations in the statistics
+        double now();
+
+        // Integral types and enums bound and fetched as 64-bit SQLite integers
+        template <class T> struct is_sqlite_integer
+            : std::integral_constant<bool, (std::is_integral<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value> {};
+
+        template <class T, bool IsEnum = std::is_enum<T>::value> struct integer_type { typedef T type; };
+        template <class T> struct integer_type<T, true> { typedef typename std::underlying_type<T>::type type; };
+
+        // Conversions to and from sqlite3_int64, range checks are compiled in only for types which need them
+        template <class T> inline sqlite3_int64 to_int64(T aValue)
+        {
+            typedef typename integer_type<T>::type Int;
+            const Int myValue = static_cast<Int>(aValue);
+            if (!std::numeric_limits<Int>::is_signed && sizeof(Int) >= sizeof(sqlite3_int64)
+                    && static_cast<boost::uint64_t>(myValue) > static_cast<boost::uint64_t>(std::numeric_limits<sqlite3_int64>::max()))
+                throw_integer_overflow(static_cast<boost::uint64_t>(myValue));
+            return static_cast<sqlite3_int64>(myValue);
+        }
+
+        template <class T> inline T from_int64(sqlite3_int64 aValue)
+        {
+            typedef typename integer_type<T>::type Int;
+            typedef std::numeric_limits<Int> Limits;
+            const bool myInRange = Limits::is_signed
+                                   ? (sizeof(Int) >= sizeof(sqlite3_int64)
+                                      || (aValue >= static_cast<sqlite3_int64>(Limits::min()) && aValue <= static_cast<sqlite3_int64>(Limits::max())))
+                                   : (aValue >= 0 && (sizeof(Int) >= sizeof(sqlite3_int64)
+                                                      || static_cast<boost::uint64_t>(aValue) <= static_cast<boost::uint64_t>(Limits::max())));
+            if (!myInRange)
+                throw_integer_out_of_range(aValue, sizeof(Int) * CHAR_BIT, Limits::is_signed);
+            return static_cast<T>(aValue);
+        }
+
+        // Parameter value kept until its statement runs, std::vector<char> is bound as BLOB
+        typedef boost::variant<null_type, int, sqlite3_int64, double, std::string, std::vector<char> > param_value;
+        // Bind without copying, so text and BLOB values shall outlive the execution. Return the SQLite result code.
+        int bind_param(sqlite3_stmt* aStmt, int idx, const param_value& aValue);
+    }
+
+    // Index of a named parameter resolved once with statement::get_param() to bind through later
+    class param_handle
+    {
+    public:
+        explicit param_handle(int idx) : theIndex(idx) {}
+        int index() const { return theIndex; }
+    private:
+        int theIndex;
     };
 
-    class statement : boost::noncopyable
+    class statement
     {
+        friend void bind_params(statement& aStmt, const std::vector<detail::param_value>& aParams);
+
     public:
         void prepare(const std::string& anSql);
         void finish();
         void reset(ClearBindings aClearBindings = clearBindingsOff);
 
+        // Step without throwing, return SQLITE_ROW, SQLITE_DONE or the extended result code of the failure.
+        // On failure the statement is reset keeping its bindings, so it can be rebound or stepped again to retry.
+        int try_step();
+
+        int parameter_count() const;
+
         // positional bind (index is 1-based)
-        void bind(int idx, int value);
-        void bind(int idx, long int value);
-        void bind(int idx, unsigned int value);
-        void bind(int idx, unsigned long value);
+        // integers of any width and enums are bound as 64-bit, unsigned 64-bit values above INT64_MAX are rejected
+        template <class T> typename std::enable_if<detail::is_sqlite_integer<T>::value>::type bind(int idx, T value)
+        {
+            bind_int64(idx, detail::to_int64(value));
+        }
+        // bool is bound as integer 0 or 1, the template keeps pointers from converting to it
+        template <class T> typename std::enable_if<std::is_same<T, bool>::value>::type bind(int idx, T value)
+        {
+            bind_int64(idx, value ? 1 : 0);
+        }
         void bind(int idx, double value);
-        void bind(int idx, sqlite3_int64 value);
-        void bind(int idx, const std::string& value);
-        void bind(int idx, void const* value, int n);
+        void bind(int idx, boost::string_view value, BindLifetime aLifetime = bindCopy);
+        void bind(int idx, void const* value, int n, BindLifetime aLifetime = bindCopy);
+        void bind(int idx, blob_view value, BindLifetime aLifetime = bindCopy);
+        // bind without copying, the ownership of the value is passed to SQLite which disposes it with aDestructor
+        void bind(int idx, boost::string_view value, sqlite3_destructor_type aDestructor);
+        void bind(int idx, blob_view value, sqlite3_destructor_type aDestructor);
+        void bind(int idx, zeroblob value);
         void bind(int idx);
         void bind(int idx, null_type);
 
-        // name bind
-        void bind(const std::string& name, int value);
-        void bind(const std::string& name, long int value);
-        void bind(const std::string& name, unsigned int value);
-        void bind(const std::string& name, unsigned long value);
-        void bind(const std::string& name, double value);
-        void bind(const std::string& name, sqlite3_int64 value);
-        void bind(const std::string& name, const std::string& value);
-        void bind(const std::string& name, void const* value, int n);
-        void bind(const std::string& name);
-        void bind(const std::string& name, null_type);
+        // name bind, names are resolved with a table built on the first named bind
+        template <class T> typename std::enable_if<detail::is_sqlite_integer<T>::value>::type bind(boost::string_view name, T value)
+        {
+            bind_int64(bind_parameter_index(name), detail::to_int64(value));
+        }
+        template <class T> typename std::enable_if<std::is_same<T, bool>::value>::type bind(boost::string_view name, T value)
+        {
+            bind_int64(bind_parameter_index(name), value ? 1 : 0);
+        }
+        void bind(boost::string_view name, double value);
+        void bind(boost::string_view name, boost::string_view value, BindLifetime aLifetime = bindCopy);
+        void bind(boost::string_view name, void const* value, int n, BindLifetime aLifetime = bindCopy);
+        void bind(boost::string_view name, blob_view value, BindLifetime aLifetime = bindCopy);
+        void bind(boost::string_view name, boost::string_view value, sqlite3_destructor_type aDestructor);
+        void bind(boost::string_view name, blob_view value, sqlite3_destructor_type aDestructor);
+        void bind(boost::string_view name, zeroblob value);
+        void bind(boost::string_view name);
+        void bind(boost::string_view name, null_type);
+
+        // bind by a pre-resolved named parameter, accepts the same values as the positional bind
+        param_handle get_param(boost::string_view name) const;
+        template <class... Args> void bind(param_handle aParam, const Args&... anArgs)
+        {
+            bind(aParam.index(), anArgs...);
+        }
 
         // stream-like bind using << operator
         template <class T>  statement& operator << (T value)
@@ -119,15 +656,42 @@ namespace sqlite3cpp
 
     protected:
         statement(database& db, const std::string& anSql);
+        // The prepared statement, its bindings and the current execution are transferred, the source is left finished
+        statement(statement&& other);
+        statement& operator=(statement&& other);
+        statement(const statement&) = delete;
+        statement& operator=(const statement&) = delete;
         ~statement();
 
         int step();
+        // step and return true if a row is available, false when done, throw on error
+        bool step_row();
+        // reset ignoring the outcome of the last step which is supposed to be reported already
+        void rewind();
+        // throw database_error for the last failed SQLite call on this statement
+        [[noreturn]] void throw_error(const char* aWhat, int aParamIndex = 0) const;
+
+    private:
+        int bind_parameter_index(boost::string_view name) const;
+        void bind_int64(int idx, sqlite3_int64 value);
+        void bind_text(int idx, boost::string_view value, sqlite3_destructor_type aDestructor);
+        void bind_blob(int idx, blob_view value, sqlite3_destructor_type aDestructor);
+        int profiled_step();
+        void end_execution();
+
     protected:
-        database& theDb;
+        database* theDb;
         std::string theSql;
         sqlite3_stmt* theStmt;
+        bool theDone;   // the statement has run to completion and has not been reset since
     private:
+        // Sorted by name. The names are copied: SQLite frees its own when it recompiles the statement after a schema change
+        typedef std::vector<std::pair<std::string, int> > ParamIndex;
+        mutable ParamIndex theParamIndex;
+        mutable bool theParamIndexBuilt;
         int theCurBindIndx;
+        statement_execution theExecution;   // current execution, collected only while profiling
+        bool theExecuting;
     };
 
 
@@ -136,17 +700,23 @@ namespace sqlite3cpp
     public:
         command(database& db, const std::string& anSql);
         void execute();
+        // execute without throwing, return SQLITE_OK or the extended result code of the failure
+        int try_execute();
     };
 
 
     class query : public statement
     {
     public:
+        // Lightweight view over the current row of the owning query, valid until the query is stepped
         class row
         {
         public:
-            row(sqlite3_stmt* stmt, const std::string& anSql);
+            explicit row(sqlite3_stmt* stmt);
 
+            // boost::string_view and blob_view results point to the column data owned by SQLite
+            // and remain valid until the query is stepped, reset or finished
+            // integers of any width and enums are fetched as 64-bit, values out of range of T are rejected
             template <class T> T get(int idx) const  // index is 1-based
             {
                 return get(idx, T());
@@ -160,20 +730,28 @@ namespace sqlite3cpp
             }
 
         private:
-            int get(int idx, int) const;
-            long int get(int idx, long int) const;
-            unsigned int get(int idx, unsigned int) const;
-            unsigned long get(int idx, unsigned long) const;
+            template <class T> typename std::enable_if<detail::is_sqlite_integer<T>::value, T>::type get(int idx, T) const
+            {
+                return detail::from_int64<T>(get_int64(idx));
+            }
+            sqlite3_int64 get_int64(int idx) const;
+            // any non-zero integer is true
+            bool get(int idx, bool) const
+            {
+                return get_int64(idx) != 0;
+            }
             double get(int idx, double) const;
-            sqlite3_int64 get(int idx, sqlite3_int64) const;
             char const* get(int idx, char const*) const;
             std::string get(int idx, std::string) const;
+            boost::string_view get(int idx, boost::string_view) const;
             void const* get(int idx, void const*) const;
+            blob_view get(int idx, blob_view) const;
             null_type get(int idx, null_type) const;
 
+            void check_column(int idx) const;
+
         private:
             sqlite3_stmt* theStmt;
-            std::string theSql;
             int theCurGetIndex;
         }; // row
 
@@ -198,24 +776,53 @@ namespace sqlite3cpp
         explicit query(database& db, const std::string& anSql);
 
         int column_count() const;
+        std::string column_name(int idx) const;    // index is 1-based
+
+        // Step through up to aMaxRows rows storing them in aBatch.
+        // Return the number of fetched rows, 0 when the query is exhausted.
+        size_t fetch_batch(column_batch& aBatch, size_t aMaxRows);
 
         typedef query_iterator iterator;
         iterator begin();
         iterator end();
     };
 
-    class transaction : boost::noncopyable
+    //
+    // Transaction ended with commit() or rollback(), or on destruction according to fcommit.
+    // Transactions nest: a transaction begun while another one is pending is a savepoint within it
+    // (SAVEPOINT, RELEASE and ROLLBACK TO), so that rolling it back undoes only its own changes.
+    // The mode applies to the outermost transaction only. Nested transactions shall end before the enclosing one.
+    // A transaction failed to commit, e.g. with SQLITE_BUSY or a deferred constraint violation, stays pending, so that
+    // commit() can be retried; otherwise it is rolled back with rollback() or on destruction.
+    //
+    class transaction
     {
     public:
+        // freserve begins an IMMEDIATE transaction
         explicit transaction(database& db, bool fcommit = false, bool freserve = false);
+        transaction(database& db, TransactionMode aMode, bool fcommit = false);
+        // The pending transaction is transferred, the source no longer ends it
+        transaction(transaction&& other);
+        // A transaction pending on this object is ended first, committed or rolled back according to fcommit
+        transaction& operator=(transaction&& other);
+        transaction(const transaction&) = delete;
+        transaction& operator=(const transaction&) = delete;
         ~transaction();
 
         void commit();
         void rollback();
+        // whether the transaction is a savepoint within another one
+        bool nested() const;
+
+    private:
+        void begin(TransactionMode aMode);
+        static void execute(database& db, const std::string& anSql);
 
     private:
         database* theDb;
         bool theCcommit;
+        int theLevel;       // number of transactions enclosing this one
+        bool theNested;
     };
 
 } // namespace sqlite3cpp
@@ -0,0 +1,223 @@
+// sqlite3cppasync.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cppasync.h"
+
+#include <limits>
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    namespace
+    {
+        void updateStats(async_queue_stats& aStats, double aLatency, bool aSucceeded)
+        {
+            ++(aSucceeded ? aStats.completed : aStats.failed);
+            aStats.total_latency_sec += aLatency;
+            if (aLatency > aStats.max_latency_sec)
+                aStats.max_latency_sec = aLatency;
+        }
+    }
+
+    void bind_params(statement& aStmt, const async_params& aParams)
+    {
+        for (size_t i = 0; i < aParams.size(); ++i)
+        {
+            if (detail::bind_param(aStmt.theStmt, i + 1, aParams[i]) != SQLITE_OK)
+                aStmt.throw_error("Failed to bind", i + 1);
+        }
+    }
+
+    async_result::async_result()
+        : changes(0), last_insert_rowid(0)
+    {}
+
+    async_queue_stats::async_queue_stats()
+        : depth(0), max_depth(0), completed(0), failed(0), total_latency_sec(0), max_latency_sec(0)
+    {}
+
+    async_database::async_database(const string& aDbPath, const string& aDbCreateSql, size_t aReaders,
+                                   const string& anExtensionPath, const open_options& anOptions)
+        : thePool(aDbPath, aDbCreateSql, aReaders, anExtensionPath, anOptions)
+        , theStopping(false)
+    {
+        try
+        {
+            theThreads.push_back(std::thread(&async_database::run, this, std::ref(theWrites), true));
+            for (size_t i = 0; i < aReaders; ++i)
+                theThreads.push_back(std::thread(&async_database::run, this, std::ref(theReads), false));
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+    }
+
+    async_database::~async_database()
+    {
+        stop();
+    }
+
+    void async_database::stop()
+    {
+        {
+            std::lock_guard<std::mutex> myLock(theMutex);
+            theStopping = true;
+        }
+        theReads.ready.notify_all();
+        theWrites.ready.notify_all();
+        for (std::vector<std::thread>::iterator it = theThreads.begin(); it != theThreads.end(); ++it)
+        {
+            if (it->joinable())
+                it->join();
+        }
+    }
+
+    std::future<async_result> async_database::read(const string& anSql, const async_params& aParams)
+    {
+        std::shared_ptr<std::promise<async_result> > myPromise = std::make_shared<std::promise<async_result> >();
+        read(anSql, aParams, [myPromise](std::exception_ptr anError, async_result& aResult)
+        {
+            if (anError)
+                myPromise->set_exception(anError);
+            else
+                myPromise->set_value(std::move(aResult));
+        });
+        return myPromise->get_future();
+    }
+
+    std::future<async_result> async_database::write(const string& anSql, const async_params& aParams)
+    {
+        std::shared_ptr<std::promise<async_result> > myPromise = std::make_shared<std::promise<async_result> >();
+        write(anSql, aParams, [myPromise](std::exception_ptr anError, async_result& aResult)
+        {
+            if (anError)
+                myPromise->set_exception(anError);
+            else
+                myPromise->set_value(std::move(aResult));
+        });
+        return myPromise->get_future();
+    }
+
+    void async_database::read(const string& anSql, const async_params& aParams, const callback& aCallback)
+    {
+        submit(read_queue(), anSql, aParams, aCallback);
+    }
+
+    void async_database::write(const string& anSql, const async_params& aParams, const callback& aCallback)
+    {
+        submit(theWrites, anSql, aParams, aCallback);
+    }
+
+    async_database_stats async_database::get_stats() const
+    {
+        std::lock_guard<std::mutex> myLock(theMutex);
+        async_database_stats myStats;
+        myStats.reads = theReads.stats;
+        myStats.writes = theWrites.stats;
+        return myStats;
+    }
+
+    async_database::task_queue& async_database::read_queue()
+    {
+        // without dedicated readers the writer serves reads as well
+        return (theThreads.size() > 1) ? theReads : theWrites;
+    }
+
+    void async_database::submit(task_queue& aQueue, const string& anSql, const async_params& aParams, const callback& aCallback)
+    {
+        task myTask;
+        myTask.sql = anSql;
+        myTask.params = aParams;
+        myTask.completion = aCallback;
+        myTask.submitted = clock::now();
+        {
+            std::lock_guard<std::mutex> myLock(theMutex);
+            if (theStopping)
+                throw database_error("Cannot submit a statement to the stopped async database");
+            aQueue.tasks.push_back(std::move(myTask));
+            aQueue.stats.depth = aQueue.tasks.size();
+            if (aQueue.stats.depth > aQueue.stats.max_depth)
+                aQueue.stats.max_depth = aQueue.stats.depth;
+        }
+        aQueue.ready.notify_one();
+    }
+
+    void async_database::run(task_queue& aQueue, bool aWriter)
+    {
+        connection_pool::handle myDb = aWriter ? thePool.acquire_writer() : thePool.acquire_reader();
+
+        for (;;)
+        {
+            task myTask;
+            {
+                std::unique_lock<std::mutex> myLock(theMutex);
+                while (aQueue.tasks.empty() && !theStopping)
+                    aQueue.ready.wait(myLock);
+                if (aQueue.tasks.empty())
+                    return;
+                myTask = std::move(aQueue.tasks.front());
+                aQueue.tasks.pop_front();
+                aQueue.stats.depth = aQueue.tasks.size();
+            }
+
+            async_result myResult;
+            std::exception_ptr myError;
+            try
+            {
+                myResult = execute(*myDb, myTask, aWriter);
+            }
+            catch (...)
+            {
+                myError = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> myLock(theMutex);
+                updateStats(aQueue.stats, std::chrono::duration<double>(clock::now() - myTask.submitted).count(), !myError);
+            }
+
+            try { myTask.completion(myError, myResult); }
+            catch (...) {}
+        }
+    }
+
+    async_result async_database::execute(database& db, const task& aTask, bool aWriter)
+    {
+        async_result myResult;
+        query myQuery(db, aTask.sql);
+        bind_params(myQuery, aTask.params);
+        myQuery.fetch_batch(myResult.rows, std::numeric_limits<size_t>::max());
+        if (aWriter)
+        {
+            myResult.changes = db.changes();
+            myResult.last_insert_rowid = db.last_insert_rowid();
+        }
+        return myResult;
+    }
+
+} // namespace sqlite3cpp
@@ -0,0 +1,135 @@
+// sqlite3cppasync.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPASYNC_H
+#define SQLITE3CPPASYNC_H
+
+#include "sqlite3cpp.h"
+#include "sqlite3cpppool.h"
+
+#include <deque>
+#include <vector>
+#include <future>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <chrono>
+
+namespace sqlite3cpp
+{
+    typedef detail::param_value async_param;
+    typedef std::vector<async_param> async_params;
+
+    // Bind parameters to the statement starting from the first position.
+    // Text and BLOB values are not copied, so aParams shall stay valid until the statement is executed.
+    void bind_params(statement& aStmt, const async_params& aParams);
+
+    struct async_result
+    {
+        async_result();
+
+        column_batch rows;              // all rows returned by the statement
+        int changes;                    // rows modified by a write
+        sqlite3_int64 last_insert_rowid;
+    };
+
+    struct async_queue_stats
+    {
+        async_queue_stats();
+
+        size_t depth;                   // statements waiting to be executed
+        size_t max_depth;
+        sqlite3_int64 completed;
+        sqlite3_int64 failed;
+        double total_latency_sec;       // time from submission till completion
+        double max_latency_sec;
+    };
+
+    struct async_database_stats
+    {
+        async_queue_stats reads;
+        async_queue_stats writes;
+    };
+
+    //
+    // Executes statements on background threads so that the calling thread never blocks on SQLite.
+    // Reads are served by aReaders threads each owning a read-only connection, writes are serialized
+    // through a single writer thread owning the only read-write connection.
+    // Results are delivered via std::future or via a callback invoked on the worker thread.
+    // Statements queued before destruction are still executed.
+    //
+    class async_database : boost::noncopyable
+    {
+    public:
+        // anError is null on success
+        typedef std::function<void(std::exception_ptr anError, async_result& aResult)> callback;
+
+        async_database(const std::string& aDbPath, const std::string& aDbCreateSql, size_t aReaders,
+                       const std::string& anExtensionPath = "", const open_options& anOptions = open_options());
+        ~async_database();
+
+        std::future<async_result> read(const std::string& anSql, const async_params& aParams = async_params());
+        std::future<async_result> write(const std::string& anSql, const async_params& aParams = async_params());
+        void read(const std::string& anSql, const async_params& aParams, const callback& aCallback);
+        void write(const std::string& anSql, const async_params& aParams, const callback& aCallback);
+
+        async_database_stats get_stats() const;
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        struct task
+        {
+            std::string sql;
+            async_params params;
+            callback completion;
+            clock::time_point submitted;
+        };
+
+        struct task_queue
+        {
+            std::deque<task> tasks;
+            std::condition_variable ready;
+            async_queue_stats stats;
+        };
+
+        void stop();
+        task_queue& read_queue();
+        void submit(task_queue& aQueue, const std::string& anSql, const async_params& aParams, const callback& aCallback);
+        void run(task_queue& aQueue, bool aWriter);
+        async_result execute(database& db, const task& aTask, bool aWriter);
+
+    private:
+        connection_pool thePool;
+        mutable std::mutex theMutex;
+        bool theStopping;
+        task_queue theReads;
+        task_queue theWrites;
+        std::vector<std::thread> theThreads;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
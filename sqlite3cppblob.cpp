@@ -0,0 +1,250 @@
+// sqlite3cppblob.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cppblob.h"
+#include "boost/format.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    //
+    // BLOB stream
+    //
+
+    blob_stream::blob_stream(database& db, const string& aTable, const string& aColumn, sqlite3_int64 aRowId, BlobAccess anAccess, const string& aDbName)
+        : theDb(db), theName(aDbName + "." + aTable + "." + aColumn), theBlob(NULL), theRowId(aRowId), theAccess(anAccess)
+    {
+        if (sqlite3_blob_open(theDb.theDb, aDbName.c_str(), aTable.c_str(), aColumn.c_str(), aRowId, (anAccess == blobReadWrite) ? 1 : 0, &theBlob) != SQLITE_OK)
+        {
+            // the handle is allocated even on failure
+            database_error myError(theDb, "Failed to open BLOB", theName);
+            sqlite3_blob_close(theBlob);
+            throw myError;
+        }
+    }
+
+    blob_stream::~blob_stream()
+    {
+        try { close(); }
+        catch (...) {}
+    }
+
+    void blob_stream::reopen(sqlite3_int64 aRowId)
+    {
+        if (!theBlob)
+            throw database_error(str(boost::format("BLOB stream %s is closed") % theName));
+        if (sqlite3_blob_reopen(theBlob, aRowId) != SQLITE_OK)
+            throw database_error(theDb, "Failed to reopen BLOB", theName);
+        theRowId = aRowId;
+    }
+
+    void blob_stream::close()
+    {
+        if (theBlob)
+        {
+            sqlite3_blob* myBlob = theBlob;
+            theBlob = NULL;
+            if (sqlite3_blob_close(myBlob) != SQLITE_OK)
+                throw database_error(theDb, "Failed to close BLOB", theName);
+        }
+    }
+
+    sqlite3_int64 blob_stream::rowid() const
+    {
+        return theRowId;
+    }
+
+    BlobAccess blob_stream::access() const
+    {
+        return theAccess;
+    }
+
+    size_t blob_stream::size() const
+    {
+        if (!theBlob)
+            throw database_error(str(boost::format("BLOB stream %s is closed") % theName));
+        return sqlite3_blob_bytes(theBlob);
+    }
+
+    void blob_stream::read(void* aBuffer, size_t aSize, size_t anOffset) const
+    {
+        check_range(aSize, anOffset);
+        if (sqlite3_blob_read(theBlob, aBuffer, static_cast<int>(aSize), static_cast<int>(anOffset)) != SQLITE_OK)
+            throw database_error(theDb, "Failed to read BLOB", theName);
+    }
+
+    void blob_stream::write(void const* aBuffer, size_t aSize, size_t anOffset)
+    {
+        check_range(aSize, anOffset);
+        if (sqlite3_blob_write(theBlob, aBuffer, static_cast<int>(aSize), static_cast<int>(anOffset)) != SQLITE_OK)
+            throw database_error(theDb, "Failed to write BLOB", theName);
+    }
+
+    void blob_stream::check_range(size_t aSize, size_t anOffset) const
+    {
+        const size_t mySize = size();
+        if (anOffset > mySize || aSize > mySize - anOffset)
+            throw database_error(str(boost::format("Range of %u bytes at offset %u is out of BLOB %s of %u bytes at row %d") % aSize % anOffset % theName % mySize % theRowId));
+    }
+
+
+    //
+    // BLOB stream buffer
+    //
+
+    blob_streambuf::blob_streambuf(blob_stream& aBlob, size_t aBufferSize)
+        : theBlob(aBlob), theBuffer(std::max<size_t>(aBufferSize, 1)), theBufferPos(0)
+    {}
+
+    blob_streambuf::~blob_streambuf()
+    {
+        try { flush(); }
+        catch (...) {}
+    }
+
+    blob_streambuf::int_type blob_streambuf::underflow()
+    {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        const size_t myPos = position();
+        flush();
+        theBufferPos = myPos;
+        const size_t mySize = theBlob.size();
+        const size_t myCount = std::min(theBuffer.size(), mySize - std::min(myPos, mySize));
+        if (myCount == 0)
+        {
+            setg(NULL, NULL, NULL);
+            return traits_type::eof();
+        }
+        theBlob.read(&theBuffer[0], myCount, myPos);
+        setg(&theBuffer[0], &theBuffer[0], &theBuffer[0] + myCount);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    blob_streambuf::int_type blob_streambuf::overflow(int_type aChar)
+    {
+        const size_t myPos = position();
+        flush();
+        setg(NULL, NULL, NULL);
+        theBufferPos = myPos;
+        const size_t mySize = theBlob.size();
+        const size_t myCount = std::min(theBuffer.size(), mySize - std::min(myPos, mySize));
+        if (myCount == 0)
+            return traits_type::eof(); // BLOB cannot grow
+        setp(&theBuffer[0], &theBuffer[0] + myCount);
+        if (!traits_type::eq_int_type(aChar, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(aChar);
+            pbump(1);
+        }
+        return traits_type::not_eof(aChar);
+    }
+
+    int blob_streambuf::sync()
+    {
+        const size_t myPos = position();
+        flush();
+        setg(NULL, NULL, NULL);
+        theBufferPos = myPos;
+        return 0;
+    }
+
+    std::streamsize blob_streambuf::xsgetn(char* aBuffer, std::streamsize aSize)
+    {
+        if (aSize < static_cast<std::streamsize>(theBuffer.size()))
+            return std::streambuf::xsgetn(aBuffer, aSize);
+
+        // large reads go to the BLOB directly bypassing the buffer
+        const std::streamsize myBuffered = std::min<std::streamsize>(aSize, egptr() - gptr());
+        if (myBuffered > 0)
+            memcpy(aBuffer, gptr(), myBuffered);
+        gbump(static_cast<int>(myBuffered));
+        const size_t myPos = position();
+        flush();
+        setg(NULL, NULL, NULL);
+        const size_t mySize = theBlob.size();
+        const size_t myCount = std::min<size_t>(aSize - myBuffered, mySize - std::min(myPos, mySize));
+        theBlob.read(aBuffer + myBuffered, myCount, myPos);
+        theBufferPos = myPos + myCount;
+        return myBuffered + myCount;
+    }
+
+    std::streamsize blob_streambuf::xsputn(const char* aBuffer, std::streamsize aSize)
+    {
+        if (aSize < static_cast<std::streamsize>(theBuffer.size()))
+            return std::streambuf::xsputn(aBuffer, aSize);
+
+        // large writes go to the BLOB directly bypassing the buffer
+        const size_t myPos = position();
+        flush();
+        setg(NULL, NULL, NULL);
+        const size_t mySize = theBlob.size();
+        const size_t myCount = std::min<size_t>(aSize, mySize - std::min(myPos, mySize));
+        theBlob.write(aBuffer, myCount, myPos);
+        theBufferPos = myPos + myCount;
+        return myCount;
+    }
+
+    blob_streambuf::pos_type blob_streambuf::seekoff(off_type anOffset, std::ios_base::seekdir aDir, std::ios_base::openmode)
+    {
+        const off_type myBase = (aDir == std::ios_base::beg) ? 0 : (aDir == std::ios_base::cur) ? position() : theBlob.size();
+        const off_type myPos = myBase + anOffset;
+        if (myPos < 0 || myPos > static_cast<off_type>(theBlob.size()))
+            return pos_type(off_type(-1));
+        flush();
+        setg(NULL, NULL, NULL);
+        theBufferPos = myPos;
+        return pos_type(myPos);
+    }
+
+    blob_streambuf::pos_type blob_streambuf::seekpos(pos_type aPos, std::ios_base::openmode aMode)
+    {
+        return seekoff(off_type(aPos), std::ios_base::beg, aMode);
+    }
+
+    size_t blob_streambuf::position() const
+    {
+        // at most one of the get and put areas is in use
+        return theBufferPos + (gptr() - eback()) + (pptr() - pbase());
+    }
+
+    bool blob_streambuf::flush()
+    {
+        const size_t myCount = pptr() - pbase();
+        if (myCount > 0)
+        {
+            theBlob.write(pbase(), myCount, theBufferPos);
+            theBufferPos += myCount;
+        }
+        setp(NULL, NULL);
+        return true;
+    }
+
+} // namespace sqlite3cpp
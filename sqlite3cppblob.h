@@ -0,0 +1,111 @@
+// sqlite3cppblob.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPBLOB_H
+#define SQLITE3CPPBLOB_H
+
+#include "sqlite3cpp.h"
+
+#include <streambuf>
+#include <vector>
+
+namespace sqlite3cpp
+{
+    enum BlobAccess
+    {
+        blobReadOnly, blobReadWrite
+    };
+
+    //
+    // Incremental I/O on a BLOB stored in the given table, column and row (sqlite3_blob_*).
+    // The BLOB cannot be resized through the stream: insert the row with a zeroblob of the final size first.
+    // The stream is invalidated if the row is modified by other means, subsequent I/O then fails with SQLITE_ABORT.
+    // The stream shall be closed or destroyed before the database is closed.
+    //
+    class blob_stream : boost::noncopyable
+    {
+    public:
+        blob_stream(database& db, const std::string& aTable, const std::string& aColumn, sqlite3_int64 aRowId,
+                    BlobAccess anAccess = blobReadOnly, const std::string& aDbName = "main");
+        ~blob_stream();
+
+        // Point the stream to the same column of another row, which is much cheaper than opening a new stream
+        void reopen(sqlite3_int64 aRowId);
+        void close();
+
+        sqlite3_int64 rowid() const;
+        BlobAccess access() const;
+        size_t size() const;
+
+        // Random access, the range shall lie within the BLOB
+        void read(void* aBuffer, size_t aSize, size_t anOffset) const;
+        void write(void const* aBuffer, size_t aSize, size_t anOffset);
+
+    private:
+        void check_range(size_t aSize, size_t anOffset) const;
+
+    private:
+        database& theDb;
+        std::string theName;    // db.table.column used in error messages
+        sqlite3_blob* theBlob;
+        sqlite3_int64 theRowId;
+        BlobAccess theAccess;
+    };
+
+    //
+    // std::streambuf over a blob_stream for use with std::istream and std::ostream.
+    // Data is transferred in chunks of aBufferSize bytes, so the memory used does not depend on the BLOB size.
+    // Writing past the end of the BLOB fails. Flush the output and seek to the beginning after reopening the blob_stream.
+    //
+    class blob_streambuf : public std::streambuf
+    {
+    public:
+        static const size_t DefaultBufferSize = 64 * 1024;
+
+        explicit blob_streambuf(blob_stream& aBlob, size_t aBufferSize = DefaultBufferSize);
+        ~blob_streambuf();
+
+    protected:
+        int_type underflow();
+        int_type overflow(int_type aChar);
+        int sync();
+        std::streamsize xsgetn(char* aBuffer, std::streamsize aSize);
+        std::streamsize xsputn(const char* aBuffer, std::streamsize aSize);
+        pos_type seekoff(off_type anOffset, std::ios_base::seekdir aDir, std::ios_base::openmode aMode);
+        pos_type seekpos(pos_type aPos, std::ios_base::openmode aMode);
+
+    private:
+        size_t position() const;
+        bool flush();
+
+    private:
+        blob_stream& theBlob;
+        std::vector<char> theBuffer;
+        size_t theBufferPos;    // BLOB offset of the buffer start
+    };
+
+} // namespace sqlite3cpp
+
+#endif
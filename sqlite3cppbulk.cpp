@@ -0,0 +1,128 @@
+// sqlite3cppbulk.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cppbulk.h"
+
+namespace sqlite3cpp
+{
+    bulk_insert_stats::bulk_insert_stats()
+        : rows(0), batches(0), elapsed_sec(0)
+    {}
+
+    double bulk_insert_stats::rows_per_sec() const
+    {
+        return (elapsed_sec > 0) ? rows / elapsed_sec : 0;
+    }
+
+    bulk_inserter::bulk_inserter(database& db, const std::string& anInsertSql, size_t aBatchSize, unsigned int aBatchIntervalMs)
+        : theDb(db)
+        , theCmd(db, anInsertSql)
+        , theBatchSize(aBatchSize)
+        , theBatchIntervalMs(aBatchIntervalMs)
+        , theBatchRows(0)
+        , theBatchStart(0)
+        , theStart(0)
+    {}
+
+    void bulk_inserter::flush()
+    {
+        if (theXct)
+        {
+            try
+            {
+                theXct->commit();
+            }
+            catch (...)
+            {
+                // drop the batch, so that the next rows start a new one
+                theStats.rows -= theBatchRows;
+                theBatchRows = 0;
+                theXct.reset();
+                throw;
+            }
+            theXct.reset();
+            theBatchRows = 0;
+            ++theStats.batches;
+            theStats.elapsed_sec = detail::now() - theStart;
+        }
+    }
+
+    void bulk_inserter::set_batch_size(size_t aBatchSize)
+    {
+        theBatchSize = aBatchSize;
+    }
+
+    void bulk_inserter::set_batch_interval(unsigned int aBatchIntervalMs)
+    {
+        theBatchIntervalMs = aBatchIntervalMs;
+    }
+
+    bulk_insert_stats bulk_inserter::get_stats() const
+    {
+        bulk_insert_stats myStats = theStats;
+        // stopped at the last commit, so that the time after the last batch does not count
+        if (theXct)
+            myStats.elapsed_sec = detail::now() - theStart;
+        return myStats;
+    }
+
+    void bulk_inserter::begin_row()
+    {
+        if (!theXct)
+        {
+            const bool myCommitOnExit = false;
+            const bool myReserve = true;
+            theXct.reset(new transaction(theDb, myCommitOnExit, myReserve));
+            theBatchStart = detail::now();
+            if (theStats.rows == 0)
+                theStart = theBatchStart;
+        }
+    }
+
+    void bulk_inserter::end_row()
+    {
+        try
+        {
+            theCmd.execute();
+        }
+        catch (...)
+        {
+            // the failed row is skipped, reset the command for the next one; reset reports the failure once more
+            try { theCmd.reset(); }
+            catch (database_error&) {}
+            throw;
+        }
+        theCmd.reset();
+        ++theBatchRows;
+        ++theStats.rows;
+
+        if ((theBatchSize > 0 && theBatchRows >= theBatchSize) ||
+                (theBatchIntervalMs > 0 && (detail::now() - theBatchStart) * 1000 >= theBatchIntervalMs))
+        {
+            flush();
+        }
+    }
+
+} // namespace sqlite3cpp
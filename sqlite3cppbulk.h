@@ -0,0 +1,116 @@
+// sqlite3cppbulk.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPBULK_H
+#define SQLITE3CPPBULK_H
+
+#include "sqlite3cpp.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/fusion/include/for_each.hpp>
+#include <boost/fusion/include/boost_tuple.hpp>
+#include <boost/fusion/include/std_pair.hpp>
+
+namespace sqlite3cpp
+{
+    struct bulk_insert_stats
+    {
+        bulk_insert_stats();
+        double rows_per_sec() const;
+
+        sqlite3_int64 rows;     // rows inserted, including rows of the not yet committed batch
+        sqlite3_int64 batches;  // committed batches
+        double elapsed_sec;     // time from the first inserted row to the last commit, or until now while a batch is pending
+    };
+
+    //
+    // Inserts rows with a single prepared command committing them in batches of BEGIN IMMEDIATE ... COMMIT.
+    // A batch is committed after aBatchSize rows or when aBatchIntervalMs milliseconds elapsed since the batch start,
+    // whatever comes first (0 disables the corresponding limit).
+    // Rows are boost::tuple's, std::pair's or structs adapted with BOOST_FUSION_ADAPT_STRUCT;
+    // their members are bound to the command parameters in order.
+    // Rows of the batch not committed with flush() are rolled back on destruction.
+    // A batch failed to commit is rolled back and its rows are not counted, the following rows start a new batch.
+    // Within a pending transaction the batches are savepoints of it, see transaction.
+    //
+    class bulk_inserter : boost::noncopyable
+    {
+    public:
+        static const size_t DefaultBatchSize = 10000;
+
+        bulk_inserter(database& db, const std::string& anInsertSql, size_t aBatchSize = DefaultBatchSize, unsigned int aBatchIntervalMs = 0);
+
+        template <class Row> void insert(const Row& aRow)
+        {
+            begin_row();
+            boost::fusion::for_each(aRow, column_binder(theCmd));
+            end_row();
+        }
+
+        template <class Iterator> void insert(Iterator aBegin, Iterator anEnd)
+        {
+            for (; aBegin != anEnd; ++aBegin)
+                insert(*aBegin);
+        }
+
+        // commits the current batch
+        void flush();
+
+        void set_batch_size(size_t aBatchSize);
+        void set_batch_interval(unsigned int aBatchIntervalMs);
+        bulk_insert_stats get_stats() const;
+
+    private:
+        class column_binder
+        {
+        public:
+            explicit column_binder(command& aCmd) : theCmd(aCmd), theIdx(1) {}
+            template <class T> void operator()(const T& value) const
+            {
+                theCmd.bind(theIdx++, value);
+            }
+        private:
+            command& theCmd;
+            mutable int theIdx;
+        };
+
+        void begin_row();
+        void end_row();
+
+    private:
+        database& theDb;
+        command theCmd;
+        boost::scoped_ptr<transaction> theXct;
+        size_t theBatchSize;
+        unsigned int theBatchIntervalMs;
+        size_t theBatchRows;
+        double theBatchStart;
+        double theStart;
+        bulk_insert_stats theStats;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
@@ -0,0 +1,328 @@
+// sqlite3cppcache.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPCACHE_H
+#define SQLITE3CPPCACHE_H
+
+#include "sqlite3cpp.h"
+#include "sqlite3cpptyped.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <boost/unordered_map.hpp>
+
+namespace sqlite3cpp
+{
+    struct cached_table_stats
+    {
+        cached_table_stats();
+
+        size_t rows;
+        sqlite3_int64 hits;
+        sqlite3_int64 misses;
+        sqlite3_int64 refreshed_rows;   // rows re-read after they were changed
+        sqlite3_int64 reloads;          // full reloads including the initial load
+    };
+
+    //
+    // In-memory mirror of a rowid table for lookups by a unique key column, served without touching SQLite.
+    // Rows are stored contiguously and addressed by a hash index on the key.
+    // Changes made through the owning connection are tracked by row id with a change_listener and the changed rows
+    // are re-read on the next lookup; when many rows or unreported rows have changed, the table is reloaded.
+    // Rows read while a transaction is pending are read once more after it ends, since a rollback is not reported,
+    // and after a nested transaction is rolled back. ROLLBACK TO a savepoint executed as SQL is not observed,
+    // call reload() after it.
+    // Changes made by other connections are not observed, call reload() to pick them up.
+    // Row is std::tuple, boost::tuple, std::pair or a struct adapted with BOOST_FUSION_ADAPT_STRUCT, its members and
+    // Key shall own their values (no boost::string_view or blob_view). The mirror shall be destroyed before the database.
+    //
+    // Usage:
+    //    cached_table<int, std::tuple<std::string, double> > rates(db, "Rates", "id", "currency, rate");
+    //    if (const std::tuple<std::string, double>* rate = rates.find(42)) {...}
+    //
+    template <class Key, class Row>
+    class cached_table : private change_listener, boost::noncopyable
+    {
+    public:
+        cached_table(database& db, const std::string& aTable, const std::string& aKeyColumn, const std::string& aColumns)
+            : theDb(db)
+            , theTable(aTable)
+            , theLoadQuery(db, "SELECT rowid, " + aKeyColumn + ", " + aColumns + " FROM " + aTable, 0)
+            , theRefreshQuery(db, "SELECT rowid, " + aKeyColumn + ", " + aColumns + " FROM " + aTable + " WHERE rowid = ?", 1)
+            , theReloadNeeded(true)
+            , theLoadedUncommitted(false)
+        {
+            theDb.add_change_listener(this);
+            try
+            {
+                sync();
+            }
+            catch (...)
+            {
+                theDb.remove_change_listener(this);
+                throw;
+            }
+        }
+
+        ~cached_table()
+        {
+            theDb.remove_change_listener(this);
+        }
+
+        // The returned row stays valid until the next call of a non-const member, NULL if there is no such key
+        Row const* find(const Key& aKey)
+        {
+            sync();
+            typename KeyIndex::const_iterator it = theKeyIndex.find(aKey);
+            if (it == theKeyIndex.end())
+            {
+                ++theStats.misses;
+                return NULL;
+            }
+            ++theStats.hits;
+            return &theEntries[it->second].row;
+        }
+
+        size_t size()
+        {
+            sync();
+            return theEntries.size();
+        }
+
+        void reload()
+        {
+            theEntries.clear();
+            theKeyIndex.clear();
+            theRowIdIndex.clear();
+            theStale.clear();
+            theUncommitted.clear();
+            theReloadNeeded = false;
+            theLoadedUncommitted = theDb.in_transaction();
+            ++theStats.reloads;
+            try
+            {
+                theLoadQuery.execute();
+                entry myEntry;
+                while (theLoadQuery.fetch(myEntry))
+                    store(myEntry);
+            }
+            catch (...)
+            {
+                theReloadNeeded = true;
+                throw;
+            }
+            theLoadQuery.close();
+        }
+
+        cached_table_stats get_stats() const
+        {
+            cached_table_stats myStats = theStats;
+            myStats.rows = theEntries.size();
+            return myStats;
+        }
+
+    private:
+        struct entry
+        {
+            sqlite3_int64 rowid;
+            Key key;
+            Row row;
+        };
+
+        // SELECT rowid, key, columns... decoded into an entry
+        class row_query : public statement
+        {
+        public:
+            row_query(database& db, const std::string& anSql, int aParamCount)
+                : statement(db, anSql)
+            {
+                std::vector<detail::ValueKind> myColumns;
+                const detail::ValueKind myKeyKind = detail::column_value<Key>::kind;
+                myColumns.push_back(detail::valueInteger);
+                myColumns.push_back(myKeyKind);
+                Row myRow;
+                boost::fusion::for_each(myRow, detail::column_kinds_collector(myColumns));
+                detail::check_statement(theStmt, aParamCount, myColumns);
+            }
+
+            void execute()
+            {
+                rewind();
+            }
+
+            void execute(sqlite3_int64 aRowId)
+            {
+                rewind();
+                bind(1, aRowId);
+            }
+
+            bool fetch(entry& anEntry)
+            {
+                if (!step_row())
+                    return false;
+                anEntry.rowid = sqlite3_column_int64(theStmt, 0);
+                detail::column_value<Key>::read(theStmt, 1, anEntry.key);
+                boost::fusion::for_each(anEntry.row, detail::column_reader(theStmt, 2));
+                return true;
+            }
+
+            // end the read transaction of an autocommit query
+            void close()
+            {
+                rewind();
+            }
+        };
+
+        typedef boost::unordered_map<Key, size_t> KeyIndex;
+        typedef boost::unordered_map<sqlite3_int64, size_t> RowIdIndex;
+
+        void on_row_changed(int, char const* aDbName, char const* aTable, sqlite3_int64 aRowId)
+        {
+            if (theReloadNeeded || strcmp(aDbName, "main") != 0 || sqlite3_stricmp(aTable, theTable.c_str()) != 0)
+                return;
+            theStale.push_back(aRowId);
+            // re-reading many rows one by one is slower than a reload
+            if (theStale.size() > theEntries.size() / 2 + 64)
+            {
+                theReloadNeeded = true;
+                theStale.clear();
+            }
+        }
+
+        void on_unreported_changes()
+        {
+            theReloadNeeded = true;
+            theStale.clear();
+        }
+
+        void on_savepoint_rollback()
+        {
+            // any row changed within the transaction may have been restored
+            if (theLoadedUncommitted)
+            {
+                theReloadNeeded = true;
+                theStale.clear();
+                return;
+            }
+            theStale.insert(theStale.end(), theUncommitted.begin(), theUncommitted.end());
+            if (theStale.size() > theEntries.size() / 2 + 64)
+            {
+                theReloadNeeded = true;
+                theStale.clear();
+            }
+        }
+
+        void sync()
+        {
+            theDb.check_unreported_changes();
+            const bool myInTransaction = theDb.in_transaction();
+            if (!myInTransaction)
+            {
+                // the transaction the rows were read in has ended, committed or rolled back
+                if (theLoadedUncommitted)
+                    theReloadNeeded = true;
+                theStale.insert(theStale.end(), theUncommitted.begin(), theUncommitted.end());
+                theUncommitted.clear();
+            }
+            if (theReloadNeeded)
+            {
+                reload();
+                return;
+            }
+            if (theStale.empty())
+                return;
+
+            std::sort(theStale.begin(), theStale.end());
+            theStale.erase(std::unique(theStale.begin(), theStale.end()), theStale.end());
+            for (size_t i = 0; i < theStale.size(); ++i)
+            {
+                refresh(theStale[i]);
+                ++theStats.refreshed_rows;
+            }
+            if (myInTransaction)
+                theUncommitted.insert(theUncommitted.end(), theStale.begin(), theStale.end());
+            theStale.clear();
+        }
+
+        void refresh(sqlite3_int64 aRowId)
+        {
+            entry myEntry;
+            theRefreshQuery.execute(aRowId);
+            const bool myFound = theRefreshQuery.fetch(myEntry);
+            theRefreshQuery.close();
+
+            typename RowIdIndex::iterator it = theRowIdIndex.find(aRowId);
+            if (it != theRowIdIndex.end())
+                erase(it->second);
+            if (myFound)
+                store(myEntry);
+        }
+
+        void store(entry& anEntry)
+        {
+            // a key shared by several rows refers to the last one stored
+            typename KeyIndex::iterator it = theKeyIndex.find(anEntry.key);
+            if (it != theKeyIndex.end())
+                erase(it->second);
+            const size_t myPos = theEntries.size();
+            theEntries.push_back(anEntry);
+            theKeyIndex[anEntry.key] = myPos;
+            theRowIdIndex[anEntry.rowid] = myPos;
+        }
+
+        // the last entry takes the place of the erased one
+        void erase(size_t aPos)
+        {
+            theKeyIndex.erase(theEntries[aPos].key);
+            theRowIdIndex.erase(theEntries[aPos].rowid);
+            const size_t myLast = theEntries.size() - 1;
+            if (aPos != myLast)
+            {
+                std::swap(theEntries[aPos], theEntries[myLast]);
+                theKeyIndex[theEntries[aPos].key] = aPos;
+                theRowIdIndex[theEntries[aPos].rowid] = aPos;
+            }
+            theEntries.pop_back();
+        }
+
+    private:
+        database& theDb;
+        std::string theTable;
+        row_query theLoadQuery;
+        row_query theRefreshQuery;
+        std::vector<entry> theEntries;
+        KeyIndex theKeyIndex;
+        RowIdIndex theRowIdIndex;
+        std::vector<sqlite3_int64> theStale;    // row ids changed since the last sync
+        std::vector<sqlite3_int64> theUncommitted;  // row ids read while a transaction is pending
+        bool theReloadNeeded;
+        bool theLoadedUncommitted;              // the table was loaded while a transaction is pending
+        cached_table_stats theStats;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
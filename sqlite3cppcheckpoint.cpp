@@ -0,0 +1,223 @@
+// sqlite3cppcheckpoint.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cppcheckpoint.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    namespace
+    {
+        // Checkpoint sequence number from the WAL file header, incremented each time a writer restarts the WAL.
+        // Return -1 if there is no WAL header, which is the case after the WAL is truncated.
+        sqlite3_int64 readWalSequence(const string& aWalPath)
+        {
+            const int fd = ::open(aWalPath.c_str(), O_RDONLY);
+            if (fd < 0)
+                return -1;
+            unsigned char myHeader[4];
+            const ssize_t myRead = pread(fd, myHeader, sizeof(myHeader), 12);
+            ::close(fd);
+            if (myRead != sizeof(myHeader))
+                return -1;
+            return (sqlite3_int64(myHeader[0]) << 24) | (myHeader[1] << 16) | (myHeader[2] << 8) | myHeader[3];
+        }
+    }
+
+    checkpoint_policy::checkpoint_policy()
+        : interval_ms(1000), passive_frames(1000), truncate_frames(10000), busy_timeout_ms(100)
+    {}
+
+    checkpointer_stats::checkpointer_stats()
+        : checkpoints(0), truncations(0), busy(0), errors(0), frames_checkpointed(0), log_frames(0), total_sec(0), max_sec(0)
+    {}
+
+    wal_checkpointer::wakeup::wakeup()
+        : pending(false), stopping(false)
+    {}
+
+    wal_checkpointer::wal_checkpointer(const string& aDbPath, const checkpoint_policy& aPolicy, const open_options& anOptions)
+        : theDb(aDbPath, "", "", anOptions)
+        , theWalPath(aDbPath + "-wal")
+        , thePolicy(aPolicy)
+        , theWakeup(std::make_shared<wakeup>())
+    {
+        theDb.set_busy_timeout(thePolicy.busy_timeout_ms);
+        // the checkpointer does not write, but make sure it never checkpoints on its own
+        theDb.set_wal_autocheckpoint(0);
+        theLastResult.log_frames = 0;
+        theLastResult.checkpointed_frames = 0;
+        theLastWalSequence = -1;
+        theThread = std::thread(&wal_checkpointer::run, this);
+    }
+
+    wal_checkpointer::~wal_checkpointer()
+    {
+        {
+            std::lock_guard<std::mutex> myLock(theWakeup->mutex);
+            theWakeup->stopping = true;
+        }
+        theWakeup->cond.notify_one();
+        theThread.join();
+
+        for (size_t i = 0; i < theWriters.size(); ++i)
+        {
+            try { theWriters[i].first->set_wal_autocheckpoint(theWriters[i].second); }
+            catch (...) {}
+        }
+    }
+
+    void wal_checkpointer::attach(database& aWriter)
+    {
+        bool myAttached = false;
+        for (size_t i = 0; i < theWriters.size() && !myAttached; ++i)
+            myAttached = (theWriters[i].first == &aWriter);
+        if (!myAttached)
+        {
+            theWriters.push_back(std::make_pair(&aWriter, aWriter.get_wal_autocheckpoint()));
+        }
+
+        const std::shared_ptr<wakeup> myWakeup = theWakeup;
+        const int myFrames = thePolicy.passive_frames;
+        aWriter.set_wal_callback([myWakeup, myFrames](const string&, int aFrames)
+        {
+            if (aFrames < myFrames)
+                return;
+            {
+                std::lock_guard<std::mutex> myLock(myWakeup->mutex);
+                if (myWakeup->pending)
+                    return;
+                myWakeup->pending = true;
+            }
+            myWakeup->cond.notify_one();
+        });
+    }
+
+    void wal_checkpointer::detach(database& aWriter)
+    {
+        for (size_t i = 0; i < theWriters.size(); ++i)
+        {
+            if (theWriters[i].first == &aWriter)
+            {
+                const int myFrames = theWriters[i].second;
+                theWriters.erase(theWriters.begin() + i);
+                aWriter.set_wal_autocheckpoint(myFrames);
+                return;
+            }
+        }
+    }
+
+    void wal_checkpointer::trigger()
+    {
+        {
+            std::lock_guard<std::mutex> myLock(theWakeup->mutex);
+            theWakeup->pending = true;
+        }
+        theWakeup->cond.notify_one();
+    }
+
+    checkpointer_stats wal_checkpointer::get_stats() const
+    {
+        std::lock_guard<std::mutex> myLock(theWakeup->mutex);
+        return theStats;
+    }
+
+    void wal_checkpointer::run()
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> myLock(theWakeup->mutex);
+                wakeup& myWakeup = *theWakeup;
+                myWakeup.cond.wait_for(myLock, std::chrono::milliseconds(thePolicy.interval_ms),
+                                       [&myWakeup]() { return myWakeup.pending || myWakeup.stopping; });
+                if (myWakeup.stopping)
+                    return;
+                myWakeup.pending = false;
+            }
+            run_checkpoint();
+        }
+    }
+
+    void wal_checkpointer::run_checkpoint()
+    {
+        const double myStart = detail::now();
+        checkpoint_result myResult;
+        bool myBusy = false;
+        bool myTruncated = false;
+        bool myFailed = false;
+        sqlite3_int64 myFrames = 0;
+        try
+        {
+            // Frames are counted from the start of the WAL, which writers restart once it is fully checkpointed.
+            // The WAL cannot be restarted while it is being checkpointed, so the sequence read before belongs to the result.
+            const sqlite3_int64 myWalSequence = readWalSequence(theWalPath);
+            myResult = theDb.checkpoint(checkpointPassive);
+            myBusy = myResult.busy;
+            const bool mySameWal = (myWalSequence == theLastWalSequence);
+            myFrames = std::max(0, myResult.checkpointed_frames - (mySameWal ? theLastResult.checkpointed_frames : 0));
+            theLastWalSequence = myWalSequence;
+
+            if (thePolicy.truncate_frames > 0 && myResult.log_frames >= thePolicy.truncate_frames)
+            {
+                const checkpoint_result myTruncateResult = theDb.checkpoint(checkpointTruncate);
+                if (myTruncateResult.busy)
+                {
+                    myBusy = true;
+                }
+                else
+                {
+                    myTruncated = true;
+                    myFrames += myResult.log_frames - myResult.checkpointed_frames;
+                    myResult = myTruncateResult;
+                    theLastWalSequence = -1;
+                }
+            }
+            theLastResult = myResult;
+        }
+        catch (database_error&)
+        {
+            myFailed = true;
+        }
+        const double myElapsed = detail::now() - myStart;
+
+        std::lock_guard<std::mutex> myLock(theWakeup->mutex);
+        ++theStats.checkpoints;
+        theStats.truncations += myTruncated;
+        theStats.busy += myBusy;
+        theStats.errors += myFailed;
+        theStats.frames_checkpointed += myFrames;
+        theStats.log_frames = std::max(0, myResult.log_frames);
+        theStats.total_sec += myElapsed;
+        theStats.max_sec = std::max(theStats.max_sec, myElapsed);
+    }
+
+} // namespace sqlite3cpp
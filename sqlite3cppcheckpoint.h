@@ -0,0 +1,118 @@
+// sqlite3cppcheckpoint.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPCHECKPOINT_H
+#define SQLITE3CPPCHECKPOINT_H
+
+#include "sqlite3cpp.h"
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace sqlite3cpp
+{
+    struct checkpoint_policy
+    {
+        checkpoint_policy();
+
+        unsigned int interval_ms;   // a passive checkpoint runs at least this often
+        int passive_frames;         // an attached writer reporting a WAL of this many frames wakes the checkpointer up early
+        int truncate_frames;        // a WAL grown to this many frames is checkpointed and truncated, 0 disables
+        int busy_timeout_ms;        // time budget of the truncating checkpoint waiting for readers and writers
+    };
+
+    struct checkpointer_stats
+    {
+        checkpointer_stats();
+
+        sqlite3_int64 checkpoints;          // checkpoint runs
+        sqlite3_int64 truncations;          // completed truncating checkpoints
+        sqlite3_int64 busy;                 // checkpoints that could not complete because of readers or writers
+        sqlite3_int64 errors;
+        sqlite3_int64 frames_checkpointed;  // frames transferred to the Db by the checkpointer, not counting frames
+                                            // committed while a truncating checkpoint waits for the writer
+        int log_frames;                     // frames in the WAL after the last checkpoint
+        double total_sec;                   // time spent checkpointing
+        double max_sec;
+    };
+
+    //
+    // Background checkpointer of a Db in WAL mode running on its own thread and connection.
+    // A passive checkpoint, which never waits for readers or writers, runs every interval or when an attached writer
+    // reports that the WAL reached the policy size. When long readers keep the WAL growing above the truncation size,
+    // a truncating checkpoint waits up to the busy timeout for them and resets the WAL file to zero length.
+    // Attached writers do not checkpoint on commit anymore, so their latency does not depend on checkpoints.
+    //
+    class wal_checkpointer : boost::noncopyable
+    {
+    public:
+        wal_checkpointer(const std::string& aDbPath, const checkpoint_policy& aPolicy = checkpoint_policy(),
+                         const open_options& anOptions = open_options());
+        ~wal_checkpointer();
+
+        // Replace the automatic checkpoint of aWriter with a WAL callback notifying the checkpointer.
+        // The automatic checkpoint of the writer is restored by detach() or when the checkpointer is destroyed,
+        // so a writer closed or moved before the checkpointer is destroyed shall be detached first.
+        void attach(database& aWriter);
+        void detach(database& aWriter);
+        // wake the checkpointer up to run a checkpoint now
+        void trigger();
+
+        checkpointer_stats get_stats() const;
+
+    private:
+        // shared with the WAL callbacks of the attached writers
+        struct wakeup
+        {
+            wakeup();
+
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool pending;
+            bool stopping;
+        };
+
+        void run();
+        void run_checkpoint();
+
+    private:
+        database theDb;
+        std::string theWalPath;
+        checkpoint_policy thePolicy;
+        std::shared_ptr<wakeup> theWakeup;
+        checkpointer_stats theStats;                // guarded by the wakeup mutex
+        checkpoint_result theLastResult;
+        sqlite3_int64 theLastWalSequence;
+        std::vector<std::pair<database*, int> > theWriters;    // attached writers with their automatic checkpoint frames
+        std::thread theThread;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
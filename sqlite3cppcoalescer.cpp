@@ -0,0 +1,232 @@
+// sqlite3cppcoalescer.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cppcoalescer.h"
+
+#include <chrono>
+#include <algorithm>
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    namespace
+    {
+        class sql_write
+        {
+        public:
+            sql_write(const string& anSql, const async_params& aParams) : theSql(anSql), theParams(aParams) {}
+            void operator()(database& db) const
+            {
+                command cmd(db, theSql);
+                bind_params(cmd, theParams);
+                cmd.execute();
+            }
+        private:
+            string theSql;
+            async_params theParams;
+        };
+    }
+
+    write_result::write_result()
+        : changes(0), last_insert_rowid(0)
+    {}
+
+    write_coalescer_stats::write_coalescer_stats()
+        : writes(0), failed(0), commits(0), busy_retries(0), max_batch(0), depth(0)
+    {}
+
+    write_coalescer::write_coalescer(const string& aDbPath, const string& aDbCreateSql,
+                                     const string& anExtensionPath, const open_options& anOptions,
+                                     size_t aMaxBatch, int aMaxBusyRetries)
+        : theDb(aDbPath, aDbCreateSql, anExtensionPath, anOptions)
+        , theMaxBatch(aMaxBatch)
+        , theMaxBusyRetries(aMaxBusyRetries)
+        , theStopping(false)
+    {
+        theWriter = std::thread(&write_coalescer::run, this);
+    }
+
+    write_coalescer::~write_coalescer()
+    {
+        {
+            std::lock_guard<std::mutex> myLock(theMutex);
+            theStopping = true;
+        }
+        theReady.notify_one();
+        theWriter.join();
+    }
+
+    std::future<write_result> write_coalescer::submit(const string& anSql, const async_params& aParams)
+    {
+        return enqueue(sql_write(anSql, aParams));
+    }
+
+    std::future<write_result> write_coalescer::submit(const write_op& anOp)
+    {
+        return enqueue(anOp);
+    }
+
+    write_coalescer_stats write_coalescer::get_stats() const
+    {
+        std::lock_guard<std::mutex> myLock(theMutex);
+        write_coalescer_stats myStats = theStats;
+        myStats.depth = thePending.size();
+        return myStats;
+    }
+
+    std::future<write_result> write_coalescer::enqueue(const write_op& anOp)
+    {
+        pending_write myWrite;
+        myWrite.op = anOp;
+        myWrite.promise = std::make_shared<std::promise<write_result> >();
+        std::future<write_result> myFuture = myWrite.promise->get_future();
+        {
+            std::lock_guard<std::mutex> myLock(theMutex);
+            if (theStopping)
+                throw database_error("Cannot submit a write to the stopped write coalescer");
+            thePending.push_back(myWrite);
+        }
+        theReady.notify_one();
+        return myFuture;
+    }
+
+    void write_coalescer::run()
+    {
+        for (;;)
+        {
+            pending_writes myWrites;
+            {
+                std::unique_lock<std::mutex> myLock(theMutex);
+                while (thePending.empty() && !theStopping)
+                    theReady.wait(myLock);
+                if (thePending.empty())
+                    return;
+                if (theMaxBatch == 0 || thePending.size() <= theMaxBatch)
+                {
+                    myWrites.swap(thePending);
+                }
+                else
+                {
+                    myWrites.assign(thePending.begin(), thePending.begin() + theMaxBatch);
+                    thePending.erase(thePending.begin(), thePending.begin() + theMaxBatch);
+                }
+            }
+            execute_batch(myWrites);
+        }
+    }
+
+    void write_coalescer::execute_batch(pending_writes& aWrites)
+    {
+        std::vector<write_result> myResults(aWrites.size());
+        std::vector<std::exception_ptr> myErrors(aWrites.size());
+        size_t myFailed = 0;
+        bool myCommitted = false;
+
+        try
+        {
+            execute_with_retry("BEGIN IMMEDIATE");
+            try
+            {
+                command mySavepoint(theDb, "SAVEPOINT coalesced_write");
+                command myRelease(theDb, "RELEASE coalesced_write");
+                command myRollback(theDb, "ROLLBACK TO coalesced_write");
+
+                for (size_t i = 0; i < aWrites.size(); ++i)
+                {
+                    mySavepoint.execute();
+                    mySavepoint.reset();
+                    try
+                    {
+                        aWrites[i].op(theDb);
+                        myResults[i].changes = theDb.changes();
+                        myResults[i].last_insert_rowid = theDb.last_insert_rowid();
+                    }
+                    catch (...)
+                    {
+                        myErrors[i] = std::current_exception();
+                        ++myFailed;
+                        myRollback.execute();
+                        myRollback.reset();
+                    }
+                    myRelease.execute();
+                    myRelease.reset();
+                }
+                execute_with_retry("COMMIT");
+                myCommitted = true;
+            }
+            catch (...)
+            {
+                try { theDb.execute("ROLLBACK"); }
+                catch (...) {}
+                throw;
+            }
+        }
+        catch (...)
+        {
+            // the whole transaction failed, so did all writes
+            std::fill(myErrors.begin(), myErrors.end(), std::current_exception());
+            myFailed = aWrites.size();
+        }
+
+        {
+            std::lock_guard<std::mutex> myLock(theMutex);
+            theStats.writes += aWrites.size() - myFailed;
+            theStats.failed += myFailed;
+            if (myCommitted)
+            {
+                ++theStats.commits;
+                if (aWrites.size() > theStats.max_batch)
+                    theStats.max_batch = aWrites.size();
+            }
+        }
+
+        for (size_t i = 0; i < aWrites.size(); ++i)
+        {
+            if (myErrors[i])
+                aWrites[i].promise->set_exception(myErrors[i]);
+            else
+                aWrites[i].promise->set_value(myResults[i]);
+        }
+    }
+
+    void write_coalescer::execute_with_retry(const string& anSql)
+    {
+        for (int myRetry = 0; ; ++myRetry)
+        {
+            const int rc = theDb.try_execute(anSql);
+            if (rc == SQLITE_OK)
+                return;
+            if ((rc & 0xff) != SQLITE_BUSY || myRetry >= theMaxBusyRetries)
+                throw database_error(theDb, "Failed to execute", anSql);
+            {
+                std::lock_guard<std::mutex> myLock(theMutex);
+                ++theStats.busy_retries;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1 << std::min(myRetry, 10)));
+        }
+    }
+
+} // namespace sqlite3cpp
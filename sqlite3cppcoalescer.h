@@ -0,0 +1,117 @@
+// sqlite3cppcoalescer.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPCOALESCER_H
+#define SQLITE3CPPCOALESCER_H
+
+#include "sqlite3cpp.h"
+#include "sqlite3cppasync.h"
+
+#include <deque>
+#include <memory>
+#include <future>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace sqlite3cpp
+{
+    struct write_result
+    {
+        write_result();
+
+        int changes;
+        sqlite3_int64 last_insert_rowid;
+    };
+
+    struct write_coalescer_stats
+    {
+        write_coalescer_stats();
+
+        sqlite3_int64 writes;       // writes committed
+        sqlite3_int64 failed;       // writes failed, including writes of failed transactions
+        sqlite3_int64 commits;      // transactions committed
+        sqlite3_int64 busy_retries; // BEGIN/COMMIT retried on SQLITE_BUSY
+        size_t max_batch;           // the largest number of writes committed in one transaction
+        size_t depth;               // writes waiting to be executed
+    };
+
+    //
+    // Group commit of writes submitted by many threads.
+    // A single writer thread with its own connection drains all queued writes into one
+    // BEGIN IMMEDIATE ... COMMIT transaction, so that many small writes share one fsync.
+    // Every write runs in its own savepoint, a failed write is rolled back without affecting the others.
+    // The future of each write is fulfilled only after its transaction is committed.
+    // BEGIN and COMMIT are retried on SQLITE_BUSY with exponential backoff.
+    //
+    class write_coalescer : boost::noncopyable
+    {
+    public:
+        typedef std::function<void(database&)> write_op;
+
+        static const size_t DefaultMaxBatch = 1000;
+        static const int DefaultMaxBusyRetries = 10;
+
+        write_coalescer(const std::string& aDbPath, const std::string& aDbCreateSql,
+                        const std::string& anExtensionPath = "", const open_options& anOptions = open_options(),
+                        size_t aMaxBatch = DefaultMaxBatch, int aMaxBusyRetries = DefaultMaxBusyRetries);
+        // executes all writes submitted so far
+        ~write_coalescer();
+
+        std::future<write_result> submit(const std::string& anSql, const async_params& aParams = async_params());
+        // anOp is executed on the writer thread with the writer connection
+        std::future<write_result> submit(const write_op& anOp);
+
+        write_coalescer_stats get_stats() const;
+
+    private:
+        struct pending_write
+        {
+            write_op op;
+            std::shared_ptr<std::promise<write_result> > promise;
+        };
+        typedef std::deque<pending_write> pending_writes;
+
+        std::future<write_result> enqueue(const write_op& anOp);
+        void run();
+        void execute_batch(pending_writes& aWrites);
+        void execute_with_retry(const std::string& anSql);
+
+    private:
+        database theDb;
+        size_t theMaxBatch;
+        int theMaxBusyRetries;
+        mutable std::mutex theMutex;
+        std::condition_variable theReady;
+        pending_writes thePending;
+        bool theStopping;
+        write_coalescer_stats theStats;
+        std::thread theWriter;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
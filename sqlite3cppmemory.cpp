@@ -0,0 +1,359 @@
+// sqlite3cppmemory.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#include "sqlite3cppmemory.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+namespace sqlite3cpp
+{
+    namespace
+    {
+        // 16 bytes, then four size classes per power of two up to 64 KiB
+        const int MinClassSize = 16;
+        const int MaxClassSize = 64 * 1024;
+        const int SizeClasses = 49;
+        const int LargeBlock = -1;
+        // bytes of free blocks a thread caches per size class before moving half of them to the shared list
+        const size_t ThreadCacheBytes = 128 * 1024;
+
+        // in front of every block, keeps the payload 16-byte aligned
+        struct block_header
+        {
+            sqlite3_int64 size;     // payload size
+            int size_class;         // LargeBlock for blocks allocated with malloc directly
+        };
+        const size_t HeaderSize = 16;
+        static_assert(sizeof(block_header) <= HeaderSize, "block header does not fit");
+
+        // free blocks are linked through their payload
+        struct free_block
+        {
+            free_block* next;
+        };
+
+        struct shared_list
+        {
+            shared_list() : head(NULL) {}
+
+            std::mutex mutex;
+            free_block* head;
+        };
+
+        // Trivially destructible, so that blocks can still be freed after the cache is flushed at thread exit,
+        // e.g. by thread_local or static destructors. Zero-initialized.
+        struct thread_cache
+        {
+            free_block* heads[SizeClasses];
+            size_t counts[SizeClasses];
+            bool active;    // the flusher is registered
+            bool flushed;   // the thread is exiting, blocks go to the shared lists directly
+        };
+
+        shared_list theSharedLists[SizeClasses];
+        std::atomic<sqlite3_int64> theSystemAllocations(0);
+        std::atomic<sqlite3_int64> thePooledBytes(0);
+        std::atomic<sqlite3_int64> theTransfers(0);
+        thread_local thread_cache theThreadCache;
+
+        void flushThreadCache();
+
+        struct thread_cache_flusher
+        {
+            ~thread_cache_flusher() { flushThreadCache(); }
+        };
+        thread_local thread_cache_flusher theThreadCacheFlusher;
+
+        int sizeClassOf(int aSize)
+        {
+            if (aSize <= MinClassSize)
+                return 0;
+            if (aSize > MaxClassSize)
+                return LargeBlock;
+            const unsigned int myValue = aSize - 1;
+            const int myBit = 31 - __builtin_clz(myValue);
+            return (myBit - 4) * 4 + ((myValue >> (myBit - 2)) & 3) + 1;
+        }
+
+        int classSize(int aClass)
+        {
+            if (aClass == 0)
+                return MinClassSize;
+            const int myBit = (aClass - 1) / 4 + 4;
+            return (4 + (aClass - 1) % 4 + 1) << (myBit - 2);
+        }
+
+        size_t cacheBlocks(int aClass)
+        {
+            return std::max<size_t>(2, ThreadCacheBytes / classSize(aClass));
+        }
+
+        thread_cache* getThreadCache()
+        {
+            thread_cache& myCache = theThreadCache;
+            if (myCache.flushed)
+                return NULL;
+            if (!myCache.active)
+            {
+                myCache.active = true;
+                // the first use constructs the flusher and registers its destructor for the thread exit
+                (void)&theThreadCacheFlusher;
+            }
+            return &myCache;
+        }
+
+        void pushShared(int aClass, free_block* aFirst, free_block* aLast)
+        {
+            shared_list& myShared = theSharedLists[aClass];
+            std::lock_guard<std::mutex> myLock(myShared.mutex);
+            aLast->next = myShared.head;
+            myShared.head = aFirst;
+        }
+
+        // move aBlocks blocks from the thread cache to the shared list
+        void moveToShared(thread_cache& aCache, int aClass, size_t aBlocks)
+        {
+            free_block* myFirst = aCache.heads[aClass];
+            free_block* myLast = myFirst;
+            for (size_t i = 1; i < aBlocks; ++i)
+                myLast = myLast->next;
+            aCache.heads[aClass] = myLast->next;
+            aCache.counts[aClass] -= aBlocks;
+            pushShared(aClass, myFirst, myLast);
+            ++theTransfers;
+        }
+
+        // move up to aBlocks blocks from the shared list to the thread cache, return false if there are none
+        bool refillFromShared(thread_cache& aCache, int aClass, size_t aBlocks)
+        {
+            shared_list& myShared = theSharedLists[aClass];
+            std::lock_guard<std::mutex> myLock(myShared.mutex);
+            if (!myShared.head)
+                return false;
+            free_block* myFirst = myShared.head;
+            free_block* myLast = myFirst;
+            size_t myCount = 1;
+            for (; myCount < aBlocks && myLast->next; ++myCount)
+                myLast = myLast->next;
+            myShared.head = myLast->next;
+            myLast->next = aCache.heads[aClass];
+            aCache.heads[aClass] = myFirst;
+            aCache.counts[aClass] += myCount;
+            ++theTransfers;
+            return true;
+        }
+
+        void flushThreadCache()
+        {
+            thread_cache& myCache = theThreadCache;
+            for (int i = 0; i < SizeClasses; ++i)
+            {
+                if (myCache.counts[i] > 0)
+                    moveToShared(myCache, i, myCache.counts[i]);
+            }
+            myCache.flushed = true;
+        }
+
+        void* toPayload(block_header* aHeader)
+        {
+            return reinterpret_cast<char*>(aHeader) + HeaderSize;
+        }
+
+        block_header* toHeader(void* aPayload)
+        {
+            return reinterpret_cast<block_header*>(static_cast<char*>(aPayload) - HeaderSize);
+        }
+
+        void* allocateBlock(sqlite3_int64 aSize, int aClass)
+        {
+            block_header* myHeader = static_cast<block_header*>(malloc(HeaderSize + aSize));
+            if (!myHeader)
+                return NULL;
+            myHeader->size = aSize;
+            myHeader->size_class = aClass;
+            return toPayload(myHeader);
+        }
+
+        void* poolMalloc(int aSize)
+        {
+            const int myClass = sizeClassOf(aSize);
+            if (myClass == LargeBlock)
+                return allocateBlock(aSize, LargeBlock);
+
+            thread_cache* myCache = getThreadCache();
+            if (myCache && (myCache->heads[myClass] || refillFromShared(*myCache, myClass, cacheBlocks(myClass) / 2)))
+            {
+                free_block* myBlock = myCache->heads[myClass];
+                myCache->heads[myClass] = myBlock->next;
+                --myCache->counts[myClass];
+                return myBlock;
+            }
+
+            const int mySize = classSize(myClass);
+            void* myBlock = allocateBlock(mySize, myClass);
+            if (myBlock)
+            {
+                ++theSystemAllocations;
+                thePooledBytes += mySize;
+            }
+            return myBlock;
+        }
+
+        void poolFree(void* aBlock)
+        {
+            if (!aBlock)
+                return;
+            block_header* myHeader = toHeader(aBlock);
+            const int myClass = myHeader->size_class;
+            if (myClass == LargeBlock)
+            {
+                free(myHeader);
+                return;
+            }
+
+            free_block* myBlock = static_cast<free_block*>(aBlock);
+            thread_cache* myCache = getThreadCache();
+            if (!myCache)
+            {
+                pushShared(myClass, myBlock, myBlock);
+                return;
+            }
+            myBlock->next = myCache->heads[myClass];
+            myCache->heads[myClass] = myBlock;
+            const size_t myMaxBlocks = cacheBlocks(myClass);
+            if (++myCache->counts[myClass] > myMaxBlocks)
+                moveToShared(*myCache, myClass, myMaxBlocks / 2);
+        }
+
+        void* poolRealloc(void* aBlock, int aSize)
+        {
+            block_header* myHeader = toHeader(aBlock);
+            const int myClass = sizeClassOf(aSize);
+            if (myClass == LargeBlock && myHeader->size_class == LargeBlock)
+            {
+                block_header* myNewHeader = static_cast<block_header*>(realloc(myHeader, HeaderSize + aSize));
+                if (!myNewHeader)
+                    return NULL;
+                myNewHeader->size = aSize;
+                return toPayload(myNewHeader);
+            }
+            if (myClass == myHeader->size_class)
+                return aBlock;
+
+            void* myNewBlock = poolMalloc(aSize);
+            if (!myNewBlock)
+                return NULL;
+            memcpy(myNewBlock, aBlock, std::min<sqlite3_int64>(myHeader->size, aSize));
+            poolFree(aBlock);
+            return myNewBlock;
+        }
+
+        int poolSize(void* aBlock)
+        {
+            return static_cast<int>(toHeader(aBlock)->size);
+        }
+
+        int poolRoundup(int aSize)
+        {
+            const int myClass = sizeClassOf(aSize);
+            return (myClass == LargeBlock) ? (aSize + 7) & ~7 : classSize(myClass);
+        }
+
+        int poolInit(void*)
+        {
+            return SQLITE_OK;
+        }
+
+        void poolShutdown(void*)
+        {}
+
+        const sqlite3_mem_methods PoolAllocator = { poolMalloc, poolFree, poolRealloc, poolSize, poolRoundup, poolInit, poolShutdown, NULL };
+    }
+
+    memory_config::memory_config()
+        : allocator(NULL), memory_status(true)
+    {}
+
+    memory_status::memory_status()
+        : memory_used(0), memory_highwater(0), malloc_count(0), malloc_count_highwater(0), largest_malloc(0)
+        , pagecache_overflow(0), pagecache_overflow_highwater(0)
+    {}
+
+    pool_allocator_stats::pool_allocator_stats()
+        : system_allocations(0), pooled_bytes(0), transfers(0)
+    {}
+
+    void configure_memory(const memory_config& aConfig)
+    {
+        // sqlite3_config() is refused once SQLite is initialized, which opening the first Db does
+        if (aConfig.allocator && sqlite3_config(SQLITE_CONFIG_MALLOC, aConfig.allocator) != SQLITE_OK)
+            throw database_error("Failed to configure SQLite allocator, memory shall be configured before any Db is opened");
+        if (sqlite3_config(SQLITE_CONFIG_MEMSTATUS, aConfig.memory_status ? 1 : 0) != SQLITE_OK)
+            throw database_error("Failed to configure SQLite memory status, memory shall be configured before any Db is opened");
+        if (aConfig.lookaside_slot_size || aConfig.lookaside_slots)
+        {
+            int mySlotSize = open_options::DefaultLookasideSlotSize;
+            int mySlots = open_options::DefaultLookasideSlots;
+            if (aConfig.lookaside_slot_size)
+                mySlotSize = *aConfig.lookaside_slot_size;
+            if (aConfig.lookaside_slots)
+                mySlots = *aConfig.lookaside_slots;
+            if (sqlite3_config(SQLITE_CONFIG_LOOKASIDE, mySlotSize, mySlots) != SQLITE_OK)
+                throw database_error("Failed to configure SQLite lookaside, memory shall be configured before any Db is opened");
+        }
+    }
+
+    memory_status get_memory_status(bool aResetHighwater)
+    {
+        memory_status myStatus;
+        sqlite3_int64 myCurrent = 0;
+        const int myReset = aResetHighwater ? 1 : 0;
+        sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &myStatus.memory_used, &myStatus.memory_highwater, myReset);
+        sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &myStatus.malloc_count, &myStatus.malloc_count_highwater, myReset);
+        sqlite3_status64(SQLITE_STATUS_MALLOC_SIZE, &myCurrent, &myStatus.largest_malloc, myReset);
+        sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &myStatus.pagecache_overflow, &myStatus.pagecache_overflow_highwater, myReset);
+        return myStatus;
+    }
+
+    const sqlite3_mem_methods& pool_allocator()
+    {
+        return PoolAllocator;
+    }
+
+    pool_allocator_stats get_pool_allocator_stats()
+    {
+        pool_allocator_stats myStats;
+        myStats.system_allocations = theSystemAllocations;
+        myStats.pooled_bytes = thePooledBytes;
+        myStats.transfers = theTransfers;
+        return myStats;
+    }
+
+} // namespace sqlite3cpp
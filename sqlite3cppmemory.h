@@ -0,0 +1,94 @@
+// sqlite3cppmemory.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#ifndef SQLITE3CPPMEMORY_H
+#define SQLITE3CPPMEMORY_H
+
+#include "sqlite3cpp.h"
+
+namespace sqlite3cpp
+{
+    //
+    // Process-wide memory configuration of SQLite, see configure_memory()
+    //
+    struct memory_config
+    {
+        memory_config();
+
+        // Allocator of all memory used by SQLite, NULL keeps the default one.
+        // pool_allocator() is a built-in allocator caching freed blocks per thread.
+        const sqlite3_mem_methods* allocator;
+        // Collect the statistics reported by get_memory_status(). SQLite serializes all its allocations on a global mutex
+        // to collect them, so turn them off to remove that contention between threads once the memory is sized.
+        bool memory_status;
+        // Default lookaside of the connections, overridden per connection by open_options
+        boost::optional<int> lookaside_slot_size;
+        boost::optional<int> lookaside_slots;
+    };
+
+    // Apply the configuration to SQLite. Shall be called before any Db is opened, throw database_error otherwise.
+    void configure_memory(const memory_config& aConfig);
+
+    // Memory used by SQLite in the whole process as reported by sqlite3_status64(), all zeroes when memory status is off
+    struct memory_status
+    {
+        memory_status();
+
+        sqlite3_int64 memory_used;                  // bytes currently allocated
+        sqlite3_int64 memory_highwater;
+        sqlite3_int64 malloc_count;                 // allocations currently outstanding
+        sqlite3_int64 malloc_count_highwater;
+        sqlite3_int64 largest_malloc;               // largest allocation requested
+        sqlite3_int64 pagecache_overflow;           // bytes of page cache allocated from the heap
+        sqlite3_int64 pagecache_overflow_highwater;
+    };
+
+    // aResetHighwater resets the high-water marks to the current values after reading them
+    memory_status get_memory_status(bool aResetHighwater = false);
+
+    //
+    // Built-in allocator for memory_config::allocator.
+    // Blocks of up to 64 KiB are rounded up to size classes spaced a quarter of a power of two apart. Freed blocks
+    // are cached by the freeing thread and reused by its next allocations of the same class without locking;
+    // surplus blocks are moved in batches to shared lists which other threads refill their caches from.
+    // Pooled memory is kept for reuse and never returned to the system. Larger blocks go to malloc directly.
+    //
+    const sqlite3_mem_methods& pool_allocator();
+
+    struct pool_allocator_stats
+    {
+        pool_allocator_stats();
+
+        sqlite3_int64 system_allocations;   // pooled blocks allocated from the system
+        sqlite3_int64 pooled_bytes;         // bytes of these blocks
+        sqlite3_int64 transfers;            // batches of blocks moved between the thread caches and the shared lists
+    };
+
+    pool_allocator_stats get_pool_allocator_stats();
+
+} // namespace sqlite3cpp
+
+#endif
@@ -0,0 +1,167 @@
+// sqlite3cpppool.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cpppool.h"
+#include "boost/format.hpp"
+
+#include <chrono>
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    checkout_stats::checkout_stats()
+        : checkouts(0), waits(0), timeouts(0), wait_sec(0), max_wait_sec(0)
+    {}
+
+    connection_pool_stats::connection_pool_stats()
+        : readers(0), idle_readers(0)
+    {}
+
+
+    //
+    // Connection pool handle
+    //
+
+    connection_pool::handle::handle(connection_pool& aPool, database& db, bool aWriter)
+        : thePool(&aPool), theDb(&db), theWriter(aWriter)
+    {}
+
+    connection_pool::handle::handle(handle&& other)
+        : thePool(other.thePool), theDb(other.theDb), theWriter(other.theWriter)
+    {
+        other.thePool = NULL;
+        other.theDb = NULL;
+    }
+
+    connection_pool::handle::~handle()
+    {
+        if (thePool)
+            thePool->release(theDb, theWriter);
+    }
+
+
+    //
+    // Connection pool
+    //
+
+    connection_pool::connection_pool(const string& aDbPath, const string& aDbCreateSql, size_t aReaders,
+                                     const string& anExtensionPath, const open_options& anOptions)
+        : theWriterIdle(true)
+    {
+        open_options myWriterOptions = anOptions;
+        myWriterOptions.flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+        myWriterOptions.journal_mode = journalWal;
+        theWriter.reset(new database(aDbPath, aDbCreateSql, anExtensionPath, myWriterOptions));
+
+        open_options myReaderOptions = anOptions;
+        myReaderOptions.flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX;
+        myReaderOptions.journal_mode = boost::none;
+        myReaderOptions.page_size = boost::none;
+        for (size_t i = 0; i < aReaders; ++i)
+        {
+            theReaders.push_back(std::unique_ptr<database>(new database(aDbPath, aDbCreateSql, anExtensionPath, myReaderOptions)));
+            theIdleReaders.push_back(theReaders.back().get());
+        }
+        theStats.readers = aReaders;
+    }
+
+    connection_pool::handle connection_pool::acquire_reader(unsigned int aTimeoutMs)
+    {
+        return handle(*this, *acquire(false, aTimeoutMs), false);
+    }
+
+    connection_pool::handle connection_pool::acquire_writer(unsigned int aTimeoutMs)
+    {
+        return handle(*this, *acquire(true, aTimeoutMs), true);
+    }
+
+    connection_pool_stats connection_pool::get_stats() const
+    {
+        std::lock_guard<std::mutex> myLock(theMutex);
+        connection_pool_stats myStats = theStats;
+        myStats.idle_readers = theIdleReaders.size();
+        return myStats;
+    }
+
+    database* connection_pool::acquire(bool aWriter, unsigned int aTimeoutMs)
+    {
+        std::unique_lock<std::mutex> myLock(theMutex);
+        checkout_stats& myStats = aWriter ? theStats.writer : theStats.reader;
+
+        if (aWriter ? !theWriterIdle : theIdleReaders.empty())
+        {
+            if (!aWriter && theReaders.empty())
+                throw database_error("No reader connections in the pool");
+
+            typedef std::chrono::steady_clock clock;
+            const clock::time_point myStart = clock::now();
+            std::condition_variable& myReleased = aWriter ? theWriterReleased : theReaderReleased;
+            ++myStats.waits;
+
+            while (aWriter ? !theWriterIdle : theIdleReaders.empty())
+            {
+                if (aTimeoutMs == WaitForever)
+                {
+                    myReleased.wait(myLock);
+                }
+                else if (myReleased.wait_until(myLock, myStart + std::chrono::milliseconds(aTimeoutMs)) == std::cv_status::timeout
+                         && (aWriter ? !theWriterIdle : theIdleReaders.empty()))
+                {
+                    ++myStats.timeouts;
+                    throw database_error(str(boost::format("Timed out after %u ms waiting for a %s connection") % aTimeoutMs % (aWriter ? "writer" : "reader")));
+                }
+            }
+
+            const double myWait = std::chrono::duration<double>(clock::now() - myStart).count();
+            myStats.wait_sec += myWait;
+            if (myWait > myStats.max_wait_sec)
+                myStats.max_wait_sec = myWait;
+        }
+
+        ++myStats.checkouts;
+        if (aWriter)
+        {
+            theWriterIdle = false;
+            return theWriter.get();
+        }
+        database* myDb = theIdleReaders.back();
+        theIdleReaders.pop_back();
+        return myDb;
+    }
+
+    void connection_pool::release(database* db, bool aWriter)
+    {
+        {
+            std::lock_guard<std::mutex> myLock(theMutex);
+            if (aWriter)
+                theWriterIdle = true;
+            else
+                theIdleReaders.push_back(db);
+        }
+        (aWriter ? theWriterReleased : theReaderReleased).notify_one();
+    }
+
+} // namespace sqlite3cpp
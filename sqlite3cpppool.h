@@ -0,0 +1,118 @@
+// sqlite3cpppool.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPPOOL_H
+#define SQLITE3CPPPOOL_H
+
+#include "sqlite3cpp.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+namespace sqlite3cpp
+{
+    struct checkout_stats
+    {
+        checkout_stats();
+
+        sqlite3_int64 checkouts;
+        sqlite3_int64 waits;    // checkouts which had to wait for a free connection
+        sqlite3_int64 timeouts;
+        double wait_sec;        // total time spent waiting for a free connection
+        double max_wait_sec;
+    };
+
+    struct connection_pool_stats
+    {
+        connection_pool_stats();
+
+        size_t readers;
+        size_t idle_readers;
+        checkout_stats reader;
+        checkout_stats writer;
+    };
+
+    //
+    // Pool of N read-only connections and one writer connection to the same Db.
+    // Readers are opened with SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX and the Db is switched to WAL journal mode
+    // so that readers do not block each other nor the writer.
+    // Each connection keeps its own prepared statement cache.
+    //
+    class connection_pool : boost::noncopyable
+    {
+    public:
+        // RAII handle of the checked out connection, returns the connection to the pool on destruction
+        class handle
+        {
+        public:
+            handle(handle&& other);
+            handle(const handle&) = delete;
+            handle& operator=(const handle&) = delete;
+            ~handle();
+
+            database& operator*() const { return *theDb; }
+            database* operator->() const { return theDb; }
+
+        private:
+            friend class connection_pool;
+            handle(connection_pool& aPool, database& db, bool aWriter);
+
+            connection_pool* thePool;
+            database* theDb;
+            bool theWriter;
+        };
+
+        static const unsigned int WaitForever = 0;
+
+        // open flags and journal mode of anOptions are overridden by the pool
+        connection_pool(const std::string& aDbPath, const std::string& aDbCreateSql, size_t aReaders,
+                        const std::string& anExtensionPath = "", const open_options& anOptions = open_options());
+
+        // Block until a connection is available or aTimeoutMs elapses, throw database_error on timeout
+        handle acquire_reader(unsigned int aTimeoutMs = WaitForever);
+        handle acquire_writer(unsigned int aTimeoutMs = WaitForever);
+
+        connection_pool_stats get_stats() const;
+
+    private:
+        database* acquire(bool aWriter, unsigned int aTimeoutMs);
+        void release(database* db, bool aWriter);
+
+    private:
+        std::unique_ptr<database> theWriter;
+        std::vector<std::unique_ptr<database> > theReaders;
+        std::vector<database*> theIdleReaders;
+        bool theWriterIdle;
+        mutable std::mutex theMutex;
+        std::condition_variable theReaderReleased;
+        std::condition_variable theWriterReleased;
+        connection_pool_stats theStats;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
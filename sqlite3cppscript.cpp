@@ -0,0 +1,219 @@
+// sqlite3cppscript.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#include "sqlite3cppscript.h"
+
+#include <ctype.h>
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    namespace
+    {
+        // offset of the first character after the whitespace and comments starting at anOffset
+        size_t skipSpaceAndComments(const string& anSql, size_t anOffset)
+        {
+            while (anOffset < anSql.size())
+            {
+                if (isspace(static_cast<unsigned char>(anSql[anOffset])))
+                {
+                    ++anOffset;
+                }
+                else if (anSql.compare(anOffset, 2, "--") == 0)
+                {
+                    const size_t myEnd = anSql.find('\n', anOffset);
+                    anOffset = (myEnd == string::npos) ? anSql.size() : myEnd + 1;
+                }
+                else if (anSql.compare(anOffset, 2, "/*") == 0)
+                {
+                    const size_t myEnd = anSql.find("*/", anOffset + 2);
+                    anOffset = (myEnd == string::npos) ? anSql.size() : myEnd + 2;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            return anOffset;
+        }
+    }
+
+    script_statement_result::script_statement_result()
+        : elapsed_sec(0), changes(0), rows(0)
+    {}
+
+    script::script(database& db, const string& anSql)
+        : theDb(&db), theSql(anSql), theParsed(0)
+    {}
+
+    script::script(script&& other)
+        : theDb(other.theDb), theParsed(0)
+    {
+        *this = std::move(other);
+    }
+
+    script& script::operator=(script&& other)
+    {
+        if (this == &other)
+            return *this;
+        finalize();
+        theDb = other.theDb;
+        theSql.swap(other.theSql);
+        std::swap(theParsed, other.theParsed);
+        theStmts.swap(other.theStmts);
+        theResults.swap(other.theResults);
+        return *this;
+    }
+
+    script::~script()
+    {
+        finalize();
+    }
+
+    void script::execute(const script_params& aParams)
+    {
+        theResults.clear();
+        for (size_t i = 0; ; ++i)
+        {
+            if (i == theStmts.size() && !prepare_next())
+                return;
+            run(i, aParams);
+        }
+    }
+
+    size_t script::size() const
+    {
+        return theStmts.size();
+    }
+
+    const std::vector<script_statement_result>& script::get_results() const
+    {
+        return theResults;
+    }
+
+    sqlite3_stmt* script::prepare_next()
+    {
+        // skip them, so that the text SQLite keeps for the statement starts with its first token
+        while ((theParsed = skipSpaceAndComments(theSql, theParsed)) < theSql.size())
+        {
+            char const* myStart = theSql.c_str() + theParsed;
+            char const* myTail = NULL;
+            sqlite3_stmt* myStmt = NULL;
+            if (sqlite3_prepare_v3(theDb->theDb, myStart, static_cast<int>(theSql.size() - theParsed), SQLITE_PREPARE_PERSISTENT, &myStmt, &myTail) != SQLITE_OK)
+                throw database_error(*theDb, "Failed to prepare", string(myStart, theSql.size() - theParsed));
+            theParsed = myTail ? myTail - theSql.c_str() : theSql.size();
+            // comments and whitespace compile to no statement
+            if (myStmt)
+            {
+                theStmts.push_back(myStmt);
+                return myStmt;
+            }
+        }
+        return NULL;
+    }
+
+    void script::run(size_t anIndex, const script_params& aParams)
+    {
+        sqlite3_stmt* myStmt = theStmts[anIndex];
+        script_statement_result myResult;
+        myResult.sql = sqlite3_sql(myStmt);
+
+        const int myParamCount = sqlite3_bind_parameter_count(myStmt);
+        for (int i = 1; i <= myParamCount; ++i)
+        {
+            char const* myName = sqlite3_bind_parameter_name(myStmt, i);
+            if (!myName)
+                continue;
+            for (size_t j = 0; j < aParams.size(); ++j)
+            {
+                if (aParams[j].first == myName)
+                {
+                    if (detail::bind_param(myStmt, i, aParams[j].second) != SQLITE_OK)
+                    {
+                        const database_error myError(*theDb, "Failed to bind", myResult.sql.to_string(), i);
+                        sqlite3_clear_bindings(myStmt);
+                        throw myError;
+                    }
+                    break;
+                }
+            }
+        }
+
+        int rc;
+        if (theDb->theProfiler)
+        {
+            // profiled like the statements of the Db, so the script shows up in its profile
+            statement_execution myExecution;
+            theDb->begin_execution(myStmt, myExecution);
+            while ((rc = theDb->profiled_step(myStmt, myExecution)) == SQLITE_ROW)
+                ++myResult.rows;
+            myExecution.sql = myResult.sql.to_string();
+            theDb->end_execution(myStmt, myExecution);
+            myResult.elapsed_sec = myExecution.elapsed_sec;
+        }
+        else
+        {
+            const double myStart = detail::now();
+            while ((rc = sqlite3_step(myStmt)) == SQLITE_ROW)
+                ++myResult.rows;
+            if (rc != SQLITE_DONE && myResult.rows == 0)
+            {
+                rc = theDb->retry_step(myStmt, rc);
+                while (rc == SQLITE_ROW)
+                {
+                    ++myResult.rows;
+                    rc = sqlite3_step(myStmt);
+                }
+            }
+            myResult.elapsed_sec = detail::now() - myStart;
+        }
+        if (rc == SQLITE_DONE && !sqlite3_stmt_readonly(myStmt))
+            myResult.changes = sqlite3_changes(theDb->theDb);
+
+        if (rc != SQLITE_DONE)
+        {
+            const database_error myError(*theDb, "Failed to execute", myResult.sql.to_string());
+            sqlite3_reset(myStmt);
+            sqlite3_clear_bindings(myStmt);
+            throw myError;
+        }
+        // the parameters are bound without copying, so do not keep them past the execution
+        sqlite3_reset(myStmt);
+        sqlite3_clear_bindings(myStmt);
+        theResults.push_back(myResult);
+    }
+
+    void script::finalize()
+    {
+        for (size_t i = 0; i < theStmts.size(); ++i)
+            sqlite3_finalize(theStmts[i]);
+        theStmts.clear();
+        theResults.clear();
+        theParsed = 0;
+    }
+
+} // namespace sqlite3cpp
@@ -0,0 +1,100 @@
+// sqlite3cppscript.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+
+#ifndef SQLITE3CPPSCRIPT_H
+#define SQLITE3CPPSCRIPT_H
+
+#include "sqlite3cpp.h"
+
+#include <vector>
+
+namespace sqlite3cpp
+{
+    typedef detail::param_value script_param;
+    // Named parameters of a script, names include the prefix, e.g. ":id"
+    typedef std::vector<std::pair<std::string, script_param> > script_params;
+
+    // Outcome of a statement of the script in the last execution
+    struct script_statement_result
+    {
+        script_statement_result();
+
+        boost::string_view sql;     // SQL text of the statement, owned by SQLite and valid while the script exists
+        double elapsed_sec;
+        int changes;                // rows modified, 0 for statements which do not write
+        size_t rows;                // rows returned and discarded
+    };
+
+    //
+    // SQL script split into statements and compiled once, then executed any number of times.
+    // The statements are prepared one by one with sqlite3_prepare_v3() from the tail of the previous one as the first
+    // execution reaches them, so that they may use the tables created by the statements before. Later executions reuse
+    // the prepared statements, which SQLite recompiles by itself when the schema changes.
+    // Statements run in order, each to completion, and are not wrapped in a transaction: put BEGIN and COMMIT
+    // to the script or execute it within a transaction. An execution stops at the first failed statement.
+    //
+    // Usage:
+    //    script fixture(db, "DELETE FROM contacts; INSERT INTO contacts (name) VALUES (:name); ...");
+    //    script_params params;
+    //    params.push_back(std::make_pair(":name", script_param(std::string("Andrei"))));
+    //    fixture.execute(params);
+    //
+    class script
+    {
+    public:
+        script(database& db, const std::string& anSql);
+        // The prepared statements are transferred, the source is left empty
+        script(script&& other);
+        script& operator=(script&& other);
+        script(const script&) = delete;
+        script& operator=(const script&) = delete;
+        ~script();
+
+        // Named parameters are bound in every statement using them, parameters without a value are bound as NULL
+        void execute(const script_params& aParams = script_params());
+
+        // number of statements prepared so far, all of them once the script has been executed
+        size_t size() const;
+        // results of the statements run by the last execution
+        const std::vector<script_statement_result>& get_results() const;
+
+    private:
+        // prepare the next statement from the remaining text, return NULL when the text is exhausted
+        sqlite3_stmt* prepare_next();
+        void run(size_t anIndex, const script_params& aParams);
+        void finalize();
+
+    private:
+        database* theDb;
+        std::string theSql;
+        size_t theParsed;   // offset of the text not yet prepared
+        std::vector<sqlite3_stmt*> theStmts;
+        std::vector<script_statement_result> theResults;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
@@ -0,0 +1,834 @@
+// sqlite3cpptransfer.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cpptransfer.h"
+#include "boost/format.hpp"
+#include "boost/scoped_ptr.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using std::string;
+using std::vector;
+
+namespace sqlite3cpp
+{
+    namespace
+    {
+        const char ColumnarMagic[8] = { 'S', 'Q', '3', 'C', 'P', 'C', 'O', 'L' };
+        const boost::uint32_t ColumnarVersion = 1;
+
+        // Read-only memory mapping of a whole file
+        class mapped_file : boost::noncopyable
+        {
+        public:
+            explicit mapped_file(const string& aPath)
+                : theData(NULL), theSize(0)
+            {
+                const int fd = ::open(aPath.c_str(), O_RDONLY);
+                if (fd < 0)
+                    throw database_error(str(boost::format("Failed to open %s. %s") % aPath % strerror(errno)));
+                struct stat st;
+                if (fstat(fd, &st) != 0)
+                {
+                    const int myErrno = errno;
+                    ::close(fd);
+                    throw database_error(str(boost::format("Failed to stat %s. %s") % aPath % strerror(myErrno)));
+                }
+                theSize = st.st_size;
+                if (theSize > 0)
+                {
+                    void* myData = mmap(NULL, theSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (myData == MAP_FAILED)
+                    {
+                        const int myErrno = errno;
+                        ::close(fd);
+                        throw database_error(str(boost::format("Failed to map %s. %s") % aPath % strerror(myErrno)));
+                    }
+                    posix_madvise(myData, theSize, POSIX_MADV_SEQUENTIAL);
+                    theData = static_cast<char const*>(myData);
+                }
+                ::close(fd);
+            }
+
+            ~mapped_file()
+            {
+                if (theData)
+                    munmap(const_cast<char*>(theData), theSize);
+            }
+
+            char const* data() const { return theData; }
+            size_t size() const { return theSize; }
+
+        private:
+            char const* theData;
+            size_t theSize;
+        };
+
+        struct byte_range
+        {
+            byte_range(size_t aBegin, size_t anEnd) : begin(aBegin), end(anEnd) {}
+
+            size_t begin;
+            size_t end;
+        };
+
+        enum FieldType
+        {
+            fieldNull, fieldInteger, fieldReal, fieldText, fieldBlob
+        };
+
+        struct field
+        {
+            FieldType type;
+            sqlite3_int64 integer;  // for CSV text unescaped into the arena holds its arena offset until the chunk is parsed
+            double real;
+            char const* data;       // text and BLOB values point into the mapped file or into the chunk arena
+            size_t size;
+        };
+
+        // Rows parsed by a worker, stored row-major
+        struct parsed_chunk
+        {
+            parsed_chunk() : rows(0) {}
+
+            vector<field> fields;
+            string arena;
+            size_t rows;
+            std::exception_ptr error;
+        };
+
+        typedef std::function<void(const byte_range& aRange, parsed_chunk& aChunk)> chunk_parser;
+
+        //
+        // Parses chunks on worker threads, which stay at most a few chunks ahead of the consumer taking them in order
+        //
+        class parse_pipeline : boost::noncopyable
+        {
+        public:
+            parse_pipeline(const vector<byte_range>& aChunks, const chunk_parser& aParser, size_t aThreads)
+                : theChunks(aChunks), theParser(aParser), theSlots(aChunks.size())
+                , theWindow(2 * aThreads), theNext(0), theConsumed(0), theStopping(false)
+            {
+                for (size_t i = 0; i < std::min(aThreads, aChunks.size()); ++i)
+                    theThreads.push_back(std::thread(&parse_pipeline::run, this));
+            }
+
+            ~parse_pipeline()
+            {
+                {
+                    std::lock_guard<std::mutex> myLock(theMutex);
+                    theStopping = true;
+                }
+                theWorkerCond.notify_all();
+                for (size_t i = 0; i < theThreads.size(); ++i)
+                    theThreads[i].join();
+            }
+
+            // wait for the next chunk in file order, rethrow the error it failed to be parsed with
+            std::unique_ptr<parsed_chunk> next()
+            {
+                std::unique_lock<std::mutex> myLock(theMutex);
+                const size_t myIdx = theConsumed;
+                theReadyCond.wait(myLock, [this, myIdx]() { return theSlots[myIdx] != NULL; });
+                std::unique_ptr<parsed_chunk> myChunk(std::move(theSlots[myIdx]));
+                ++theConsumed;
+                myLock.unlock();
+                theWorkerCond.notify_all();
+
+                if (myChunk->error)
+                    std::rethrow_exception(myChunk->error);
+                return myChunk;
+            }
+
+        private:
+            void run()
+            {
+                for (;;)
+                {
+                    size_t myIdx;
+                    {
+                        std::unique_lock<std::mutex> myLock(theMutex);
+                        theWorkerCond.wait(myLock, [this]() { return theStopping || theNext >= theChunks.size() || theNext < theConsumed + theWindow; });
+                        if (theStopping || theNext >= theChunks.size())
+                            return;
+                        myIdx = theNext++;
+                    }
+
+                    std::unique_ptr<parsed_chunk> myChunk(new parsed_chunk());
+                    try
+                    {
+                        theParser(theChunks[myIdx], *myChunk);
+                    }
+                    catch (...)
+                    {
+                        myChunk->error = std::current_exception();
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> myLock(theMutex);
+                        theSlots[myIdx] = std::move(myChunk);
+                    }
+                    theReadyCond.notify_all();
+                }
+            }
+
+        private:
+            const vector<byte_range>& theChunks;
+            chunk_parser theParser;
+            vector<std::unique_ptr<parsed_chunk> > theSlots;
+            const size_t theWindow;
+            size_t theNext;         // next chunk to be parsed
+            size_t theConsumed;     // chunks taken by the consumer
+            bool theStopping;
+            std::mutex theMutex;
+            std::condition_variable theWorkerCond;
+            std::condition_variable theReadyCond;
+            vector<std::thread> theThreads;
+        };
+
+
+        //
+        // CSV
+        //
+
+        void appendInteger(string& anOut, sqlite3_int64 aValue)
+        {
+            char myBuf[24];
+            char* myEnd = myBuf + sizeof(myBuf);
+            char* p = myEnd;
+            boost::uint64_t myValue = (aValue < 0) ? 0 - static_cast<boost::uint64_t>(aValue) : aValue;
+            do
+            {
+                *--p = static_cast<char>('0' + myValue % 10);
+                myValue /= 10;
+            }
+            while (myValue);
+            if (aValue < 0)
+                *--p = '-';
+            anOut.append(p, myEnd - p);
+        }
+
+        void appendReal(string& anOut, double aValue)
+        {
+            char myBuf[32];
+            const int myLen = snprintf(myBuf, sizeof(myBuf), "%.17g", aValue);
+            anOut.append(myBuf, myLen);
+        }
+
+        void appendCsvText(string& anOut, boost::string_view aValue)
+        {
+            // empty text is quoted to tell it from NULL
+            if (!aValue.empty() && aValue.find_first_of(",\"\r\n") == boost::string_view::npos)
+            {
+                anOut.append(aValue.data(), aValue.size());
+                return;
+            }
+            anOut += '"';
+            for (size_t myQuote; (myQuote = aValue.find('"')) != boost::string_view::npos; aValue.remove_prefix(myQuote + 1))
+                anOut.append(aValue.data(), myQuote + 1) += '"';
+            anOut.append(aValue.data(), aValue.size()) += '"';
+        }
+
+        void appendHex(string& anOut, blob_view aValue)
+        {
+            static const char Digits[] = "0123456789ABCDEF";
+            if (aValue.size == 0)
+            {
+                anOut += "\"\"";
+                return;
+            }
+            unsigned char const* myData = static_cast<unsigned char const*>(aValue.data);
+            for (size_t i = 0; i < aValue.size; ++i)
+            {
+                anOut += Digits[myData[i] >> 4];
+                anOut += Digits[myData[i] & 0xF];
+            }
+        }
+
+        void appendCsvRows(string& anOut, const column_batch& aBatch)
+        {
+            const int myColumns = static_cast<int>(aBatch.columns());
+            for (size_t r = 0; r < aBatch.rows(); ++r)
+            {
+                for (int c = 1; c <= myColumns; ++c)
+                {
+                    if (c > 1)
+                        anOut += ',';
+                    const column_batch::column& myColumn = aBatch.get_column(c);
+                    if ((myColumn.nulls[r / 64] >> (r % 64)) & 1)
+                        continue;
+                    switch (myColumn.type)
+                    {
+                    case columnInteger: appendInteger(anOut, myColumn.integers[r]); break;
+                    case columnReal: appendReal(anOut, myColumn.reals[r]); break;
+                    case columnBlob: appendHex(anOut, aBatch.blob(c, r)); break;
+                    default: appendCsvText(anOut, aBatch.text(c, r)); break;
+                    }
+                }
+                anOut += '\n';
+            }
+        }
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwMalformed(const char* aWhat, size_t anOffset, const string& aPath)
+        {
+            throw database_error(str(boost::format("%s at byte %u of %s") % aWhat % anOffset % aPath));
+        }
+
+        // Cut the CSV body following the header line into chunks of about aChunkSize bytes ending at record boundaries.
+        // A newline ends a record unless it is quoted, which is known from the parity of the quotes preceding it.
+        vector<byte_range> splitCsv(char const* aData, size_t aSize, size_t aChunkSize, size_t aColumns, const string& aPath)
+        {
+            // header line
+            size_t myFields = 1;
+            bool myInQuotes = false;
+            size_t myBegin = 0;
+            for (; myBegin < aSize; ++myBegin)
+            {
+                const char c = aData[myBegin];
+                if (c == '"')
+                    myInQuotes = !myInQuotes;
+                else if (c == ',' && !myInQuotes)
+                    ++myFields;
+                else if (c == '\n' && !myInQuotes)
+                    break;
+            }
+            if (myBegin >= aSize)
+                return vector<byte_range>();
+            if (myFields != aColumns)
+                throw database_error(str(boost::format("CSV file %s has %u columns whereas the statement has %u parameters") % aPath % myFields % aColumns));
+            ++myBegin;
+
+            vector<byte_range> myChunks;
+            size_t myScanned = myBegin;
+            while (myBegin < aSize)
+            {
+                size_t myEnd = std::min(aSize, myBegin + std::max<size_t>(aChunkSize, 1));
+                if (myEnd < aSize)
+                {
+                    myInQuotes = (std::count(aData + myScanned, aData + myEnd, '"') % 2 == 1) != myInQuotes;
+                    for (; myEnd < aSize; ++myEnd)
+                    {
+                        if (aData[myEnd] == '"')
+                            myInQuotes = !myInQuotes;
+                        else if (aData[myEnd] == '\n' && !myInQuotes)
+                            break;
+                    }
+                    myEnd = std::min(aSize, myEnd + 1);
+                    myScanned = myEnd;
+                }
+                myChunks.push_back(byte_range(myBegin, myEnd));
+                myBegin = myEnd;
+            }
+            return myChunks;
+        }
+
+        void parseCsv(char const* aData, const byte_range& aRange, size_t aColumns, const string& aPath, parsed_chunk& aChunk)
+        {
+            char const* p = aData + aRange.begin;
+            char const* const myEnd = aData + aRange.end;
+            vector<size_t> myUnescaped;     // fields stored in the arena
+            aChunk.fields.reserve((aRange.end - aRange.begin) / 8);
+
+            while (p < myEnd)
+            {
+                char const* const myRecord = p;
+                for (size_t myColumn = 1; ; ++myColumn)
+                {
+                    field myField;
+                    myField.type = fieldText;
+                    myField.integer = 0;
+                    myField.real = 0;
+                    if (p < myEnd && *p == '"')
+                    {
+                        char const* const myBegin = ++p;
+                        bool myEscaped = false;
+                        char const* q = static_cast<char const*>(memchr(p, '"', myEnd - p));
+                        while (q && q + 1 < myEnd && q[1] == '"')
+                        {
+                            myEscaped = true;
+                            q = static_cast<char const*>(memchr(q + 2, '"', myEnd - q - 2));
+                        }
+                        if (!q)
+                            throwMalformed("Unterminated quoted CSV field", myBegin - 1 - aData, aPath);
+                        if (myEscaped)
+                        {
+                            myField.integer = aChunk.arena.size();
+                            for (char const* s = myBegin; s < q; ++s)
+                            {
+                                aChunk.arena += *s;
+                                if (*s == '"')
+                                    ++s;
+                            }
+                            myField.data = NULL;
+                            myField.size = aChunk.arena.size() - myField.integer;
+                            myUnescaped.push_back(aChunk.fields.size());
+                        }
+                        else
+                        {
+                            myField.data = myBegin;
+                            myField.size = q - myBegin;
+                        }
+                        p = q + 1;
+                    }
+                    else
+                    {
+                        char const* const myBegin = p;
+                        while (p < myEnd && *p != ',' && *p != '\n' && *p != '\r')
+                            ++p;
+                        myField.data = myBegin;
+                        myField.size = p - myBegin;
+                        if (myField.size == 0)
+                            myField.type = fieldNull;
+                    }
+                    aChunk.fields.push_back(myField);
+
+                    if (p < myEnd && *p == ',')
+                    {
+                        ++p;
+                        continue;
+                    }
+                    if (p < myEnd && *p == '\r')
+                        ++p;
+                    if (p < myEnd && *p != '\n')
+                        throwMalformed("Unexpected character after CSV field", p - aData, aPath);
+                    if (p < myEnd)
+                        ++p;
+                    if (myColumn != aColumns)
+                        throw database_error(str(boost::format("CSV record at byte %u of %s has %u fields whereas %u are expected") % (myRecord - aData) % aPath % myColumn % aColumns));
+                    break;
+                }
+                ++aChunk.rows;
+            }
+
+            for (vector<size_t>::const_iterator it = myUnescaped.begin(); it != myUnescaped.end(); ++it)
+                aChunk.fields[*it].data = aChunk.arena.data() + aChunk.fields[*it].integer;
+        }
+
+
+        //
+        // Columnar
+        //
+
+        template <class T> void appendPod(string& anOut, const T& aValue)
+        {
+            anOut.append(reinterpret_cast<char const*>(&aValue), sizeof(aValue));
+        }
+
+        template <class T> void appendArray(string& anOut, const vector<T>& aValues)
+        {
+            if (!aValues.empty())
+                anOut.append(reinterpret_cast<char const*>(&aValues[0]), aValues.size() * sizeof(T));
+        }
+
+        void appendColumnarHeader(string& anOut, const query& aQuery)
+        {
+            anOut.append(ColumnarMagic, sizeof(ColumnarMagic));
+            appendPod(anOut, ColumnarVersion);
+            appendPod(anOut, static_cast<boost::uint32_t>(aQuery.column_count()));
+            for (int c = 1; c <= aQuery.column_count(); ++c)
+            {
+                const string myName = aQuery.column_name(c);
+                appendPod(anOut, static_cast<boost::uint32_t>(myName.size()));
+                anOut += myName;
+            }
+        }
+
+        // block: size of the rest of the block, rows and per column its type, NULL bitmap and values
+        void appendColumnarBlock(string& anOut, const column_batch& aBatch)
+        {
+            const size_t mySizePos = anOut.size();
+            appendPod(anOut, boost::uint64_t(0));
+            appendPod(anOut, static_cast<boost::uint64_t>(aBatch.rows()));
+            for (int c = 1; c <= static_cast<int>(aBatch.columns()); ++c)
+            {
+                const column_batch::column& myColumn = aBatch.get_column(c);
+                appendPod(anOut, static_cast<boost::uint32_t>(myColumn.type));
+                appendArray(anOut, myColumn.nulls);
+                switch (myColumn.type)
+                {
+                case columnInteger: appendArray(anOut, myColumn.integers); break;
+                case columnReal: appendArray(anOut, myColumn.reals); break;
+                default:
+                    if (sizeof(size_t) == sizeof(boost::uint64_t))
+                        appendArray(anOut, myColumn.offsets);
+                    else
+                        for (size_t r = 0; r < myColumn.offsets.size(); ++r)
+                            appendPod(anOut, static_cast<boost::uint64_t>(myColumn.offsets[r]));
+                    appendArray(anOut, myColumn.heap);
+                    break;
+                }
+            }
+            const boost::uint64_t myBlockSize = anOut.size() - mySizePos - sizeof(boost::uint64_t);
+            memcpy(&anOut[mySizePos], &myBlockSize, sizeof(myBlockSize));
+        }
+
+        [[noreturn]] __attribute__((noinline, cold)) void throwMixedColumn(const string& aColumn, const string& aPath)
+        {
+            throw database_error(str(boost::format("Failed to export %s because column %s mixes storage classes, which the columnar format does not support") % aPath % aColumn));
+        }
+
+        // Bounds-checked sequential reader over the mapped file
+        class columnar_reader
+        {
+        public:
+            columnar_reader(char const* aData, size_t aBegin, size_t anEnd, const string& aPath)
+                : theData(aData), thePos(aBegin), theEnd(anEnd), thePath(aPath)
+            {}
+
+            char const* take(size_t aSize)
+            {
+                if (aSize > theEnd - thePos)
+                    throwMalformed("Truncated columnar data", thePos, thePath);
+                char const* myData = theData + thePos;
+                thePos += aSize;
+                return myData;
+            }
+
+            template <class T> T read()
+            {
+                T myValue;
+                memcpy(&myValue, take(sizeof(T)), sizeof(T));
+                return myValue;
+            }
+
+            size_t pos() const { return thePos; }
+            bool done() const { return thePos >= theEnd; }
+
+        private:
+            char const* theData;
+            size_t thePos;
+            size_t theEnd;
+            const string& thePath;
+        };
+
+        // Skip the header and cut the blocks into chunks of about aChunkSize bytes
+        vector<byte_range> splitColumnar(char const* aData, size_t aSize, size_t aChunkSize, size_t aColumns, const string& aPath)
+        {
+            columnar_reader myReader(aData, 0, aSize, aPath);
+            if (memcmp(myReader.take(sizeof(ColumnarMagic)), ColumnarMagic, sizeof(ColumnarMagic)) != 0)
+                throw database_error(str(boost::format("%s is not a columnar export file") % aPath));
+            const boost::uint32_t myVersion = myReader.read<boost::uint32_t>();
+            if (myVersion != ColumnarVersion)
+                throw database_error(str(boost::format("Columnar export file %s has unsupported version %u") % aPath % myVersion));
+            const boost::uint32_t myColumns = myReader.read<boost::uint32_t>();
+            if (myColumns != aColumns)
+                throw database_error(str(boost::format("Columnar export file %s has %u columns whereas the statement has %u parameters") % aPath % myColumns % aColumns));
+            for (boost::uint32_t c = 0; c < myColumns; ++c)
+                myReader.take(myReader.read<boost::uint32_t>());
+
+            vector<byte_range> myChunks;
+            while (!myReader.done())
+            {
+                const size_t myBegin = myReader.pos();
+                while (!myReader.done() && myReader.pos() - myBegin < aChunkSize)
+                    myReader.take(myReader.read<boost::uint64_t>());
+                myChunks.push_back(byte_range(myBegin, myReader.pos()));
+            }
+            return myChunks;
+        }
+
+        void parseColumnar(char const* aData, const byte_range& aRange, size_t aColumns, const string& aPath, parsed_chunk& aChunk)
+        {
+            columnar_reader myReader(aData, aRange.begin, aRange.end, aPath);
+            while (!myReader.done())
+            {
+                const size_t myBlockSize = myReader.read<boost::uint64_t>();
+                columnar_reader myBlock(aData, myReader.pos(), myReader.pos() + myBlockSize, aPath);
+                myReader.take(myBlockSize);
+
+                const size_t myRows = myBlock.read<boost::uint64_t>();
+                const size_t myFirst = aChunk.fields.size();
+                aChunk.fields.resize(myFirst + myRows * aColumns);
+                for (size_t c = 0; c < aColumns; ++c)
+                {
+                    const boost::uint32_t myType = myBlock.read<boost::uint32_t>();
+                    char const* myNulls = myBlock.take((myRows + 63) / 64 * sizeof(boost::uint64_t));
+                    char const* myValues = NULL;
+                    char const* myHeap = NULL;
+                    size_t myHeapSize = 0;
+                    switch (myType)
+                    {
+                    case columnInteger:
+                    case columnReal:
+                        myValues = myBlock.take(myRows * sizeof(boost::uint64_t));
+                        break;
+                    case columnText:
+                    case columnBlob:
+                        myValues = myBlock.take((myRows + 1) * sizeof(boost::uint64_t));
+                        memcpy(&myHeapSize, myValues + myRows * sizeof(boost::uint64_t), sizeof(boost::uint64_t));
+                        myHeap = myBlock.take(myHeapSize);
+                        break;
+                    default:
+                        throwMalformed("Invalid column type in columnar data", myBlock.pos(), aPath);
+                    }
+
+                    for (size_t r = 0; r < myRows; ++r)
+                    {
+                        field& myField = aChunk.fields[myFirst + r * aColumns + c];
+                        boost::uint64_t myNullWord;
+                        memcpy(&myNullWord, myNulls + r / 64 * sizeof(boost::uint64_t), sizeof(myNullWord));
+                        if ((myNullWord >> (r % 64)) & 1)
+                        {
+                            myField.type = fieldNull;
+                            continue;
+                        }
+                        switch (myType)
+                        {
+                        case columnInteger:
+                            myField.type = fieldInteger;
+                            memcpy(&myField.integer, myValues + r * sizeof(boost::uint64_t), sizeof(myField.integer));
+                            break;
+                        case columnReal:
+                            myField.type = fieldReal;
+                            memcpy(&myField.real, myValues + r * sizeof(boost::uint64_t), sizeof(myField.real));
+                            break;
+                        default:
+                        {
+                            boost::uint64_t myOffsets[2];
+                            memcpy(myOffsets, myValues + r * sizeof(boost::uint64_t), sizeof(myOffsets));
+                            if (myOffsets[0] > myOffsets[1] || myOffsets[1] > myHeapSize)
+                                throwMalformed("Invalid value offset in columnar data", myBlock.pos(), aPath);
+                            myField.type = (myType == columnText) ? fieldText : fieldBlob;
+                            myField.data = myHeap + myOffsets[0];
+                            myField.size = myOffsets[1] - myOffsets[0];
+                            break;
+                        }
+                        }
+                    }
+                }
+                aChunk.rows += myRows;
+            }
+        }
+
+        void bindField(command& aCmd, int idx, const field& aField)
+        {
+            switch (aField.type)
+            {
+            case fieldInteger: aCmd.bind(idx, aField.integer); break;
+            case fieldReal: aCmd.bind(idx, aField.real); break;
+            case fieldText: aCmd.bind(idx, boost::string_view(aField.data, aField.size), bindStatic); break;
+            case fieldBlob: aCmd.bind(idx, blob_view(aField.data, aField.size), bindStatic); break;
+            default: aCmd.bind(idx); break;
+            }
+        }
+
+    } // unnamed ns
+
+
+    //
+    // Transfer stats
+    //
+
+    transfer_stats::transfer_stats()
+        : rows(0), bytes(0), chunks(0), elapsed_sec(0)
+    {}
+
+    double transfer_stats::rows_per_sec() const
+    {
+        return (elapsed_sec > 0) ? rows / elapsed_sec : 0;
+    }
+
+    double transfer_stats::mb_per_sec() const
+    {
+        return (elapsed_sec > 0) ? bytes / (1024.0 * 1024.0) / elapsed_sec : 0;
+    }
+
+
+    //
+    // Table exporter
+    //
+
+    table_exporter::table_exporter(database& db, const string& aSelectSql, size_t aBatchRows)
+        : theQuery(db, aSelectSql), theBatchRows(std::max<size_t>(aBatchRows, 1))
+    {}
+
+    transfer_stats table_exporter::export_to(const string& aPath, TransferFormat aFormat)
+    {
+        const double myStart = detail::now();
+        std::ofstream myFile(aPath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+        if (!myFile)
+            throw database_error(str(boost::format("Failed to create %s") % aPath));
+
+        string myOut;
+        if (aFormat == formatCsv)
+        {
+            for (int c = 1; c <= theQuery.column_count(); ++c)
+            {
+                if (c > 1)
+                    myOut += ',';
+                appendCsvText(myOut, theQuery.column_name(c));
+            }
+            myOut += '\n';
+        }
+        else
+        {
+            appendColumnarHeader(myOut, theQuery);
+        }
+
+        transfer_stats myStats;
+        column_batch myBatch;
+        theQuery.reset();
+        while (theQuery.fetch_batch(myBatch, theBatchRows) > 0)
+        {
+            if (aFormat == formatCsv)
+            {
+                appendCsvRows(myOut, myBatch);
+            }
+            else
+            {
+                // a column of one type cannot tell the storage classes of its values apart
+                for (int c = 1; c <= static_cast<int>(myBatch.columns()); ++c)
+                {
+                    if (myBatch.get_column(c).mixed)
+                    {
+                        myFile.close();
+                        std::remove(aPath.c_str());
+                        throwMixedColumn(theQuery.column_name(c), aPath);
+                    }
+                }
+                appendColumnarBlock(myOut, myBatch);
+            }
+            myFile.write(myOut.data(), myOut.size());
+            myStats.rows += myBatch.rows();
+            myStats.bytes += myOut.size();
+            ++myStats.chunks;
+            myOut.clear();
+        }
+        // header of an empty result
+        myFile.write(myOut.data(), myOut.size());
+        myStats.bytes += myOut.size();
+
+        myFile.close();
+        if (!myFile)
+            throw database_error(str(boost::format("Failed to write %s") % aPath));
+        myStats.elapsed_sec = detail::now() - myStart;
+        return myStats;
+    }
+
+
+    //
+    // Table importer
+    //
+
+    table_importer::table_importer(database& db, const string& anInsertSql, size_t aThreads, size_t aBatchRows)
+        : theDb(db)
+        , theCmd(db, anInsertSql)
+        , theThreads(aThreads ? aThreads : std::max(1u, std::thread::hardware_concurrency()))
+        , theBatchRows(std::max<size_t>(aBatchRows, 1))
+        , theChunkSize(DefaultChunkSize)
+    {}
+
+    void table_importer::set_chunk_size(size_t aBytes)
+    {
+        theChunkSize = std::max<size_t>(aBytes, 1);
+    }
+
+    transfer_stats table_importer::import_from(const string& aPath, TransferFormat aFormat)
+    {
+        const double myStart = detail::now();
+        const size_t myColumns = theCmd.parameter_count();
+        mapped_file myFile(aPath);
+        char const* const myData = myFile.data();
+
+        vector<byte_range> myChunks;
+        chunk_parser myParser;
+        if (aFormat == formatCsv)
+        {
+            myChunks = splitCsv(myData, myFile.size(), theChunkSize, myColumns, aPath);
+            myParser = [myData, myColumns, &aPath](const byte_range& aRange, parsed_chunk& aChunk) { parseCsv(myData, aRange, myColumns, aPath, aChunk); };
+        }
+        else
+        {
+            myChunks = splitColumnar(myData, myFile.size(), theChunkSize, myColumns, aPath);
+            myParser = [myData, myColumns, &aPath](const byte_range& aRange, parsed_chunk& aChunk) { parseColumnar(myData, aRange, myColumns, aPath, aChunk); };
+        }
+
+        transfer_stats myStats;
+        parse_pipeline myPipeline(myChunks, myParser, theThreads);
+        boost::scoped_ptr<transaction> myXct;
+        size_t myBatchRows = 0;
+        try
+        {
+            for (size_t i = 0; i < myChunks.size(); ++i)
+            {
+                const std::unique_ptr<parsed_chunk> myChunk = myPipeline.next();
+                vector<field>::const_iterator myField = myChunk->fields.begin();
+                for (size_t r = 0; r < myChunk->rows; ++r)
+                {
+                    if (!myXct)
+                    {
+                        const bool myCommitOnExit = false;
+                        const bool myReserve = true;
+                        myXct.reset(new transaction(theDb, myCommitOnExit, myReserve));
+                    }
+                    for (size_t c = 1; c <= myColumns; ++c, ++myField)
+                        bindField(theCmd, static_cast<int>(c), *myField);
+                    if (theCmd.try_execute() != SQLITE_OK)
+                        throw database_error(theDb, str(boost::format("Failed to insert row %d of %s") % (myStats.rows + 1) % aPath));
+                    theCmd.reset();
+                    ++myStats.rows;
+
+                    if (++myBatchRows >= theBatchRows)
+                    {
+                        myXct->commit();
+                        myXct.reset();
+                        myBatchRows = 0;
+                    }
+                }
+                ++myStats.chunks;
+            }
+            if (myXct)
+                myXct->commit();
+        }
+        catch (...)
+        {
+            // do not leave the values pointing to the file bound
+            try { theCmd.reset(clearBindingsOn); }
+            catch (...) {}
+            throw;
+        }
+        // values are bound without copying and point to the file about to be unmapped
+        theCmd.reset(clearBindingsOn);
+
+        myStats.bytes = myFile.size();
+        myStats.elapsed_sec = detail::now() - myStart;
+        return myStats;
+    }
+
+} // namespace sqlite3cpp
@@ -0,0 +1,123 @@
+// sqlite3cpptransfer.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPTRANSFER_H
+#define SQLITE3CPPTRANSFER_H
+
+#include "sqlite3cpp.h"
+
+namespace sqlite3cpp
+{
+    //
+    // File formats of table_exporter and table_importer.
+    //
+    // formatCsv: RFC 4180 with a header line of column names. NULL is written as an empty field and empty text
+    // as "", so they survive the round trip. BLOBs are written hex-encoded and are imported back as text,
+    // use formatColumnar to transfer BLOBs.
+    //
+    // formatColumnar: the column_batch layout dumped as is, with values in the native byte order.
+    // A header with the column names is followed by self-contained blocks of rows, each holding per column
+    // its type, NULL bitmap and either the array of numeric values or the text/BLOB offsets and heap.
+    // Values keep their storage class and need no parsing on import. A column mixing storage classes, e.g.
+    // integers and text in a column without type affinity, cannot be written and fails the export,
+    // NULLs mix with any class.
+    //
+    enum TransferFormat
+    {
+        formatCsv, formatColumnar
+    };
+
+    struct transfer_stats
+    {
+        transfer_stats();
+        double rows_per_sec() const;
+        double mb_per_sec() const;
+
+        sqlite3_int64 rows;
+        sqlite3_uint64 bytes;   // file bytes written or read
+        size_t chunks;          // blocks written or chunks parsed
+        double elapsed_sec;
+    };
+
+    //
+    // Streams the result of a query to a file, fetching rows in batches with query::fetch_batch()
+    // and writing every batch with a single write.
+    //
+    // Usage:
+    //    table_exporter exporter(db, "SELECT id, name, phone FROM Contacts");
+    //    exporter.export_to("contacts.csv", formatCsv);
+    //
+    class table_exporter : boost::noncopyable
+    {
+    public:
+        static const size_t DefaultBatchRows = 16 * 1024;
+
+        table_exporter(database& db, const std::string& aSelectSql, size_t aBatchRows = DefaultBatchRows);
+
+        transfer_stats export_to(const std::string& aPath, TransferFormat aFormat);
+
+    private:
+        query theQuery;
+        size_t theBatchRows;
+    };
+
+    //
+    // Loads a file written by table_exporter (or any RFC 4180 CSV with a header line) with the given INSERT statement,
+    // whose parameters receive the file columns in order.
+    // The file is memory-mapped and cut into chunks which are parsed in parallel by aThreads worker threads,
+    // while the calling thread is the single writer binding the parsed rows and committing them in transactions
+    // of aBatchRows rows (BEGIN IMMEDIATE ... COMMIT). Chunks are inserted in file order and the workers stay
+    // at most a few chunks ahead of the writer, so the memory used does not depend on the file size.
+    // On failure the current transaction is rolled back, earlier ones stay committed.
+    //
+    // Usage:
+    //    table_importer importer(db, "INSERT INTO Contacts (id, name, phone) VALUES (?, ?, ?)");
+    //    importer.import_from("contacts.csv", formatCsv);
+    //
+    class table_importer : boost::noncopyable
+    {
+    public:
+        static const size_t DefaultBatchRows = 100000;
+        static const size_t DefaultChunkSize = 4 * 1024 * 1024;
+
+        // aThreads of 0 selects the number of hardware threads
+        table_importer(database& db, const std::string& anInsertSql, size_t aThreads = 0, size_t aBatchRows = DefaultBatchRows);
+
+        transfer_stats import_from(const std::string& aPath, TransferFormat aFormat);
+
+        // approximate number of file bytes parsed by a worker at once
+        void set_chunk_size(size_t aBytes);
+
+    private:
+        database& theDb;
+        command theCmd;
+        size_t theThreads;
+        size_t theBatchRows;
+        size_t theChunkSize;
+    };
+
+} // namespace sqlite3cpp
+
+#endif
@@ -0,0 +1,83 @@
+// sqlite3cpptyped.cpp
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sqlite3cpptyped.h"
+#include "boost/format.hpp"
+
+using std::string;
+
+namespace sqlite3cpp
+{
+    namespace detail
+    {
+        namespace
+        {
+            const char* const ValueKindNames[] = { "integer", "real", "text", "BLOB", "any" };
+
+            bool isCompatible(ValueKind aKind, ColumnAffinity anAffinity)
+            {
+                switch (aKind)
+                {
+                case valueInteger:
+                    return anAffinity == affinityInteger || anAffinity == affinityNumeric || anAffinity == affinityBlob;
+                case valueReal:
+                    return anAffinity != affinityText;
+                case valueText:
+                    return anAffinity == affinityText || anAffinity == affinityBlob;
+                case valueBlob:
+                    return anAffinity == affinityBlob || anAffinity == affinityText;
+                default:
+                    return true;
+                }
+            }
+        }
+
+        void check_statement(sqlite3_stmt* aStmt, int aParamCount, const std::vector<ValueKind>& aColumns)
+        {
+            if (!aStmt)
+                throw database_error("Statement is NULL");
+
+            if (sqlite3_bind_parameter_count(aStmt) != aParamCount)
+                throw database_error(str(boost::format("Query '%s' has %d parameters, %d expected")
+                                         % sqlite3_sql(aStmt) % sqlite3_bind_parameter_count(aStmt) % aParamCount));
+
+            if (sqlite3_column_count(aStmt) != static_cast<int>(aColumns.size()))
+                throw database_error(str(boost::format("Query '%s' has %d columns, %d expected")
+                                         % sqlite3_sql(aStmt) % sqlite3_column_count(aStmt) % aColumns.size()));
+
+            for (size_t i = 0; i < aColumns.size(); ++i)
+            {
+                // declared type is not available for expressions
+                char const* myDeclType = sqlite3_column_decltype(aStmt, i);
+                if (myDeclType && !isCompatible(aColumns[i], get_affinity(myDeclType)))
+                    throw database_error(str(boost::format("Column %d of type '%s' cannot be decoded as %s for query '%s'")
+                                             % (i+1) % myDeclType % ValueKindNames[aColumns[i]]
+                                             % sqlite3_sql(aStmt)));
+            }
+        }
+
+    } // namespace detail
+
+} // namespace sqlite3cpp
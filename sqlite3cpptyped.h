@@ -0,0 +1,271 @@
+// sqlite3cpptyped.h
+//
+// The MIT License
+//
+// Copyright (c) 2012-2016 Andrei Korostelev
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef SQLITE3CPPTYPED_H
+#define SQLITE3CPPTYPED_H
+
+#include "sqlite3cpp.h"
+
+#include <vector>
+#include <type_traits>
+#include <boost/fusion/include/for_each.hpp>
+#include <boost/fusion/include/size.hpp>
+#include <boost/fusion/include/std_tuple.hpp>
+#include <boost/fusion/include/boost_tuple.hpp>
+#include <boost/fusion/include/std_pair.hpp>
+
+namespace sqlite3cpp
+{
+    namespace detail
+    {
+        // Kind of values a C++ type is decoded from, checked against the declared column type
+        enum ValueKind
+        {
+            valueInteger, valueReal, valueText, valueBlob, valueAny
+        };
+
+        // Throw database_error if the statement does not have the expected number of parameters and result columns
+        // or if the declared type of a column does not match the expected kind of values
+        void check_statement(sqlite3_stmt* aStmt, int aParamCount, const std::vector<ValueKind>& aColumns);
+
+        template <class T, class Enable = void> struct column_value;
+
+        template <class T> struct column_value<T, typename std::enable_if<is_sqlite_integer<T>::value>::type>
+        {
+            static const ValueKind kind = valueInteger;
+            static void read(sqlite3_stmt* aStmt, int aCol, T& aValue)
+            {
+                aValue = from_int64<T>(sqlite3_column_int64(aStmt, aCol));
+            }
+        };
+
+        template <> struct column_value<bool>
+        {
+            static const ValueKind kind = valueInteger;
+            static void read(sqlite3_stmt* aStmt, int aCol, bool& aValue)
+            {
+                aValue = (sqlite3_column_int64(aStmt, aCol) != 0);
+            }
+        };
+
+        template <class T> struct column_value<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+        {
+            static const ValueKind kind = valueReal;
+            static void read(sqlite3_stmt* aStmt, int aCol, T& aValue)
+            {
+                aValue = static_cast<T>(sqlite3_column_double(aStmt, aCol));
+            }
+        };
+
+        template <> struct column_value<std::string>
+        {
+            static const ValueKind kind = valueText;
+            static void read(sqlite3_stmt* aStmt, int aCol, std::string& aValue)
+            {
+                char const* myText = reinterpret_cast<char const*>(sqlite3_column_text(aStmt, aCol));
+                if (myText)
+                    aValue.assign(myText, sqlite3_column_bytes(aStmt, aCol));
+                else
+                    aValue.clear();
+            }
+        };
+
+        template <> struct column_value<boost::string_view>
+        {
+            static const ValueKind kind = valueText;
+            static void read(sqlite3_stmt* aStmt, int aCol, boost::string_view& aValue)
+            {
+                char const* myText = reinterpret_cast<char const*>(sqlite3_column_text(aStmt, aCol));
+                aValue = boost::string_view(myText, myText ? sqlite3_column_bytes(aStmt, aCol) : 0);
+            }
+        };
+
+        template <> struct column_value<blob_view>
+        {
+            static const ValueKind kind = valueBlob;
+            static void read(sqlite3_stmt* aStmt, int aCol, blob_view& aValue)
+            {
+                void const* myBlob = sqlite3_column_blob(aStmt, aCol);
+                aValue = blob_view(myBlob, myBlob ? sqlite3_column_bytes(aStmt, aCol) : 0);
+            }
+        };
+
+        template <> struct column_value<null_type>
+        {
+            static const ValueKind kind = valueAny;
+            static void read(sqlite3_stmt*, int, null_type&) {}
+        };
+
+        class column_kinds_collector
+        {
+        public:
+            explicit column_kinds_collector(std::vector<ValueKind>& aKinds) : theKinds(aKinds) {}
+            template <class T> void operator()(const T&) const
+            {
+                const ValueKind myKind = column_value<T>::kind;
+                theKinds.push_back(myKind);
+            }
+        private:
+            std::vector<ValueKind>& theKinds;
+        };
+
+        class column_reader
+        {
+        public:
+            explicit column_reader(sqlite3_stmt* aStmt, int aFirstCol = 0) : theStmt(aStmt), theCol(aFirstCol) {}
+            template <class T> void operator()(T& aValue) const
+            {
+                column_value<T>::read(theStmt, theCol++, aValue);
+            }
+        private:
+            sqlite3_stmt* theStmt;
+            mutable int theCol;
+        };
+    } // namespace detail
+
+    //
+    // Statically typed query.
+    // Row is std::tuple, boost::tuple, std::pair or a struct adapted with BOOST_FUSION_ADAPT_STRUCT.
+    // The number of parameters, the number of result columns and their declared types are checked once
+    // when the query is prepared. Rows are decoded column by column without further checks.
+    //
+    // Usage:
+    //    typed_query<std::tuple<int, std::string>, int> qry(db, "SELECT id, name FROM contacts WHERE id > ?");
+    //    qry.execute(10);
+    //    std::tuple<int, std::string> row;
+    //    while (qry.fetch(row)) {...}
+    //
+    template <class Row, class... Params>
+    class typed_query : public statement
+    {
+    public:
+        class iterator : public boost::iterator_facade<iterator, Row const, boost::single_pass_traversal_tag>
+        {
+        public:
+            iterator() : theQuery(NULL) {}
+            explicit iterator(typed_query* aQuery) : theQuery(aQuery) { increment(); }
+
+        private:
+            friend class boost::iterator_core_access;
+
+            void increment()
+            {
+                if (!theQuery->fetch(theRow))
+                    theQuery = NULL;
+            }
+            bool equal(iterator const& other) const { return theQuery == other.theQuery; }
+            Row const& dereference() const { return theRow; }
+
+            typed_query* theQuery;
+            Row theRow;
+        };
+
+        typed_query(database& db, const std::string& anSql)
+            : statement(db, anSql)
+        {
+            std::vector<detail::ValueKind> myColumns;
+            Row myRow;
+            boost::fusion::for_each(myRow, detail::column_kinds_collector(myColumns));
+            detail::check_statement(theStmt, sizeof...(Params), myColumns);
+        }
+
+        // reset the query and bind all parameters
+        void execute(const Params&... aParams)
+        {
+            // the result is the error of the last step if any, which has already been reported by fetch()
+            rewind();
+            bind_params(1, aParams...);
+        }
+
+        // step to the next row and decode it, return false when there are no more rows
+        bool fetch(Row& aRow)
+        {
+            if (!step_row())
+                return false;
+            boost::fusion::for_each(aRow, detail::column_reader(theStmt));
+            return true;
+        }
+
+        // iterate over the rows of the query executed with the parameters bound last
+        iterator begin()
+        {
+            reset();
+            return iterator(this);
+        }
+        iterator end()
+        {
+            return iterator();
+        }
+
+    private:
+        void bind_params(int) {}
+        template <class P, class... Ps> void bind_params(int idx, const P& aParam, const Ps&... aParams)
+        {
+            bind(idx, aParam);
+            bind_params(idx + 1, aParams...);
+        }
+    };
+
+    //
+    // Statically typed command, the number of parameters is checked once when the command is prepared
+    //
+    template <class... Params>
+    class typed_command : public command
+    {
+    public:
+        typed_command(database& db, const std::string& anSql)
+            : command(db, anSql)
+        {
+            detail::check_statement(theStmt, sizeof...(Params), std::vector<detail::ValueKind>());
+        }
+
+        // bind all parameters, execute and reset the command
+        void execute(const Params&... aParams)
+        {
+            bind_params(1, aParams...);
+            try
+            {
+                command::execute();
+            }
+            catch (...)
+            {
+                rewind();
+                throw;
+            }
+            reset();
+        }
+
+    private:
+        void bind_params(int) {}
+        template <class P, class... Ps> void bind_params(int idx, const P& aParam, const Ps&... aParams)
+        {
+            bind(idx, aParam);
+            bind_params(idx + 1, aParams...);
+        }
+    };
+
+} // namespace sqlite3cpp
+
+#endif
@@ -0,0 +1,157 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppasync.h"
+#include "sqlite3cppcoalescer.h"
+#include "boost/format.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Contacts (\n"
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,\n"
+    "name char (128) NOT NULL UNIQUE,\n"
+    "phone char(67) NULL\n"
+    ");\n"
+    "COMMIT;\n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        const size_t myReaders = 2;
+        sqlite3cpp::async_database db("test.db", SqlCreate, myReaders);
+
+        // writes
+        std::vector<std::future<sqlite3cpp::async_result> > myWrites;
+        for (int i = 1; i <= 50; ++i)
+        {
+            sqlite3cpp::async_params myParams;
+            myParams.push_back(str(boost::format("name_%d") % i));
+            myParams.push_back(i % 2 ? sqlite3cpp::async_param(str(boost::format("%04d") % i)) : sqlite3cpp::async_param(sqlite3cpp::ignore));
+            myWrites.push_back(db.write("INSERT INTO contacts (name, phone) VALUES (?, ?)", myParams));
+        }
+        for (size_t i = 0; i < myWrites.size(); ++i)
+        {
+            sqlite3cpp::async_result myResult = myWrites[i].get();
+            TEST_ASSERT_EQUALS(myResult.changes, 1);
+            TEST_ASSERT_EQUALS(myResult.last_insert_rowid, static_cast<sqlite3_int64>(i + 1));
+        }
+
+        // failed write is reported through the future
+        {
+            sqlite3cpp::async_params myParams(1, std::string("name_1"));
+            std::future<sqlite3cpp::async_result> myResult = db.write("INSERT INTO contacts (name) VALUES (?)", myParams);
+            bool myThrown = false;
+            try { myResult.get(); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
+        // reads
+        {
+            std::future<sqlite3cpp::async_result> myFuture = db.read("SELECT id, name, phone FROM contacts WHERE id <= ? ORDER BY id", sqlite3cpp::async_params(1, 10));
+            sqlite3cpp::async_result myResult = myFuture.get();
+            TEST_ASSERT_EQUALS(myResult.rows.rows(), 10U);
+            for (size_t i = 0; i < myResult.rows.rows(); ++i)
+            {
+                TEST_ASSERT_EQUALS(myResult.rows.get_column(1).integers[i], static_cast<sqlite3_int64>(i + 1));
+                TEST_ASSERT_EQUALS(myResult.rows.text(2, i), str(boost::format("name_%d") % (i + 1)));
+                TEST_ASSERT_EQUALS(myResult.rows.is_null(3, i), (i % 2 != 0));
+            }
+        }
+
+        // callbacks
+        {
+            std::atomic<int> myRows(0);
+            std::promise<void> myDone;
+            std::atomic<int> myPending(20);
+            for (int i = 1; i <= 20; ++i)
+            {
+                db.read("SELECT name FROM contacts WHERE id = ?", sqlite3cpp::async_params(1, i),
+                        [&](std::exception_ptr anError, sqlite3cpp::async_result& aResult)
+                {
+                    if (!anError)
+                        myRows += aResult.rows.rows();
+                    if (--myPending == 0)
+                        myDone.set_value();
+                });
+            }
+            myDone.get_future().wait();
+            TEST_ASSERT_EQUALS(myRows, 20);
+        }
+
+        const sqlite3cpp::async_database_stats myStats = db.get_stats();
+        TEST_ASSERT_EQUALS(myStats.writes.completed, 50);
+        TEST_ASSERT_EQUALS(myStats.writes.failed, 1);
+        TEST_ASSERT_EQUALS(myStats.reads.completed, 21);
+        TEST_ASSERT_EQUALS(myStats.reads.depth, 0U);
+
+        // group commit of writes from many threads
+        {
+            sqlite3cpp::write_coalescer myCoalescer("test.db", SqlCreate);
+            std::vector<std::future<sqlite3cpp::write_result> > myResults(100);
+            std::vector<std::thread> myThreads;
+            for (int t = 0; t < 4; ++t)
+            {
+                myThreads.push_back(std::thread([t, &myCoalescer, &myResults]()
+                {
+                    for (int i = t; i < 100; i += 4)
+                        myResults[i] = myCoalescer.submit("INSERT INTO contacts (name) VALUES (?)", sqlite3cpp::async_params(1, str(boost::format("coalesced_%d") % i)));
+                }));
+            }
+            for (size_t t = 0; t < myThreads.size(); ++t)
+                myThreads[t].join();
+
+            // duplicate name fails alone
+            std::future<sqlite3cpp::write_result> myDuplicate = myCoalescer.submit("INSERT INTO contacts (name) VALUES (?)", sqlite3cpp::async_params(1, std::string("coalesced_0")));
+            std::future<sqlite3cpp::write_result> myUpdate = myCoalescer.submit([](sqlite3cpp::database& db)
+            {
+                db.execute("UPDATE contacts SET phone = 'coalesced' WHERE name LIKE 'coalesced_%'");
+            });
+
+            std::vector<sqlite3_int64> myRowIds;
+            for (size_t i = 0; i < myResults.size(); ++i)
+            {
+                const sqlite3cpp::write_result myResult = myResults[i].get();
+                TEST_ASSERT_EQUALS(myResult.changes, 1);
+                myRowIds.push_back(myResult.last_insert_rowid);
+            }
+            std::sort(myRowIds.begin(), myRowIds.end());
+            TEST_ASSERT(std::unique(myRowIds.begin(), myRowIds.end()) == myRowIds.end());
+
+            bool myThrown = false;
+            try { myDuplicate.get(); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT_EQUALS(myUpdate.get().changes, 100);
+
+            const sqlite3cpp::write_coalescer_stats myStats = myCoalescer.get_stats();
+            TEST_ASSERT_EQUALS(myStats.writes, 101);
+            TEST_ASSERT_EQUALS(myStats.failed, 1);
+            TEST_ASSERT(myStats.commits <= myStats.writes);
+
+            sqlite3cpp::async_result myCount = db.read("SELECT COUNT(*) FROM contacts WHERE phone = 'coalesced'").get();
+            TEST_ASSERT_EQUALS(myCount.rows.get_column(1).integers[0], 100);
+        }
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
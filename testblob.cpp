@@ -0,0 +1,176 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppblob.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Files (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "data BLOB NOT NULL\n"
+    ");\n"
+    "COMMIT;\n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+static std::string makePattern(size_t aSize)
+{
+    std::string myData(aSize, '\0');
+    for (size_t i = 0; i < aSize; ++i)
+        myData[i] = static_cast<char>('a' + i % 26);
+    return myData;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        sqlite3cpp::database db("test.db", SqlCreate);
+
+        const size_t mySize = 300 * 1024;
+        {
+            sqlite3cpp::command cmd(db, "INSERT INTO Files (id, data) VALUES (?, ?)");
+            for (int i = 1; i <= 3; ++i)
+            {
+                cmd.bind(1, i);
+                cmd.bind(2, sqlite3cpp::zeroblob(mySize));
+                cmd.execute();
+                cmd.reset();
+            }
+        }
+
+        // random access
+        {
+            sqlite3cpp::blob_stream blob(db, "Files", "data", 1, sqlite3cpp::blobReadWrite);
+            TEST_ASSERT_EQUALS(blob.size(), mySize);
+            TEST_ASSERT_EQUALS(blob.rowid(), 1);
+            blob.write("hello", 5, 1000);
+            char myBuf[5] = {};
+            blob.read(myBuf, sizeof(myBuf), 1000);
+            TEST_ASSERT(std::string(myBuf, 5) == "hello");
+            blob.read(myBuf, sizeof(myBuf), 0);
+            TEST_ASSERT(std::string(myBuf, 5) == std::string(5, '\0'));
+
+            bool myThrown = false;
+            try { blob.read(myBuf, sizeof(myBuf), mySize - 2); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
+        // the BLOB cannot be written through a read-only stream
+        {
+            sqlite3cpp::blob_stream blob(db, "Files", "data", 1);
+            bool myThrown = false;
+            try { blob.write("x", 1, 0); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
+        // opening a missing row fails
+        {
+            bool myThrown = false;
+            try { sqlite3cpp::blob_stream blob(db, "Files", "data", 42); }
+            catch (sqlite3cpp::database_error& e) { myThrown = true; TEST_ASSERT_EQUALS(e.code(), SQLITE_ERROR); }
+            TEST_ASSERT(myThrown);
+        }
+
+        // streaming with a buffer smaller than the BLOB
+        {
+            const std::string myData = makePattern(mySize);
+            sqlite3cpp::blob_stream blob(db, "Files", "data", 2, sqlite3cpp::blobReadWrite);
+            {
+                sqlite3cpp::blob_streambuf buf(blob, 4096);
+                std::ostream os(&buf);
+                // mix of small buffered writes and large direct writes
+                os.write(myData.data(), 10);
+                os << myData[10];
+                os.write(myData.data() + 11, 100 * 1024 - 11);
+                os.write(myData.data() + 100 * 1024, mySize - 100 * 1024);
+                os.flush();
+                TEST_ASSERT(os.good());
+
+                // writing past the end fails since the BLOB cannot grow
+                os << 'x';
+                os.flush();
+                TEST_ASSERT(!os.good());
+            }
+            {
+                sqlite3cpp::blob_streambuf buf(blob, 4096);
+                std::istream is(&buf);
+                std::string myRead(mySize, '\0');
+                is.read(&myRead[0], 3);
+                is.read(&myRead[3], mySize - 3);
+                TEST_ASSERT(is.good());
+                TEST_ASSERT(myRead == myData);
+                TEST_ASSERT(is.get() == std::char_traits<char>::eof());
+
+                is.clear();
+                is.seekg(26 * 10 + 3);
+                TEST_ASSERT_EQUALS(static_cast<char>(is.get()), 'd');
+                is.seekg(-1, std::ios_base::end);
+                TEST_ASSERT_EQUALS(static_cast<char>(is.get()), myData[mySize - 1]);
+            }
+
+            // interleaved reads and writes through the same buffer
+            {
+                sqlite3cpp::blob_streambuf buf(blob, 64);
+                std::iostream ios(&buf);
+                std::string myLine;
+                ios.seekp(500);
+                ios << "0123456789";
+                ios.seekg(505);
+                char myChars[5];
+                ios.read(myChars, 5);
+                TEST_ASSERT(std::string(myChars, 5) == "56789");
+                ios << "ABC";
+                ios.flush();
+                char myCheck[3];
+                blob.read(myCheck, 3, 510);
+                TEST_ASSERT(std::string(myCheck, 3) == "ABC");
+            }
+        }
+
+        // reopen the stream on other rows
+        {
+            sqlite3cpp::blob_stream blob(db, "Files", "data", 1, sqlite3cpp::blobReadWrite);
+            for (int i = 1; i <= 3; ++i)
+            {
+                blob.reopen(i);
+                TEST_ASSERT_EQUALS(blob.rowid(), i);
+                const char myMark = static_cast<char>('0' + i);
+                blob.write(&myMark, 1, 0);
+            }
+            blob.close();
+
+            sqlite3cpp::query qry(db, "SELECT substr(data, 1, 1) FROM Files ORDER BY id");
+            std::string myMarks;
+            for (sqlite3cpp::query::iterator it = qry.begin(); it != qry.end(); ++it)
+            {
+                sqlite3cpp::blob_view myBlob = it->get<sqlite3cpp::blob_view>(1);
+                myMarks.append(static_cast<char const*>(myBlob.data), myBlob.size);
+            }
+            TEST_ASSERT_EQUALS(myMarks, "123");
+
+            bool myThrown = false;
+            try { blob.size(); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,175 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppcache.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <cstdio>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Rates (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "currency TEXT NOT NULL UNIQUE,\n"
+    "rate REAL NOT NULL\n"
+    ");\n"
+    "CREATE TABLE Other (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "currency TEXT NOT NULL\n"
+    ");\n"
+    "INSERT INTO Rates VALUES (1, 'EUR', 1.0);\n"
+    "INSERT INTO Rates VALUES (2, 'USD', 1.1);\n"
+    "INSERT INTO Rates VALUES (3, 'GBP', 0.85);\n"
+    "COMMIT;\n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+typedef std::tuple<int, double> RateById;
+typedef sqlite3cpp::cached_table<std::string, RateById> RateCache;
+
+static double getRate(RateCache& aCache, const std::string& aCurrency)
+{
+    RateById const* myRate = aCache.find(aCurrency);
+    return myRate ? std::get<1>(*myRate) : -1;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        sqlite3cpp::database db("test.db", SqlCreate);
+
+        RateCache cache(db, "Rates", "currency", "id, rate");
+        TEST_ASSERT_EQUALS(cache.size(), 3);
+        TEST_ASSERT_EQUALS(getRate(cache, "USD"), 1.1);
+        TEST_ASSERT_EQUALS(std::get<0>(*cache.find("GBP")), 3);
+        TEST_ASSERT(cache.find("JPY") == NULL);
+
+        // incremental refresh of the changed rows only
+        db.execute("UPDATE Rates SET rate = 1.2 WHERE currency = 'USD'");
+        db.execute("INSERT INTO Rates VALUES (4, 'JPY', 160.5)");
+        db.execute("DELETE FROM Rates WHERE id = 3");
+        db.execute("INSERT INTO Other VALUES (1, 'CHF')");
+        TEST_ASSERT_EQUALS(getRate(cache, "USD"), 1.2);
+        TEST_ASSERT_EQUALS(getRate(cache, "JPY"), 160.5);
+        TEST_ASSERT_EQUALS(getRate(cache, "GBP"), -1);
+        TEST_ASSERT_EQUALS(cache.size(), 3);
+        sqlite3cpp::cached_table_stats myStats = cache.get_stats();
+        TEST_ASSERT_EQUALS(myStats.refreshed_rows, 3);
+        TEST_ASSERT_EQUALS(myStats.reloads, 1);
+        TEST_ASSERT_EQUALS(myStats.hits, 4);
+        TEST_ASSERT_EQUALS(myStats.misses, 2);
+
+        // the key of a row changes
+        db.execute("UPDATE Rates SET currency = 'YEN' WHERE id = 4");
+        TEST_ASSERT_EQUALS(getRate(cache, "JPY"), -1);
+        TEST_ASSERT_EQUALS(getRate(cache, "YEN"), 160.5);
+
+        // rolled back changes are re-read as well
+        {
+            sqlite3cpp::transaction xct(db);
+            db.execute("UPDATE Rates SET rate = 2.0 WHERE id = 1");
+            TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 2.0);
+            db.execute("UPDATE Rates SET rate = 3.0 WHERE id = 1");
+            xct.rollback();
+        }
+        TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 1.0);
+        {
+            sqlite3cpp::transaction xct(db);
+            db.execute("UPDATE Rates SET rate = 2.0 WHERE id = 1");
+            TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 2.0);
+            xct.rollback();
+        }
+        TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 1.0);
+        {
+            const bool myCommitOnExit = true;
+            sqlite3cpp::transaction xct(db, myCommitOnExit);
+            db.execute("UPDATE Rates SET rate = 2.0 WHERE id = 1");
+            TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 2.0);
+        }
+        TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 2.0);
+        db.execute("UPDATE Rates SET rate = 1.0 WHERE id = 1");
+
+        // rows restored by a nested transaction rolled back are re-read within the enclosing one
+        {
+            sqlite3cpp::transaction xct(db);
+            db.execute("UPDATE Rates SET rate = 2.0 WHERE id = 1");
+            TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 2.0);
+            {
+                sqlite3cpp::transaction myNested(db);
+                db.execute("UPDATE Rates SET rate = 3.0 WHERE id = 1");
+                db.execute("DELETE FROM Rates WHERE id = 2");
+                TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 3.0);
+                TEST_ASSERT_EQUALS(getRate(cache, "USD"), -1);
+                myNested.rollback();
+            }
+            TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 2.0);
+            TEST_ASSERT_EQUALS(getRate(cache, "USD"), 1.2);
+            xct.rollback();
+        }
+        TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 1.0);
+        {
+            sqlite3cpp::transaction xct(db);
+            db.execute("UPDATE Rates SET rate = 2.0 WHERE id = 1");
+            RateCache myCache(db, "Rates", "currency", "id, rate");
+            {
+                sqlite3cpp::transaction myNested(db);
+                db.execute("UPDATE Rates SET rate = 3.0 WHERE id = 1");
+                TEST_ASSERT_EQUALS(getRate(myCache, "EUR"), 3.0);
+            }
+            TEST_ASSERT_EQUALS(getRate(myCache, "EUR"), 2.0);
+        }
+        TEST_ASSERT_EQUALS(getRate(cache, "EUR"), 1.0);
+
+        // a mirror loaded within a transaction is loaded again after it
+        {
+            sqlite3cpp::transaction xct(db);
+            db.execute("UPDATE Rates SET rate = 2.0 WHERE id = 1");
+            RateCache myCache(db, "Rates", "currency", "id, rate");
+            TEST_ASSERT_EQUALS(getRate(myCache, "EUR"), 2.0);
+            xct.rollback();
+            TEST_ASSERT_EQUALS(getRate(myCache, "EUR"), 1.0);
+            TEST_ASSERT_EQUALS(myCache.get_stats().reloads, 2);
+        }
+
+        // DELETE without WHERE is not reported row by row
+        myStats = cache.get_stats();
+        db.execute("DELETE FROM Rates");
+        TEST_ASSERT_EQUALS(cache.size(), 0);
+        TEST_ASSERT_EQUALS(cache.get_stats().reloads, myStats.reloads + 1);
+
+        // many changes cause a reload
+        db.execute("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+                   "INSERT INTO Rates SELECT i, 'C' || i, i * 0.5 FROM n");
+        TEST_ASSERT_EQUALS(getRate(cache, "C500"), 250);
+        TEST_ASSERT_EQUALS(cache.size(), 1000);
+        TEST_ASSERT_EQUALS(cache.get_stats().reloads, myStats.reloads + 2);
+
+        // changes by another connection are picked up by reload()
+        {
+            sqlite3cpp::database db2("test.db", "");
+            db2.execute("UPDATE Rates SET rate = 0 WHERE id = 1");
+        }
+        TEST_ASSERT_EQUALS(getRate(cache, "C1"), 0.5);
+        cache.reload();
+        TEST_ASSERT_EQUALS(getRate(cache, "C1"), 0);
+
+        // mismatching declared column type
+        bool myThrown = false;
+        try { sqlite3cpp::cached_table<int, std::tuple<int> > myCache(db, "Rates", "id", "currency"); }
+        catch (sqlite3cpp::database_error&) { myThrown = true; }
+        TEST_ASSERT(myThrown);
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,155 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppcheckpoint.h"
+#include <sys/stat.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Events (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "payload TEXT NOT NULL\n"
+    ");\n"
+    "COMMIT;\n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+static void insertEvents(sqlite3cpp::database& db, int aCount)
+{
+    sqlite3cpp::command cmd(db, "INSERT INTO Events (payload) VALUES (?)");
+    for (int i = 0; i < aCount; ++i)
+    {
+        cmd.bind(1, std::string(200, 'x'));
+        cmd.execute();
+        cmd.reset();
+    }
+}
+
+static off_t getFileSize(const std::string& aPath)
+{
+    struct stat st;
+    return (stat(aPath.c_str(), &st) == 0) ? st.st_size : -1;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        ::remove("test.db-wal");
+        ::remove("test.db-shm");
+
+        // not in WAL mode
+        {
+            sqlite3cpp::database db("test.db", SqlCreate);
+            const sqlite3cpp::checkpoint_result myResult = db.checkpoint();
+            TEST_ASSERT(!myResult.busy);
+            TEST_ASSERT_EQUALS(myResult.log_frames, -1);
+        }
+
+        sqlite3cpp::open_options myOptions;
+        myOptions.journal_mode = sqlite3cpp::journalWal;
+        sqlite3cpp::database db("test.db", SqlCreate, "", myOptions);
+
+        // the WAL callback replaces the automatic checkpoint
+        int myCommits = 0;
+        int myLastFrames = 0;
+        db.set_wal_callback([&myCommits, &myLastFrames](const std::string& aDbName, int aFrames)
+        {
+            if (aDbName == "main")
+            {
+                ++myCommits;
+                myLastFrames = aFrames;
+            }
+        });
+        insertEvents(db, 100);
+        TEST_ASSERT_EQUALS(myCommits, 100);
+        TEST_ASSERT(myLastFrames >= 100);
+
+        sqlite3cpp::checkpoint_result myResult = db.checkpoint(sqlite3cpp::checkpointPassive);
+        TEST_ASSERT(!myResult.busy);
+        TEST_ASSERT_EQUALS(myResult.log_frames, myLastFrames);
+        TEST_ASSERT_EQUALS(myResult.checkpointed_frames, myLastFrames);
+
+        // a reader holding an old snapshot prevents the WAL from being reset
+        {
+            sqlite3cpp::database reader("test.db", "");
+            sqlite3cpp::query qry(reader, "SELECT id FROM Events");
+            sqlite3cpp::query::iterator it = qry.begin();
+            TEST_ASSERT(it != qry.end());
+            insertEvents(db, 10);
+            db.set_busy_timeout(20);
+            myResult = db.checkpoint(sqlite3cpp::checkpointTruncate);
+            TEST_ASSERT(myResult.busy);
+        }
+        TEST_ASSERT(getFileSize("test.db-wal") > 0);
+        myResult = db.checkpoint(sqlite3cpp::checkpointTruncate);
+        TEST_ASSERT(!myResult.busy);
+        TEST_ASSERT_EQUALS(myResult.log_frames, 0);
+        TEST_ASSERT_EQUALS(getFileSize("test.db-wal"), 0);
+
+        db.set_wal_autocheckpoint(1000);
+        insertEvents(db, 1);
+        TEST_ASSERT_EQUALS(myCommits, 110);
+
+        // attached writers get their automatic checkpoint back
+        db.set_wal_autocheckpoint(500);
+        {
+            sqlite3cpp::wal_checkpointer checkpointer("test.db");
+            checkpointer.attach(db);
+            checkpointer.attach(db);
+            TEST_ASSERT_EQUALS(db.get_wal_autocheckpoint(), 0);
+            checkpointer.detach(db);
+            TEST_ASSERT_EQUALS(db.get_wal_autocheckpoint(), 500);
+            checkpointer.detach(db);
+            TEST_ASSERT_EQUALS(db.get_wal_autocheckpoint(), 500);
+        }
+
+        // background checkpointer
+        {
+            sqlite3cpp::checkpoint_policy myPolicy;
+            myPolicy.interval_ms = 10;
+            myPolicy.passive_frames = 20;
+            myPolicy.truncate_frames = 50;
+            sqlite3cpp::wal_checkpointer checkpointer("test.db", myPolicy, myOptions);
+            checkpointer.attach(db);
+            insertEvents(db, 200);
+            checkpointer.trigger();
+
+            sqlite3cpp::checkpointer_stats myStats;
+            for (int i = 0; i < 200; ++i)
+            {
+                myStats = checkpointer.get_stats();
+                if (myStats.checkpoints > 1 && myStats.log_frames == 0)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            TEST_ASSERT(myStats.checkpoints > 1);
+            TEST_ASSERT_EQUALS(myStats.errors, 0);
+            TEST_ASSERT(myStats.frames_checkpointed > 0);
+            TEST_ASSERT(myStats.truncations > 0);
+            TEST_ASSERT_EQUALS(myStats.log_frames, 0);
+        }
+        // the writer outlives the checkpointer and checkpoints on its own again
+        TEST_ASSERT_EQUALS(db.get_wal_autocheckpoint(), 500);
+        insertEvents(db, 600);
+        myResult = db.checkpoint(sqlite3cpp::checkpointPassive);
+        TEST_ASSERT(!myResult.busy);
+        TEST_ASSERT(myResult.log_frames < 600);
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
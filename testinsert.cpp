@@ -1,7 +1,13 @@
 #include "sqlite3cpp.h"
+#include "sqlite3cppbulk.h"
 #include "boost/format.hpp"
+#include "boost/fusion/include/adapt_struct.hpp"
 #include <iostream>
 #include <cstdio>
+#include <cstring>
+#include <vector>
+#include <limits>
+#include <unistd.h>
 
 static const std::string SqlCreate =
     "BEGIN TRANSACTION;\n"
@@ -15,6 +21,13 @@ static const std::string SqlCreate =
 #define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
 #define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
 
+struct Contact
+{
+    std::string name;
+    std::string phone;
+};
+BOOST_FUSION_ADAPT_STRUCT(Contact, (std::string, name) (std::string, phone))
+
 using std::cout;
 using std::endl;
 
@@ -134,6 +147,372 @@ int main(int argc, char* argv[])
             TEST_ASSERT_EQUALS(rec_count, 4);
         }
 
+        // nested transactions are savepoints, rolling back the inner one keeps the changes of the outer one
+        {
+            db.execute("CREATE TABLE Nested (id INTEGER PRIMARY KEY)");
+            {
+                sqlite3cpp::transaction xct(db, sqlite3cpp::transactionImmediate);
+                TEST_ASSERT(!xct.nested());
+                db.execute("INSERT INTO Nested VALUES (1)");
+                {
+                    sqlite3cpp::transaction myInner(db);
+                    TEST_ASSERT(myInner.nested());
+                    db.execute("INSERT INTO Nested VALUES (100)");
+                    {
+                        const bool myCommitOnExit = true;
+                        sqlite3cpp::transaction myInnermost(db, myCommitOnExit);
+                        db.execute("INSERT INTO Nested VALUES (101)");
+                    }
+                }
+                {
+                    sqlite3cpp::transaction myInner(db);
+                    db.execute("INSERT INTO Nested VALUES (2)");
+                    myInner.commit();
+                }
+                xct.commit();
+            }
+
+            // nothing of a rolled back transaction is kept, including its committed nested ones
+            {
+                sqlite3cpp::transaction xct(db, sqlite3cpp::transactionExclusive);
+                sqlite3cpp::transaction myInner(db);
+                db.execute("INSERT INTO Nested VALUES (102)");
+                myInner.commit();
+                xct.rollback();
+            }
+
+            // a transaction begun with BEGIN is nested into
+            db.execute("BEGIN");
+            {
+                sqlite3cpp::transaction myNested(db);
+                TEST_ASSERT(myNested.nested());
+                db.execute("INSERT INTO Nested VALUES (103)");
+            }
+            db.execute("INSERT INTO Nested VALUES (3)");
+            db.execute("COMMIT");
+
+            sqlite3cpp::query qry(db, "SELECT id FROM Nested ORDER BY id");
+            int rec_count = 0;
+            for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+            {
+                ++rec_count;
+                const int myId = i->get<int>(1);
+                TEST_ASSERT_EQUALS(myId, rec_count);
+            }
+            TEST_ASSERT_EQUALS(rec_count, 3);
+
+            // a transaction failed to commit stays pending, so that the commit can be retried
+            db.enable_foreign_keys();
+            db.execute("CREATE TABLE NestedRef (id INTEGER REFERENCES Nested (id) DEFERRABLE INITIALLY DEFERRED)");
+            {
+                sqlite3cpp::transaction xct(db);
+                {
+                    sqlite3cpp::transaction myInner(db);
+                    db.execute("INSERT INTO NestedRef VALUES (1)");
+                    db.execute("INSERT INTO NestedRef VALUES (100)");
+                    myInner.commit();
+                }
+                bool myThrown = false;
+                try { xct.commit(); }
+                catch (sqlite3cpp::database_error&) { myThrown = true; }
+                TEST_ASSERT(myThrown);
+                TEST_ASSERT(db.in_transaction());
+                db.execute("DELETE FROM NestedRef WHERE id = 100");
+                xct.commit();
+                TEST_ASSERT(!db.in_transaction());
+            }
+            // otherwise it is rolled back on destruction, even if it is to be committed
+            {
+                const bool myCommitOnExit = true;
+                sqlite3cpp::transaction xct(db, myCommitOnExit);
+                db.execute("INSERT INTO NestedRef VALUES (101)");
+                bool myThrown = false;
+                try { xct.commit(); }
+                catch (sqlite3cpp::database_error&) { myThrown = true; }
+                TEST_ASSERT(myThrown);
+                TEST_ASSERT(db.in_transaction());
+            }
+            TEST_ASSERT(!db.in_transaction());
+            db.enable_foreign_keys(false);
+            {
+                sqlite3cpp::query myCount(db, "SELECT count(*) FROM NestedRef");
+                TEST_ASSERT_EQUALS(myCount.begin()->get<int>(1), 1);
+            }
+            // the depth is restored, so the next transaction is not nested
+            sqlite3cpp::transaction xct(db);
+            TEST_ASSERT(!xct.nested());
+        }
+
+        // bind without copying and read back through views
+        {
+            static const std::string myName = "name_5";
+            char* myPhone = static_cast<char*>(sqlite3_malloc(4));
+            memcpy(myPhone, "0005", 4);
+
+            sqlite3cpp::command cmd(db, "INSERT INTO contacts (name, phone) VALUES (:name, :phone)");
+            cmd.bind(":name", myName, sqlite3cpp::bindStatic);
+            cmd.bind(":phone", boost::string_view(myPhone, 4), sqlite3_free);
+            cmd.execute();
+
+            // a view without data is bound as an empty string, nothing is disposed
+            sqlite3cpp::query myEmpty(db, "SELECT ? = ''");
+            myEmpty.bind(1, boost::string_view(), sqlite3_free);
+            TEST_ASSERT_EQUALS(myEmpty.begin()->get<int>(1), 1);
+
+            sqlite3cpp::query qry(db, "SELECT name, phone, CAST(phone AS BLOB) FROM contacts WHERE name = ?");
+            qry << boost::string_view("name_5xxx", 6);
+            int rec_count = 0;
+            for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+            {
+                TEST_ASSERT_EQUALS(i->get<boost::string_view>(1), "name_5");
+                TEST_ASSERT_EQUALS(i->get<boost::string_view>(2), "0005");
+                const sqlite3cpp::blob_view myBlob = i->get<sqlite3cpp::blob_view>(3);
+                TEST_ASSERT_EQUALS(myBlob.size, 4U);
+                TEST_ASSERT(memcmp(myBlob.data, "0005", 4) == 0);
+                ++rec_count;
+            }
+            TEST_ASSERT_EQUALS(rec_count, 1);
+        }
+
+        // bulk insert in batches
+        {
+            db.execute("DELETE FROM contacts");
+            {
+                const size_t myBatchSize = 3;
+                sqlite3cpp::bulk_inserter inserter(db, "INSERT INTO contacts (name, phone) VALUES (?, ?)", myBatchSize);
+                for (int i = 1; i <= 5; ++i)
+                    inserter.insert(boost::make_tuple(str(boost::format("name_%d") % i), str(boost::format("000%d") % i)));
+
+                std::vector<Contact> myContacts(2);
+                myContacts[0].name = "name_6";
+                myContacts[0].phone = "0006";
+                myContacts[1].name = "name_7";
+                myContacts[1].phone = "0007";
+                inserter.insert(myContacts.begin(), myContacts.end());
+
+                TEST_ASSERT_EQUALS(inserter.get_stats().rows, 7);
+                TEST_ASSERT_EQUALS(inserter.get_stats().batches, 2);
+                // the last batch of 1 row is not flushed and shall be rolled back
+            }
+
+            sqlite3cpp::query qry(db, "SELECT name, phone FROM contacts");
+            int rec_count = 0;
+            for (sqlite3cpp::query::iterator i = qry.begin(); i != qry.end(); ++i)
+            {
+                std::string name, phone;
+
+                (*i) >> name >> phone;
+
+                ++rec_count;
+                TEST_ASSERT_EQUALS(name, str(boost::format("name_%d") % rec_count));
+                TEST_ASSERT_EQUALS(phone, str(boost::format("000%d") % rec_count));
+            }
+            TEST_ASSERT_EQUALS(rec_count, 6);
+        }
+
+        // a failed row does not affect the next ones
+        {
+            sqlite3cpp::bulk_inserter inserter(db, "INSERT INTO contacts (id, name, phone) VALUES (?, ?, ?)");
+            inserter.insert(boost::make_tuple(100, "name_100", "0100"));
+            bool myThrown = false;
+            try { inserter.insert(boost::make_tuple(100, "name_100", "0100")); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            inserter.insert(boost::make_tuple(101, "name_101", "0101"));
+            inserter.flush();
+            sqlite3cpp::bulk_insert_stats myStats = inserter.get_stats();
+            TEST_ASSERT_EQUALS(myStats.rows, 2);
+            TEST_ASSERT(myStats.elapsed_sec > 0);
+            usleep(10000);
+            const double myElapsed = inserter.get_stats().elapsed_sec;
+            TEST_ASSERT_EQUALS(myElapsed, myStats.elapsed_sec);
+
+            sqlite3cpp::query qry(db, "SELECT count(*) FROM contacts WHERE id >= 100");
+            TEST_ASSERT_EQUALS(qry.begin()->get<int>(1), 2);
+        }
+        db.execute("DELETE FROM contacts WHERE id >= 100");
+
+        // a batch failed to commit is dropped
+        {
+            db.enable_foreign_keys();
+            db.execute("CREATE TABLE Phones (contact INTEGER REFERENCES Nested (id) DEFERRABLE INITIALLY DEFERRED, phone TEXT)");
+            {
+                const size_t myBatchSize = 2;
+                sqlite3cpp::bulk_inserter inserter(db, "INSERT INTO Phones VALUES (?, ?)", myBatchSize);
+                inserter.insert(boost::make_tuple(1, "0001"));
+                inserter.insert(boost::make_tuple(2, "0002"));
+                inserter.insert(boost::make_tuple(1, "1001"));
+                bool myThrown = false;
+                try { inserter.insert(boost::make_tuple(1000, "1000")); }
+                catch (sqlite3cpp::database_error&) { myThrown = true; }
+                TEST_ASSERT(myThrown);
+                TEST_ASSERT(!db.in_transaction());
+                sqlite3cpp::bulk_insert_stats myStats = inserter.get_stats();
+                TEST_ASSERT_EQUALS(myStats.rows, 2);
+                TEST_ASSERT_EQUALS(myStats.batches, 1);
+
+                inserter.insert(boost::make_tuple(3, "0003"));
+                inserter.flush();
+                myStats = inserter.get_stats();
+                TEST_ASSERT_EQUALS(myStats.rows, 3);
+                TEST_ASSERT_EQUALS(myStats.batches, 2);
+            }
+            db.enable_foreign_keys(false);
+            sqlite3cpp::query qry(db, "SELECT group_concat(phone) FROM (SELECT phone FROM Phones ORDER BY phone)");
+            TEST_ASSERT_EQUALS(qry.begin()->get<std::string>(1), "0001,0002,0003");
+        }
+
+        // structured errors and non-throwing execution
+        {
+            const std::string mySql = "INSERT INTO contacts (id, name, phone) VALUES (?, ?, ?)";
+            sqlite3cpp::command cmd(db, mySql);
+            cmd << 100 << "duplicate" << "0000";
+            int rc = cmd.try_execute();
+            TEST_ASSERT_EQUALS(rc, SQLITE_OK);
+            cmd.reset();
+            rc = cmd.try_execute();
+            TEST_ASSERT_EQUALS(rc, SQLITE_CONSTRAINT_PRIMARYKEY);
+            // the failed command can be executed again once the constraint is satisfied
+            cmd.bind(1, 101);
+            rc = cmd.try_execute();
+            TEST_ASSERT_EQUALS(rc, SQLITE_OK);
+            cmd.reset();
+            rc = db.try_execute("INSERT INTO contacts (id, name) VALUES (100, 'duplicate')");
+            TEST_ASSERT_EQUALS(rc, SQLITE_CONSTRAINT_PRIMARYKEY);
+
+            bool myThrown = false;
+            try { cmd.bind(4, "out of range"); }
+            catch (sqlite3cpp::database_error& e)
+            {
+                myThrown = true;
+                TEST_ASSERT_EQUALS(e.code(), SQLITE_RANGE);
+                TEST_ASSERT_EQUALS(e.parameter_index(), 4);
+                TEST_ASSERT(std::string(e.what()).find("at position 4") != std::string::npos);
+            }
+            TEST_ASSERT(myThrown);
+
+            myThrown = false;
+            try { cmd.execute(); }
+            catch (sqlite3cpp::database_error& e)
+            {
+                myThrown = true;
+                TEST_ASSERT_EQUALS(e.code(), SQLITE_CONSTRAINT);
+                TEST_ASSERT_EQUALS(e.extended_code(), SQLITE_CONSTRAINT_PRIMARYKEY);
+                TEST_ASSERT_EQUALS(e.sql(), mySql);
+                TEST_ASSERT_EQUALS(e.parameter_index(), 0);
+                TEST_ASSERT(std::string(e.what()).find(mySql) != std::string::npos);
+            }
+            TEST_ASSERT(myThrown);
+            db.execute("DELETE FROM contacts WHERE id >= 100");
+        }
+
+        // named parameters resolved once and bound through handles
+        {
+            sqlite3cpp::command cmd(db, "INSERT INTO contacts (id, name, phone) VALUES (@id, :name, :name || $suffix)");
+            const sqlite3cpp::param_handle myId = cmd.get_param("@id");
+            const sqlite3cpp::param_handle myName = cmd.get_param(":name");
+            TEST_ASSERT_EQUALS(myId.index(), 1);
+            TEST_ASSERT_EQUALS(myName.index(), 2);
+            TEST_ASSERT_EQUALS(cmd.get_param(std::string("$suffix")).index(), 3);
+            for (int i = 100; i < 103; ++i)
+            {
+                cmd.bind(myId, i);
+                cmd.bind(myName, str(boost::format("name_%d") % i));
+                cmd.bind("$suffix", boost::string_view("_phone"), sqlite3cpp::bindStatic);
+                cmd.execute();
+                cmd.reset();
+            }
+            bool myThrown = false;
+            try { cmd.get_param("name"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+
+            sqlite3cpp::query qry(db, "SELECT phone FROM contacts WHERE id = 101");
+            TEST_ASSERT_EQUALS(qry.begin()->get<std::string>(1), "name_101_phone");
+            db.execute("DELETE FROM contacts WHERE id >= 100");
+        }
+
+        // names bound after the statement is recompiled for a schema change
+        {
+            sqlite3cpp::command cmd(db, "INSERT INTO contacts (id, name, phone) VALUES (:id, :name, :phone)");
+            cmd.bind(":id", 100);
+            cmd.bind(":name", "name_100");
+            cmd.bind(":phone", "0100");
+            cmd.execute();
+            cmd.reset();
+            db.execute("CREATE TABLE SchemaChange (id INTEGER)");
+            cmd.bind(":id", 101);
+            cmd.execute();
+            cmd.reset();
+            cmd.bind(":id", 102);
+            cmd.bind(":name", "name_102");
+            cmd.bind(":phone", "0102");
+            cmd.execute();
+            cmd.reset();
+
+            {
+                sqlite3cpp::query qry(db, "SELECT phone FROM contacts WHERE id = 102");
+                TEST_ASSERT_EQUALS(qry.begin()->get<std::string>(1), "0102");
+            }
+            db.execute("DELETE FROM contacts WHERE id >= 100");
+            db.execute("DROP TABLE SchemaChange");
+        }
+
+        // 64-bit integers
+        {
+            enum Kind { kindPrimary = 1, kindSecondary = 2 };
+            const long myTimestamp = 1700000000123456789L;
+            const unsigned long myUnsigned = 1UL << 40;
+            sqlite3cpp::command cmd(db, "INSERT INTO contacts (id, name, phone) VALUES (?, ?, ?)");
+            cmd << myTimestamp << myUnsigned << kindSecondary;
+            cmd.execute();
+            cmd.reset();
+
+            bool myThrown = false;
+            try { cmd.bind(1, static_cast<unsigned long>(std::numeric_limits<sqlite3_int64>::max()) + 1); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+
+            sqlite3cpp::query qry(db, "SELECT id, name, phone, -1 FROM contacts WHERE id = ?");
+            qry << myTimestamp;
+            sqlite3cpp::query::iterator it = qry.begin();
+            TEST_ASSERT(it != qry.end());
+            TEST_ASSERT_EQUALS(it->get<long>(1), myTimestamp);
+            TEST_ASSERT_EQUALS(it->get<sqlite3_int64>(1), myTimestamp);
+            TEST_ASSERT_EQUALS(it->get<unsigned long>(2), myUnsigned);
+            TEST_ASSERT_EQUALS(it->get<Kind>(3), kindSecondary);
+            TEST_ASSERT_EQUALS(it->get<short>(4), -1);
+
+            myThrown = false;
+            try { it->get<int>(1); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            myThrown = false;
+            try { it->get<unsigned int>(4); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            db.execute("DELETE FROM contacts WHERE id >= 100");
+        }
+
+        // bool is bound and fetched as integer
+        {
+            sqlite3cpp::query qry(db, "SELECT typeof(?1), ?1, typeof(:flag), :flag, 'text'");
+            qry.bind(1, true);
+            qry.bind(":flag", false);
+            sqlite3cpp::query::iterator it = qry.begin();
+            TEST_ASSERT_EQUALS(it->get<std::string>(1), "integer");
+            TEST_ASSERT_EQUALS(it->get<sqlite3_int64>(2), 1);
+            TEST_ASSERT_EQUALS(it->get<std::string>(3), "integer");
+            const bool myTrue = it->get<bool>(2);
+            const bool myFalse = it->get<bool>(4);
+            TEST_ASSERT(myTrue);
+            TEST_ASSERT(!myFalse);
+
+            // string literals are not taken for bool
+            sqlite3cpp::query myText(db, "SELECT typeof(?)");
+            myText.bind(1, "true");
+            TEST_ASSERT_EQUALS(myText.begin()->get<std::string>(1), "text");
+        }
 
         cout << "TEST OK" << endl;
         return 0;
@@ -0,0 +1,127 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppmemory.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdio>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Items (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "name TEXT NOT NULL\n"
+    ");\n"
+    "COMMIT;\n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+static void readItems(int aCount)
+{
+    sqlite3cpp::database db("test.db", "");
+    for (int i = 1; i <= aCount; ++i)
+    {
+        sqlite3cpp::query qry(db, "SELECT name FROM Items WHERE id = ?");
+        qry << i;
+        const std::string myName = qry.begin()->get<std::string>(1);
+        if (myName != "item" + std::to_string(i))
+            throw std::runtime_error("Unexpected item " + myName);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+
+        sqlite3cpp::memory_config myConfig;
+        myConfig.allocator = &sqlite3cpp::pool_allocator();
+        myConfig.lookaside_slot_size = 256;
+        myConfig.lookaside_slots = 100;
+        sqlite3cpp::configure_memory(myConfig);
+
+        {
+            sqlite3cpp::database db("test.db", SqlCreate);
+            sqlite3cpp::transaction xct(db, true);
+            sqlite3cpp::command cmd(db, "INSERT INTO Items (id, name) VALUES (?, ?)");
+            for (int i = 1; i <= 1000; ++i)
+            {
+                cmd << i << "item" + std::to_string(i);
+                cmd.execute();
+                cmd.reset(sqlite3cpp::clearBindingsOn);
+            }
+        }
+
+        // the memory can be configured only before SQLite is initialized
+        bool myThrown = false;
+        try { sqlite3cpp::configure_memory(sqlite3cpp::memory_config()); }
+        catch (sqlite3cpp::database_error&) { myThrown = true; }
+        TEST_ASSERT(myThrown);
+
+        // concurrent connections allocate from the pool
+        std::vector<std::thread> myThreads;
+        for (int i = 0; i < 4; ++i)
+            myThreads.push_back(std::thread(readItems, 1000));
+        for (size_t i = 0; i < myThreads.size(); ++i)
+            myThreads[i].join();
+
+        const sqlite3cpp::pool_allocator_stats myPoolStats = sqlite3cpp::get_pool_allocator_stats();
+        TEST_ASSERT(myPoolStats.system_allocations > 0);
+        TEST_ASSERT(myPoolStats.pooled_bytes > 0);
+        // exiting threads return their cached blocks to the shared lists
+        TEST_ASSERT(myPoolStats.transfers >= 4);
+
+        // process memory status
+        {
+            sqlite3cpp::database db("test.db", "");
+            const sqlite3cpp::memory_status myStatus = sqlite3cpp::get_memory_status();
+            TEST_ASSERT(myStatus.memory_used > 0);
+            TEST_ASSERT(myStatus.memory_highwater >= myStatus.memory_used);
+            TEST_ASSERT(myStatus.malloc_count > 0);
+            TEST_ASSERT(myStatus.largest_malloc > 0);
+            const sqlite3cpp::memory_status myResetStatus = sqlite3cpp::get_memory_status(true);
+            TEST_ASSERT(myResetStatus.memory_highwater >= myResetStatus.memory_used);
+            TEST_ASSERT(sqlite3cpp::get_memory_status().memory_highwater <= myStatus.memory_highwater);
+        }
+
+        // per-connection lookaside
+        {
+            sqlite3cpp::open_options myOptions;
+            myOptions.lookaside_slot_size = 512;
+            myOptions.lookaside_slots = 200;
+            sqlite3cpp::database db("test.db", "", "", myOptions);
+            sqlite3cpp::query qry(db, "SELECT count(*) FROM Items WHERE name LIKE 'item%'");
+            const int myCount = qry.begin()->get<int>(1);
+            TEST_ASSERT_EQUALS(myCount, 1000);
+            // SQLite may be built without lookaside, the configuration is accepted and ignored then
+            const bool myLookaside = !sqlite3_compileoption_used("OMIT_LOOKASIDE");
+            const sqlite3cpp::connection_memory_status myStatus = db.get_memory_status(true);
+            TEST_ASSERT(!myLookaside || myStatus.lookaside_hits > 0);
+            TEST_ASSERT(!myLookaside || myStatus.lookaside_highwater > 0);
+            TEST_ASSERT(myStatus.lookaside_highwater <= 200);
+            TEST_ASSERT(myStatus.cache_used > 0);
+            TEST_ASSERT(myStatus.schema_used > 0);
+            TEST_ASSERT(myStatus.statements_used > 0);
+            TEST_ASSERT_EQUALS(db.get_memory_status().lookaside_hits, 0);
+
+            myOptions.lookaside_slots = 0;
+            sqlite3cpp::database myNoLookaside("test.db", "", "", myOptions);
+            sqlite3cpp::query qry2(myNoLookaside, "SELECT count(*) FROM Items");
+            qry2.begin();
+            TEST_ASSERT_EQUALS(myNoLookaside.get_memory_status().lookaside_hits, 0);
+        }
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,108 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cpppool.h"
+#include "boost/format.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdio>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Contacts (\n"
+    "id INTEGER PRIMARY KEY AUTOINCREMENT,\n"
+    "name char (128) NOT NULL,\n"
+    "phone char(67) NULL\n"
+    ");\n"
+    "COMMIT;\n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        const size_t myReaders = 4;
+        sqlite3cpp::connection_pool pool("test.db", SqlCreate, myReaders);
+
+        {
+            sqlite3cpp::connection_pool::handle writer = pool.acquire_writer();
+            sqlite3cpp::transaction xct(*writer);
+            sqlite3cpp::command cmd(*writer, "INSERT INTO contacts (name, phone) VALUES (?, ?)");
+            for (int i = 1; i <= 100; ++i)
+            {
+                cmd << str(boost::format("name_%d") % i) << str(boost::format("%04d") % i);
+                cmd.execute();
+                cmd.reset(sqlite3cpp::clearBindingsOn);
+            }
+            xct.commit();
+        }
+
+        // concurrent readers
+        {
+            std::atomic<int> myErrors(0);
+            std::vector<std::thread> myThreads;
+            for (size_t t = 0; t < myReaders * 2; ++t)
+            {
+                myThreads.push_back(std::thread([&pool, &myErrors]()
+                {
+                    try
+                    {
+                        for (int i = 1; i <= 100; ++i)
+                        {
+                            sqlite3cpp::connection_pool::handle reader = pool.acquire_reader();
+                            sqlite3cpp::query qry(*reader, "SELECT name FROM contacts WHERE id = ?");
+                            qry << i;
+                            sqlite3cpp::query::iterator it = qry.begin();
+                            if (it == qry.end() || it->get<std::string>(1) != str(boost::format("name_%d") % i))
+                                ++myErrors;
+                        }
+                    }
+                    catch (std::exception&)
+                    {
+                        ++myErrors;
+                    }
+                }));
+            }
+            for (size_t t = 0; t < myThreads.size(); ++t)
+                myThreads[t].join();
+
+            TEST_ASSERT_EQUALS(myErrors, 0);
+            const sqlite3cpp::connection_pool_stats myStats = pool.get_stats();
+            TEST_ASSERT_EQUALS(myStats.reader.checkouts, 800);
+            TEST_ASSERT_EQUALS(myStats.idle_readers, myReaders);
+        }
+
+        // readers are read-only
+        {
+            sqlite3cpp::connection_pool::handle reader = pool.acquire_reader();
+            bool myThrown = false;
+            try { reader->execute("DELETE FROM contacts"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
+        // timeout waiting for the busy writer
+        {
+            sqlite3cpp::connection_pool::handle writer = pool.acquire_writer();
+            bool myThrown = false;
+            try { pool.acquire_writer(50); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT_EQUALS(pool.get_stats().writer.timeouts, 1);
+        }
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
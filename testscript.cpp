@@ -0,0 +1,151 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cppscript.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <cstdio>
+
+static const std::string Fixture =
+    "-- test fixture\n"
+    "DROP TABLE IF EXISTS Items;\n"
+    "CREATE TABLE Items (id INTEGER PRIMARY KEY, name TEXT NOT NULL, data BLOB);\n"
+    "INSERT INTO Items (id, name, data) VALUES (:id, :name, :data);\n"
+    "INSERT INTO Items (name) SELECT name || '-copy' FROM Items;\n"
+    "SELECT id, name FROM Items WHERE name <> :name;\n"
+    "/* trailing comment */  \n";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+static int countItems(sqlite3cpp::database& db)
+{
+    sqlite3cpp::query qry(db, "SELECT count(*) FROM Items");
+    return qry.begin()->get<int>(1);
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        sqlite3cpp::database db("test.db", "");
+
+        sqlite3cpp::script fixture(db, Fixture);
+        TEST_ASSERT_EQUALS(fixture.size(), 0U);
+
+        sqlite3cpp::script_params myParams;
+        myParams.push_back(std::make_pair(":id", sqlite3cpp::script_param(7)));
+        myParams.push_back(std::make_pair(":name", sqlite3cpp::script_param(std::string("first"))));
+        myParams.push_back(std::make_pair(":data", sqlite3cpp::script_param(std::vector<char>(3, 'x'))));
+
+        // the statements are prepared as they are reached, so they may use the table created before
+        fixture.execute(myParams);
+        TEST_ASSERT_EQUALS(fixture.size(), 5U);
+        const std::vector<sqlite3cpp::script_statement_result>& myResults = fixture.get_results();
+        TEST_ASSERT_EQUALS(myResults.size(), 5U);
+        TEST_ASSERT_EQUALS(myResults[1].sql, "CREATE TABLE Items (id INTEGER PRIMARY KEY, name TEXT NOT NULL, data BLOB);");
+        TEST_ASSERT_EQUALS(myResults[2].changes, 1);
+        TEST_ASSERT_EQUALS(myResults[3].changes, 1);
+        TEST_ASSERT_EQUALS(myResults[4].changes, 0);
+        TEST_ASSERT_EQUALS(myResults[4].rows, 1U);
+        TEST_ASSERT(myResults[3].elapsed_sec >= 0);
+        {
+            sqlite3cpp::query qry(db, "SELECT name, length(data) FROM Items WHERE id = 7");
+            sqlite3cpp::query::iterator it = qry.begin();
+            TEST_ASSERT_EQUALS(it->get<std::string>(1), "first");
+            TEST_ASSERT_EQUALS(it->get<int>(2), 3);
+        }
+
+        // re-executed with another parameter set, the prepared statements are reused
+        myParams[1].second = std::string("second");
+        myParams.pop_back();
+        fixture.execute(myParams);
+        TEST_ASSERT_EQUALS(fixture.size(), 5U);
+        TEST_ASSERT_EQUALS(countItems(db), 2);
+        {
+            sqlite3cpp::query qry(db, "SELECT name, data IS NULL FROM Items WHERE id = 7");
+            sqlite3cpp::query::iterator it = qry.begin();
+            TEST_ASSERT_EQUALS(it->get<std::string>(1), "second");
+            TEST_ASSERT_EQUALS(it->get<int>(2), 1);
+        }
+
+        // an execution stops at the first failed statement
+        {
+            sqlite3cpp::script myScript(db, "DELETE FROM Items WHERE id = 7; INSERT INTO Items (id, name) VALUES (8, NULL); DELETE FROM Items");
+            bool myThrown = false;
+            try { myScript.execute(); }
+            catch (sqlite3cpp::database_error& e)
+            {
+                myThrown = true;
+                TEST_ASSERT_EQUALS(e.sql(), "INSERT INTO Items (id, name) VALUES (8, NULL);");
+                TEST_ASSERT_EQUALS(e.extended_code(), SQLITE_CONSTRAINT_NOTNULL);
+            }
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT_EQUALS(myScript.get_results().size(), 1U);
+            TEST_ASSERT_EQUALS(countItems(db), 1);
+
+            // a script with a syntax error fails when the execution reaches it
+            sqlite3cpp::script myInvalid(db, "DELETE FROM Items; DELETE FROM;");
+            myThrown = false;
+            try { myInvalid.execute(); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT_EQUALS(myInvalid.size(), 1U);
+            TEST_ASSERT_EQUALS(countItems(db), 0);
+        }
+
+        // statements of scripts are profiled like any other
+        {
+            db.enable_profiling();
+            std::vector<std::string> mySlow;
+            db.set_slow_query_callback(0, [&mySlow](const sqlite3cpp::statement_execution& anExecution) { mySlow.push_back(anExecution.sql); });
+            sqlite3cpp::script myScript(db, "INSERT OR REPLACE INTO Items (id, name) VALUES (10, 'a'), (11, 'b'); SELECT id FROM Items ORDER BY name");
+            myScript.execute();
+            myScript.execute();
+            TEST_ASSERT_EQUALS(mySlow.size(), 4U);
+            TEST_ASSERT_EQUALS(mySlow[1], "SELECT id FROM Items ORDER BY name");
+
+            const std::vector<sqlite3cpp::statement_profile> myProfile = db.get_profile();
+            size_t mySelects = 0;
+            for (size_t i = 0; i < myProfile.size(); ++i)
+            {
+                if (myProfile[i].sql == "SELECT id FROM Items ORDER BY name")
+                {
+                    ++mySelects;
+                    TEST_ASSERT_EQUALS(myProfile[i].executions, 2U);
+                    TEST_ASSERT_EQUALS(myProfile[i].rows, 4U);
+                    TEST_ASSERT(myProfile[i].sorts > 0);
+                }
+            }
+            TEST_ASSERT_EQUALS(mySelects, 1U);
+            const std::vector<sqlite3cpp::script_statement_result>& myResults = myScript.get_results();
+            TEST_ASSERT_EQUALS(myResults[1].rows, 2U);
+            db.enable_profiling(false);
+            db.execute("DELETE FROM Items WHERE id >= 10");
+        }
+
+        // scripts are movable
+        {
+            sqlite3cpp::script myEmpty(db, " -- nothing to do\n");
+            myEmpty.execute();
+            TEST_ASSERT_EQUALS(myEmpty.size(), 0U);
+
+            sqlite3cpp::script myMoved = std::move(fixture);
+            TEST_ASSERT_EQUALS(fixture.size(), 0U);
+            myMoved.execute(myParams);
+            TEST_ASSERT_EQUALS(myMoved.size(), 5U);
+            TEST_ASSERT_EQUALS(countItems(db), 2);
+        }
+
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}
@@ -1,22 +1,31 @@
 #include "sqlite3cpp.h"
+#include "sqlite3cpptyped.h"
 
 #include "boost/format.hpp"
 #include "boost/assign/list_of.hpp"
 #include "boost/foreach.hpp"
+#include "boost/fusion/include/adapt_struct.hpp"
 #include <string>
 #include <map>
+#include <tuple>
+#include <vector>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <cstdio>
+#include <thread>
+#include <chrono>
 
 struct ContactInfo
 {
-    ContactInfo();
+    ContactInfo() {}
     ContactInfo(const std::string& aName, const std::string aPhone): name(aName), phone(aPhone) {}
     std::string name;
     std::string phone;
 };
 
+BOOST_FUSION_ADAPT_STRUCT(ContactInfo, (std::string, name) (std::string, phone))
+
 typedef std::map<int, ContactInfo> Contacts;
 static const Contacts theContacts = boost::assign::map_list_of(1, ContactInfo("Andrei", "06101"))
                                     (2, ContactInfo("Veronica", "06102"))
@@ -51,6 +60,7 @@ static ContactInfo getContact(const int id)
 }
 
 
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
 #define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
 
 using std::cout;
@@ -93,6 +103,417 @@ int main(int argc, char* argv[])
             ++idx;
         }
 
+        // prepared statements are reused from the statement cache
+        {
+            const sqlite3cpp::statement_cache_stats myStatsBefore = db.get_statement_cache_stats();
+            for (int i = 1; i <= 3; ++i)
+            {
+                sqlite3cpp::query qry2(db, "SELECT name FROM contacts WHERE id = ?");
+                qry2 << i;
+                sqlite3cpp::query::iterator it = qry2.begin();
+                TEST_ASSERT_EQUALS(it->get<std::string>(1), getContact(i).name);
+            }
+            const sqlite3cpp::statement_cache_stats myStatsAfter = db.get_statement_cache_stats();
+            TEST_ASSERT_EQUALS(myStatsAfter.misses - myStatsBefore.misses, 1U);
+            TEST_ASSERT_EQUALS(myStatsAfter.hits - myStatsBefore.hits, 2U);
+
+            db.set_statement_cache_capacity(0);
+            TEST_ASSERT_EQUALS(db.get_statement_cache_stats().size, 0U);
+            db.set_statement_cache_capacity(sqlite3cpp::database::DefaultStatementCacheCapacity);
+        }
+
+        // columnar batch fetch
+        {
+            sqlite3cpp::query qry2(db, "SELECT id, name, NULL FROM contacts ORDER BY id");
+            sqlite3cpp::column_batch myBatch;
+            int rec_count = 0;
+            std::vector<size_t> myBatchSizes;
+            qry2.reset();
+            while (size_t myRows = qry2.fetch_batch(myBatch, 2))
+            {
+                myBatchSizes.push_back(myRows);
+                TEST_ASSERT_EQUALS(myBatch.columns(), 3U);
+                TEST_ASSERT_EQUALS(myBatch.get_column(1).type, sqlite3cpp::columnInteger);
+                TEST_ASSERT_EQUALS(myBatch.get_column(2).type, sqlite3cpp::columnText);
+                for (size_t i = 0; i < myRows; ++i)
+                {
+                    ++rec_count;
+                    TEST_ASSERT_EQUALS(myBatch.get_column(1).integers[i], rec_count);
+                    TEST_ASSERT_EQUALS(myBatch.text(2, i), getContact(rec_count).name);
+                    TEST_ASSERT(!myBatch.is_null(2, i));
+                    TEST_ASSERT(myBatch.is_null(3, i));
+                }
+            }
+            TEST_ASSERT_EQUALS(rec_count, 3);
+            TEST_ASSERT_EQUALS(myBatchSizes.size(), 2U);
+            TEST_ASSERT_EQUALS(myBatchSizes[0], 2U);
+            TEST_ASSERT_EQUALS(myBatchSizes[1], 1U);
+
+            bool myThrown = false;
+            try { myBatch.is_null(1, 0); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            myThrown = false;
+            try { myBatch.text(2, 1); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+
+            // the batch reused for a query with the same number of columns of other types
+            sqlite3cpp::query qry3(db, "SELECT name, id, 1.5 FROM contacts ORDER BY id");
+            const size_t myRows = qry3.fetch_batch(myBatch, 10);
+            TEST_ASSERT_EQUALS(myRows, 3U);
+            TEST_ASSERT_EQUALS(myBatch.get_column(1).type, sqlite3cpp::columnText);
+            TEST_ASSERT_EQUALS(myBatch.get_column(2).type, sqlite3cpp::columnInteger);
+            TEST_ASSERT_EQUALS(myBatch.get_column(3).type, sqlite3cpp::columnReal);
+            TEST_ASSERT_EQUALS(myBatch.text(1, 2), getContact(3).name);
+            TEST_ASSERT_EQUALS(myBatch.get_column(2).integers[2], 3);
+            TEST_ASSERT_EQUALS(myBatch.get_column(3).reals[0], 1.5);
+            TEST_ASSERT(!myBatch.get_column(3).mixed);
+        }
+
+        // columnar batch fetch of columns mixing storage classes
+        {
+            db.execute("CREATE TEMP TABLE Mixed(num, txt TEXT, ival INTEGER, late)");
+            db.execute("INSERT INTO Mixed VALUES(1, 'one', 1, NULL)");
+            db.execute("INSERT INTO Mixed VALUES(2.5, 2, 9007199254740993, NULL)");
+            db.execute("INSERT INTO Mixed VALUES(NULL, x'00ff', 3.5, 4)");
+            {
+                sqlite3cpp::query qry2(db, "SELECT num, txt, ival, late FROM Mixed ORDER BY rowid");
+                sqlite3cpp::column_batch myBatch;
+                const size_t myRows = qry2.fetch_batch(myBatch, 10);
+                TEST_ASSERT_EQUALS(myRows, 3U);
+
+                // integer promoted to real
+                const sqlite3cpp::column_batch::column& myNum = myBatch.get_column(1);
+                TEST_ASSERT_EQUALS(myNum.type, sqlite3cpp::columnReal);
+                TEST_ASSERT(myNum.mixed);
+                TEST_ASSERT_EQUALS(myNum.reals[0], 1.0);
+                TEST_ASSERT_EQUALS(myNum.reals[1], 2.5);
+                TEST_ASSERT(myBatch.is_null(1, 2));
+
+                // text keeps the bytes of an integer and a BLOB
+                const sqlite3cpp::column_batch::column& myTxt = myBatch.get_column(2);
+                TEST_ASSERT_EQUALS(myTxt.type, sqlite3cpp::columnText);
+                TEST_ASSERT(myTxt.mixed);
+                TEST_ASSERT_EQUALS(myBatch.text(2, 1), "2");
+                TEST_ASSERT_EQUALS(myBatch.text(2, 2), std::string("\x00\xff", 2));
+
+                // integer not exact as double falls back to text
+                const sqlite3cpp::column_batch::column& myIval = myBatch.get_column(3);
+                TEST_ASSERT_EQUALS(myIval.type, sqlite3cpp::columnText);
+                TEST_ASSERT(myIval.mixed);
+                TEST_ASSERT_EQUALS(myBatch.text(3, 0), "1");
+                TEST_ASSERT_EQUALS(myBatch.text(3, 1), "9007199254740993");
+                TEST_ASSERT_EQUALS(myBatch.text(3, 2), "3.5");
+
+                // NULLs only are retyped by the first value
+                const sqlite3cpp::column_batch::column& myLate = myBatch.get_column(4);
+                TEST_ASSERT_EQUALS(myLate.type, sqlite3cpp::columnInteger);
+                TEST_ASSERT(!myLate.mixed);
+                TEST_ASSERT(myBatch.is_null(4, 0));
+                TEST_ASSERT(myBatch.is_null(4, 1));
+                TEST_ASSERT_EQUALS(myLate.integers[2], 4);
+            }
+            db.execute("DROP TABLE Mixed");
+        }
+
+        // statically typed query
+        {
+            sqlite3cpp::typed_query<std::tuple<int, std::string, std::string>, int> qry2(db, "SELECT id, name, phone FROM contacts WHERE id >= ?");
+            qry2.execute(2);
+            std::tuple<int, std::string, std::string> myRow;
+            int rec_count = 0;
+            while (qry2.fetch(myRow))
+            {
+                ++rec_count;
+                TEST_ASSERT_EQUALS(std::get<0>(myRow), rec_count + 1);
+                TEST_ASSERT_EQUALS(std::get<1>(myRow), getContact(std::get<0>(myRow)).name);
+                TEST_ASSERT_EQUALS(std::get<2>(myRow), getContact(std::get<0>(myRow)).phone);
+            }
+            TEST_ASSERT_EQUALS(rec_count, 2);
+
+            sqlite3cpp::typed_query<ContactInfo, int> qry3(db, "SELECT name, phone FROM contacts WHERE id = ?");
+            qry3.execute(3);
+            rec_count = 0;
+            for (sqlite3cpp::typed_query<ContactInfo, int>::iterator it = qry3.begin(); it != qry3.end(); ++it)
+            {
+                TEST_ASSERT_EQUALS(it->name, getContact(3).name);
+                TEST_ASSERT_EQUALS(it->phone, getContact(3).phone);
+                ++rec_count;
+            }
+            TEST_ASSERT_EQUALS(rec_count, 1);
+
+            // mismatching column count and type
+            bool myThrown = false;
+            try { sqlite3cpp::typed_query<std::tuple<int, std::string> > qry4(db, "SELECT id FROM contacts"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            myThrown = false;
+            try { sqlite3cpp::typed_query<std::tuple<int> > qry4(db, "SELECT name FROM contacts"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+
+            sqlite3cpp::typed_command<std::string, std::string> cmd(db, "UPDATE contacts SET phone = ? WHERE name = ?");
+            cmd.execute("06100", getContact(1).name);
+            sqlite3cpp::typed_query<std::tuple<std::string>, int> qry5(db, "SELECT phone FROM contacts WHERE id = ?");
+            qry5.execute(1);
+            TEST_ASSERT_EQUALS(std::get<0>(*qry5.begin()), "06100");
+            cmd.execute(getContact(1).phone, getContact(1).name);
+        }
+
+        // open options
+        {
+            ::remove("testoptions.db");
+
+            sqlite3cpp::open_options myOptions;
+            myOptions.flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX;
+            myOptions.busy_timeout_ms = 1000;
+            myOptions.page_size = 8192;
+            myOptions.journal_mode = sqlite3cpp::journalWal;
+            myOptions.synchronous = sqlite3cpp::synchronousNormal;
+            myOptions.cache_size = -4000;
+            myOptions.temp_store = sqlite3cpp::tempStoreMemory;
+            sqlite3cpp::database db2("testoptions.db", getSqlCreate(), "", myOptions);
+
+            const sqlite3cpp::open_options& myEffective = db2.get_open_options();
+            TEST_ASSERT_EQUALS(myEffective.flags, myOptions.flags);
+            TEST_ASSERT_EQUALS(*myEffective.busy_timeout_ms, 1000);
+            TEST_ASSERT_EQUALS(*myEffective.page_size, 8192);
+            TEST_ASSERT_EQUALS(*myEffective.journal_mode, sqlite3cpp::journalWal);
+            TEST_ASSERT_EQUALS(*myEffective.synchronous, sqlite3cpp::synchronousNormal);
+            TEST_ASSERT_EQUALS(*myEffective.cache_size, -4000);
+            TEST_ASSERT_EQUALS(*myEffective.temp_store, sqlite3cpp::tempStoreMemory);
+
+            sqlite3cpp::query qry2(db2, "SELECT COUNT(*) FROM contacts");
+            TEST_ASSERT_EQUALS(qry2.begin()->get<int>(1), 3);
+        }
+        ::remove("testoptions.db");
+
+        // profiling
+        {
+            const std::string mySql = "SELECT id, name FROM contacts WHERE id >= ? ORDER BY name";
+            TEST_ASSERT(!db.is_profiling_enabled());
+            db.enable_profiling();
+            std::vector<sqlite3cpp::statement_execution> mySlowQueries;
+            db.set_slow_query_callback(0, [&mySlowQueries](const sqlite3cpp::statement_execution& anExecution) { mySlowQueries.push_back(anExecution); });
+
+            db.clear_statement_cache();
+            for (int i = 1; i <= 3; ++i)
+            {
+                sqlite3cpp::query qry2(db, mySql);
+                qry2 << i;
+                int rec_count = 0;
+                for (sqlite3cpp::query::iterator it = qry2.begin(); it != qry2.end(); ++it)
+                    ++rec_count;
+                TEST_ASSERT_EQUALS(rec_count, 4 - i);
+            }
+            db.execute("UPDATE contacts SET phone = phone");
+
+            std::vector<sqlite3cpp::statement_profile> myProfile = db.get_profile();
+            TEST_ASSERT_EQUALS(myProfile.size(), 2);
+            const sqlite3cpp::statement_profile& myQueryProfile = (myProfile[0].sql == mySql) ? myProfile[0] : myProfile[1];
+            TEST_ASSERT_EQUALS(myQueryProfile.sql, mySql);
+            TEST_ASSERT_EQUALS(myQueryProfile.prepares, 1);
+            TEST_ASSERT_EQUALS(myQueryProfile.executions, 3);
+            TEST_ASSERT_EQUALS(myQueryProfile.rows, 3 + 2 + 1);
+            TEST_ASSERT_EQUALS(myQueryProfile.steps, myQueryProfile.rows + 3);
+            TEST_ASSERT_EQUALS(myQueryProfile.sorts, 3);
+            TEST_ASSERT(myQueryProfile.vm_steps > 0);
+            TEST_ASSERT(myQueryProfile.total_sec > 0);
+            TEST_ASSERT(myQueryProfile.p50_sec > 0 && myQueryProfile.p50_sec <= myQueryProfile.p99_sec);
+            TEST_ASSERT(myQueryProfile.p99_sec <= myQueryProfile.max_sec);
+            TEST_ASSERT_EQUALS(mySlowQueries.size(), 4);
+            TEST_ASSERT_EQUALS(mySlowQueries.back().sql, "UPDATE contacts SET phone = phone");
+
+            std::ostringstream myJson;
+            db.export_profile(myJson);
+            TEST_ASSERT(myJson.str().find("\"sql\": \"UPDATE contacts SET phone = phone\"") != std::string::npos);
+
+            // time spent waiting for a lock held by another connection
+            sqlite3cpp::database db2("test.db", "");
+            db2.enable_profiling();
+            db2.set_busy_timeout(50);
+            db.execute("BEGIN EXCLUSIVE");
+            bool myThrown = false;
+            try { db2.execute("UPDATE contacts SET phone = phone"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            db.execute("COMMIT");
+            TEST_ASSERT(myThrown);
+            myProfile = db2.get_profile();
+            TEST_ASSERT_EQUALS(myProfile.size(), 1);
+            TEST_ASSERT(myProfile[0].lock_wait_sec >= 0.04);
+
+            db.reset_profile();
+            TEST_ASSERT(db.get_profile().empty());
+            db.enable_profiling(false);
+            db.execute("UPDATE contacts SET phone = phone");
+            TEST_ASSERT(db.get_profile().empty());
+        }
+
+        // retry of statements failed with SQLITE_BUSY
+        {
+            sqlite3cpp::database db2("test.db", "");
+            db2.set_busy_timeout(0);
+            sqlite3cpp::retry_policy myPolicy;
+            myPolicy.max_retries = 1000;
+            myPolicy.max_delay_ms = 5;
+            db2.set_retry_policy(myPolicy);
+
+            db.execute("BEGIN IMMEDIATE");
+            std::thread myReleaser([&db]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                db.execute("COMMIT");
+            });
+            db2.execute("UPDATE contacts SET phone = phone");
+            sqlite3cpp::command myCmd(db2, "UPDATE contacts SET phone = ? WHERE id = 1");
+            myCmd.bind(1, "06101");
+            myCmd.execute();
+            myReleaser.join();
+            sqlite3cpp::retry_stats myStats = db2.get_retry_stats();
+            TEST_ASSERT(myStats.busy > 0);
+            TEST_ASSERT_EQUALS(myStats.failures, 0);
+            TEST_ASSERT(myStats.wait_sec > 0.01);
+            TEST_ASSERT(myStats.max_wait_sec <= myStats.wait_sec);
+
+            // give up at the deadline
+            myPolicy.deadline_ms = 20;
+            db2.set_retry_policy(myPolicy);
+            db.execute("BEGIN IMMEDIATE");
+            bool myThrown = false;
+            try { myCmd.execute(); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            myStats = db2.get_retry_stats();
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT_EQUALS(myStats.failures, 1);
+            TEST_ASSERT(myStats.max_wait_sec >= 0.015);
+
+            // not retried within an explicit transaction, which may hold locks the other connection waits for
+            db2.execute("BEGIN");
+            const sqlite3_int64 myBusy = myStats.busy;
+            myThrown = false;
+            try { db2.execute("UPDATE contacts SET phone = phone"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            db2.execute("ROLLBACK");
+            db.execute("COMMIT");
+            myStats = db2.get_retry_stats();
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT_EQUALS(myStats.busy, myBusy);
+            TEST_ASSERT_EQUALS(myStats.failures, 1);
+        }
+
+        // online backup and in-memory snapshot
+        {
+            db.execute("CREATE TABLE Bulk (id INTEGER PRIMARY KEY, data TEXT)");
+            db.execute("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 2000) "
+                       "INSERT INTO Bulk SELECT i, printf('%0500d', i) FROM n");
+
+            ::remove("testbackup.db");
+            int mySteps = 0;
+            int myLastRemaining = -1;
+            db.backup_to("testbackup.db", 10, 0, [&mySteps, &myLastRemaining](int aRemaining, int aTotal)
+            {
+                ++mySteps;
+                myLastRemaining = aRemaining;
+                if (aRemaining > aTotal)
+                    throw std::logic_error("Invalid backup progress");
+            });
+            TEST_ASSERT(mySteps > 10);
+            TEST_ASSERT_EQUALS(myLastRemaining, 0);
+            {
+                sqlite3cpp::database myBackup("testbackup.db", "");
+                sqlite3cpp::query qry(myBackup, "SELECT count(*) FROM Bulk");
+                const int myCount = qry.begin()->get<int>(1);
+                TEST_ASSERT_EQUALS(myCount, 2000);
+            }
+
+            // aborted by the progress callback, the target file is left untouched
+            bool myThrown = false;
+            db.execute("DELETE FROM Bulk WHERE id > 1000");
+            try
+            {
+                db.backup_to("testbackup.db", 10, 0, [](int aRemaining, int aTotal)
+                {
+                    if (aRemaining < aTotal / 2)
+                        throw std::runtime_error("Cancelled");
+                });
+            }
+            catch (std::runtime_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            {
+                sqlite3cpp::database myBackup("testbackup.db", "");
+                sqlite3cpp::query qry(myBackup, "SELECT count(*) FROM Bulk");
+                const int myCount = qry.begin()->get<int>(1);
+                TEST_ASSERT_EQUALS(myCount, 2000);
+            }
+            ::remove("testbackup.db");
+
+            sqlite3cpp::database mySnapshot;
+            db.snapshot_to(mySnapshot);
+            db.execute("DELETE FROM Bulk");
+            sqlite3cpp::query qry(mySnapshot, "SELECT count(*) FROM Bulk");
+            const int myCount = qry.begin()->get<int>(1);
+            TEST_ASSERT_EQUALS(myCount, 1000);
+            myThrown = false;
+            try { mySnapshot.execute("DELETE FROM Bulk"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            db.execute("DROP TABLE Bulk");
+        }
+
+        // prepared statements, transactions and connections are movable
+        {
+            std::vector<sqlite3cpp::query> myQueries;
+            for (int i = 1; i <= 3; ++i)
+            {
+                myQueries.push_back(sqlite3cpp::query(db, "SELECT name FROM contacts WHERE id = ?"));
+                myQueries.back() << i;
+            }
+            for (int i = 1; i <= 3; ++i)
+            {
+                const std::string myName = myQueries[i - 1].begin()->get<std::string>(1);
+                TEST_ASSERT_EQUALS(myName, getContact(i).name);
+            }
+            sqlite3cpp::query myQuery = std::move(myQueries[0]);
+            myQueries[0] = std::move(myQueries[2]);
+            myQueries.pop_back();
+            TEST_ASSERT_EQUALS(myQueries[0].begin()->get<std::string>(1), getContact(3).name);
+            TEST_ASSERT_EQUALS(myQuery.begin()->get<std::string>(1), getContact(1).name);
+
+            {
+                sqlite3cpp::transaction myXct(db);
+                db.execute("DELETE FROM contacts");
+                sqlite3cpp::transaction myMovedXct = std::move(myXct);
+                myMovedXct.rollback();
+            }
+            sqlite3cpp::query myCount(db, "SELECT count(*) FROM contacts");
+            const int myContacts = myCount.begin()->get<int>(1);
+            TEST_ASSERT_EQUALS(myContacts, 3);
+        }
+        {
+            sqlite3cpp::database mySource("test.db", "");
+            mySource.enable_profiling();
+            {
+                sqlite3cpp::query qry(mySource, "SELECT count(*) FROM contacts");
+                qry.begin();
+            }
+            std::vector<sqlite3cpp::database> myDbs;
+            myDbs.push_back(std::move(mySource));
+            myDbs.push_back(sqlite3cpp::database("test.db", ""));
+            sqlite3cpp::database& myDb = myDbs[0];
+            TEST_ASSERT(myDb.is_profiling_enabled());
+            TEST_ASSERT_EQUALS(myDb.get_statement_cache_stats().size, 1U);
+            sqlite3cpp::query qry(myDb, "SELECT count(*) FROM contacts");
+            const int myContacts = qry.begin()->get<int>(1);
+            TEST_ASSERT_EQUALS(myContacts, 3);
+            TEST_ASSERT_EQUALS(myDb.get_statement_cache_stats().hits, 1U);
+            TEST_ASSERT(!mySource.is_profiling_enabled());
+            bool myThrown = false;
+            try { mySource.execute("SELECT 1"); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
         cout << "TEST OK" << endl;
         return 0;
     }
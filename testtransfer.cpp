@@ -0,0 +1,199 @@
+#include "sqlite3cpp.h"
+#include "sqlite3cpptransfer.h"
+#include "boost/format.hpp"
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+
+static const std::string SqlCreate =
+    "BEGIN TRANSACTION;\n"
+    "CREATE TABLE Source (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "value INTEGER,\n"
+    "score REAL,\n"
+    "name TEXT,\n"
+    "data BLOB\n"
+    ");\n"
+    "CREATE TABLE Target (\n"
+    "id INTEGER PRIMARY KEY,\n"
+    "value INTEGER,\n"
+    "score REAL,\n"
+    "name TEXT,\n"
+    "data BLOB\n"
+    ");\n"
+    "COMMIT;\n";
+
+static const std::string SqlSelect = "SELECT id, value, score, name, data FROM Source ORDER BY id";
+static const std::string SqlInsert = "INSERT INTO Target (id, value, score, name, data) VALUES (?, ?, ?, ?, ?)";
+
+#define TEST_ASSERT(condition) if (!(condition)) { std::cerr << "TEST ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\n" << #condition << "\n"; throw std::runtime_error("TEST FAILED");}
+#define TEST_ASSERT_EQUALS(actual, expected) if (actual != expected) { std::cerr << "TEST EQUALITY ASSERTION FAILED at " << __FILE__  << ":" <<__LINE__ << "\nActual: " << actual << "\nExpected: " << expected << "\n"; throw std::runtime_error("TEST FAILED");}
+
+using std::cout;
+using std::endl;
+
+// count rows of Target equal to the ones of Source, BLOBs are compared only if they are expected to survive
+static int countEqualRows(sqlite3cpp::database& db, bool aCompareBlobs)
+{
+    sqlite3cpp::query qry(db, std::string("SELECT count(*) FROM Source s JOIN Target t ON s.id = t.id "
+                                          "WHERE s.value IS t.value AND s.score IS t.score AND s.name IS t.name")
+                          + (aCompareBlobs ? " AND s.data IS t.data" : ""));
+    return qry.begin()->get<int>(1);
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        ::remove("test.db");
+        sqlite3cpp::database db("test.db", SqlCreate);
+
+        const int myRows = 5000;
+        {
+            sqlite3cpp::transaction xct(db);
+            sqlite3cpp::command cmd(db, "INSERT INTO Source (id, value, score, name, data) VALUES (?, ?, ?, ?, ?)");
+            for (int i = 1; i <= myRows; ++i)
+            {
+                cmd.bind(1, i);
+                if (i % 7 == 0)
+                    cmd.bind(2);
+                else
+                    cmd.bind(2, (i % 2 ? -1 : 1) * (sqlite3_int64(i) << 40));
+                cmd.bind(3, i / 3.0);
+                switch (i % 5)
+                {
+                case 0: cmd.bind(4); break;
+                case 1: cmd.bind(4, boost::string_view("")); break;
+                case 2: cmd.bind(4, str(boost::format("quoted \"name\", %d\r\nsecond line") % i)); break;
+                default: cmd.bind(4, str(boost::format("name_%d") % i)); break;
+                }
+                const std::string myBlob(i % 10, static_cast<char>(i));
+                cmd.bind(5, sqlite3cpp::blob_view(myBlob.data(), myBlob.size()));
+                cmd.execute();
+                cmd.reset();
+            }
+            xct.commit();
+        }
+
+        // columnar round trip is lossless
+        {
+            sqlite3cpp::table_exporter exporter(db, SqlSelect, 1000);
+            const sqlite3cpp::transfer_stats myExportStats = exporter.export_to("test.col", sqlite3cpp::formatColumnar);
+            TEST_ASSERT_EQUALS(myExportStats.rows, myRows);
+            TEST_ASSERT_EQUALS(myExportStats.chunks, 5);
+
+            sqlite3cpp::table_importer importer(db, SqlInsert, 3, 1234);
+            importer.set_chunk_size(4096);
+            const sqlite3cpp::transfer_stats myImportStats = importer.import_from("test.col", sqlite3cpp::formatColumnar);
+            TEST_ASSERT_EQUALS(myImportStats.rows, myRows);
+            TEST_ASSERT_EQUALS(myImportStats.bytes, myExportStats.bytes);
+            const int myEqual = countEqualRows(db, true);
+            TEST_ASSERT_EQUALS(myEqual, myRows);
+            db.execute("DELETE FROM Target");
+        }
+
+        // columnar export of a column mixing storage classes fails, NULLs mix with any
+        {
+            db.execute("CREATE TABLE MixedSource(id INTEGER PRIMARY KEY, value)");
+            db.execute("INSERT INTO MixedSource VALUES(1, 1), (2, 2.5), (3, 'three'), (4, NULL)");
+            db.execute("CREATE TABLE MixedTarget(value)");
+
+            sqlite3cpp::table_exporter exporter(db, "SELECT value FROM MixedSource ORDER BY id");
+            bool myThrown = false;
+            try { exporter.export_to("test.col", sqlite3cpp::formatColumnar); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+            TEST_ASSERT(!std::ifstream("test.col"));
+
+            sqlite3cpp::table_exporter exporter2(db, "SELECT value FROM MixedSource WHERE id IN (1, 4) ORDER BY id DESC");
+            const sqlite3cpp::transfer_stats myExportStats = exporter2.export_to("test.col", sqlite3cpp::formatColumnar);
+            TEST_ASSERT_EQUALS(myExportStats.rows, 2);
+            sqlite3cpp::table_importer importer(db, "INSERT INTO MixedTarget VALUES(?)");
+            const sqlite3cpp::transfer_stats myImportStats = importer.import_from("test.col", sqlite3cpp::formatColumnar);
+            TEST_ASSERT_EQUALS(myImportStats.rows, 2);
+            {
+                sqlite3cpp::query qry(db, "SELECT group_concat(coalesce(typeof(value) || ':' || value, 'null'), ',') FROM MixedTarget ORDER BY rowid");
+                const std::string myValues = qry.begin()->get<std::string>(1);
+                TEST_ASSERT_EQUALS(myValues, "null,integer:1");
+            }
+            db.execute("DROP TABLE MixedSource");
+            db.execute("DROP TABLE MixedTarget");
+        }
+
+        // CSV round trip with quoted fields spanning lines and chunks smaller than a record
+        {
+            sqlite3cpp::table_exporter exporter(db, SqlSelect);
+            const sqlite3cpp::transfer_stats myExportStats = exporter.export_to("test.csv", sqlite3cpp::formatCsv);
+            TEST_ASSERT_EQUALS(myExportStats.rows, myRows);
+
+            const size_t myChunkSizes[] = { 1, 100, 1024 * 1024 };
+            for (size_t i = 0; i < sizeof(myChunkSizes) / sizeof(myChunkSizes[0]); ++i)
+            {
+                sqlite3cpp::table_importer importer(db, SqlInsert, 4);
+                importer.set_chunk_size(myChunkSizes[i]);
+                const sqlite3cpp::transfer_stats myImportStats = importer.import_from("test.csv", sqlite3cpp::formatCsv);
+                TEST_ASSERT_EQUALS(myImportStats.rows, myRows);
+                const int myEqual = countEqualRows(db, false);
+                TEST_ASSERT_EQUALS(myEqual, myRows);
+
+                // BLOBs are hex-encoded
+                sqlite3cpp::query qry(db, "SELECT count(*) FROM Source s JOIN Target t ON s.id = t.id WHERE hex(s.data) = t.data");
+                const int myHexEqual = qry.begin()->get<int>(1);
+                TEST_ASSERT_EQUALS(myHexEqual, myRows);
+                db.execute("DELETE FROM Target");
+            }
+        }
+
+        // header only
+        {
+            sqlite3cpp::table_exporter exporter(db, "SELECT id, value, score, name, data FROM Source WHERE id < 0");
+            const sqlite3cpp::transfer_stats myExportStats = exporter.export_to("test.csv", sqlite3cpp::formatCsv);
+            TEST_ASSERT_EQUALS(myExportStats.rows, 0);
+            sqlite3cpp::table_importer importer(db, SqlInsert);
+            const sqlite3cpp::transfer_stats myImportStats = importer.import_from("test.csv", sqlite3cpp::formatCsv);
+            TEST_ASSERT_EQUALS(myImportStats.rows, 0);
+        }
+
+        // malformed input: the failed batch is rolled back, the committed ones are kept
+        {
+            {
+                std::ofstream myFile("test.csv");
+                myFile << "id,value,score,name,data\n1,1,1,a,\n2,2,2,b,\n3,3,3\n";
+            }
+            sqlite3cpp::table_importer importer(db, SqlInsert, 2);
+            bool myThrown = false;
+            try { importer.import_from("test.csv", sqlite3cpp::formatCsv); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+
+            {
+                std::ofstream myFile("test.csv");
+                myFile << "id,value,score,name,data\n1,1,1,a,\n2,2,2,b,\n1,3,3,c,\n";
+            }
+            sqlite3cpp::table_importer importer2(db, SqlInsert, 2, 2);
+            myThrown = false;
+            try { importer2.import_from("test.csv", sqlite3cpp::formatCsv); }
+            catch (sqlite3cpp::database_error& e) { myThrown = true; TEST_ASSERT_EQUALS(e.code(), SQLITE_CONSTRAINT); }
+            TEST_ASSERT(myThrown);
+            sqlite3cpp::query qry(db, "SELECT count(*) FROM Target");
+            const int myCount = qry.begin()->get<int>(1);
+            TEST_ASSERT_EQUALS(myCount, 2);
+
+            myThrown = false;
+            try { importer.import_from("test.csv", sqlite3cpp::formatColumnar); }
+            catch (sqlite3cpp::database_error&) { myThrown = true; }
+            TEST_ASSERT(myThrown);
+        }
+
+        ::remove("test.csv");
+        ::remove("test.col");
+        cout << "TEST OK" << endl;
+        return 0;
+    }
+    catch (std::exception& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+}